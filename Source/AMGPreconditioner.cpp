@@ -0,0 +1,197 @@
+#include "AMGPreconditioner.h"
+#include <cmath>
+#include <random>
+
+// a coupling is strong when |a_ij| >= STRENGTH_THRESHOLD sqrt(a_ii a_jj), kept low because the smoothed
+// prolongators spread the coarse matrices and their couplings weaken from level to level
+#define STRENGTH_THRESHOLD 0.02
+// power iterations estimating rho(D^-1 A), and the margin over the estimate, which is from below
+#define SPECTRAL_RADIUS_ITERATIONS 15
+#define SPECTRAL_RADIUS_MARGIN 1.05
+// the hierarchy stops at this size, or when a level would not shrink below this fraction of the last one
+#define COARSEST_UNKNOWNS 500
+#define MIN_COARSENING 0.8
+#define MAX_LEVELS 25
+
+AMGPreconditioner::AMGPreconditioner() {
+	status = Eigen::Success;
+	operatorNonzeros = 0;
+}
+
+static bool isStrong(double aij, double aii, double ajj) {
+	return aij * aij >= STRENGTH_THRESHOLD * STRENGTH_THRESHOLD * std::abs(aii * ajj);
+}
+
+int AMGPreconditioner::aggregate(const SparseMatrix& A, vector<int>& aggregateOf) {
+	long n = A.rows();
+	Eigen::VectorXd diagonal = A.diagonal();
+	aggregateOf.assign(n, -1);
+	int count = 0;
+
+	// 1. a node whose strong neighbors are all free becomes the root of an aggregate of them
+	for (long i = 0; i < n; i++) {
+		if (aggregateOf[i] >= 0)
+			continue;
+		bool free = true, coupled = false;
+		for (SparseMatrix::InnerIterator it(A, i); it && free; ++it) {
+			if (it.row() == i || !isStrong(it.value(), diagonal[i], diagonal[it.row()]))
+				continue;
+			coupled = true;
+			free = aggregateOf[it.row()] < 0;
+		}
+		if (!free || !coupled)
+			continue;
+		aggregateOf[i] = count;
+		for (SparseMatrix::InnerIterator it(A, i); it; ++it)
+			if (it.row() != i && isStrong(it.value(), diagonal[i], diagonal[it.row()]))
+				aggregateOf[it.row()] = count;
+		count++;
+	}
+
+	// 2. the nodes left join the aggregate they are most strongly coupled to
+	vector<int> rooted(aggregateOf);
+	for (long i = 0; i < n; i++) {
+		if (rooted[i] >= 0)
+			continue;
+		double strongest = 0;
+		for (SparseMatrix::InnerIterator it(A, i); it; ++it) {
+			if (it.row() == i || rooted[it.row()] < 0 || !isStrong(it.value(), diagonal[i], diagonal[it.row()]))
+				continue;
+			if (std::abs(it.value()) > strongest) {
+				strongest = std::abs(it.value());
+				aggregateOf[i] = rooted[it.row()];
+			}
+		}
+	}
+
+	// 3. the strongly coupled nodes still left make aggregates of their own
+	for (long i = 0; i < n; i++) {
+		if (aggregateOf[i] >= 0)
+			continue;
+		bool coupled = false;
+		for (SparseMatrix::InnerIterator it(A, i); it; ++it) {
+			if (it.row() != i && aggregateOf[it.row()] < 0 && isStrong(it.value(), diagonal[i], diagonal[it.row()])) {
+				aggregateOf[it.row()] = count;
+				coupled = true;
+			}
+		}
+		if (coupled)
+			aggregateOf[i] = count++;
+	}
+	return count;
+}
+
+double AMGPreconditioner::spectralRadius(const Level& level) {
+	long n = level.A.rows();
+	mt19937 random(n);
+	uniform_real_distribution<double> uniform(-1, 1);
+	Eigen::VectorXd v(n), w;
+	for (long i = 0; i < n; i++)
+		v[i] = uniform(random);
+	double rho = 0;
+	for (int k = 0; k < SPECTRAL_RADIUS_ITERATIONS; k++) {
+		w = level.inverseDiagonal.cwiseProduct(level.A * v);
+		rho = w.norm() / v.norm();
+		v = w / w.norm();
+	}
+	return rho * SPECTRAL_RADIUS_MARGIN;
+}
+
+void AMGPreconditioner::setup(const SparseMatrix& A) {
+	levels.clear();
+	status = Eigen::Success;
+	levels.push_back(Level());
+	levels.back().A = A;
+	operatorNonzeros = A.nonZeros();
+
+	while (levels.size() < MAX_LEVELS) {
+		Level& fine = levels.back();
+		long n = fine.A.rows();
+		fine.inverseDiagonal = fine.A.diagonal().cwiseInverse();
+		if (n <= COARSEST_UNKNOWNS || !fine.inverseDiagonal.allFinite())
+			break;
+		vector<int> aggregateOf;
+		int count = aggregate(fine.A, aggregateOf);
+		if (count == 0 || count > MIN_COARSENING * n)
+			break;
+
+		// P_0 is constant on every aggregate, smoothing it with omega = 4 / (3 rho(D^-1 A)) damps its
+		// high frequencies. Gershgorin's bound on rho is loose on the coarse levels and would smooth too little
+		vector<Eigen::Triplet<double> > triplets;
+		for (long i = 0; i < n; i++)
+			if (aggregateOf[i] >= 0)
+				triplets.push_back(Eigen::Triplet<double>(i, aggregateOf[i], 1));
+		SparseMatrix P0(n, count);
+		P0.setFromTriplets(triplets.begin(), triplets.end());
+		double omega = 4.0 / (3.0 * spectralRadius(fine));
+		SparseMatrix AP0 = fine.A * P0;
+		for (long j = 0; j < AP0.outerSize(); j++)
+			for (SparseMatrix::InnerIterator it(AP0, j); it; ++it)
+				it.valueRef() *= omega * fine.inverseDiagonal[it.row()];
+		fine.P = P0 - AP0;
+		fine.P.prune(0.0);
+		fine.R = fine.P.transpose();
+
+		Level coarse;
+		SparseMatrix product = fine.R * (fine.A * fine.P);
+		// rounding leaves P^T A P slightly unsymmetric, the smoother reads its columns as rows
+		SparseMatrix transposed = product.transpose();
+		coarse.A = 0.5 * (product + transposed);
+		coarse.A.makeCompressed();
+		operatorNonzeros += coarse.A.nonZeros();
+		levels.push_back(coarse);
+	}
+
+	coarsest.compute(levels.back().A);
+	if (coarsest.info() != Eigen::Success)
+		status = Eigen::NumericalIssue;
+	for (size_t l = 0; l < levels.size(); l++) {
+		long n = levels[l].A.rows();
+		levels[l].x.resize(n);
+		levels[l].b.resize(n);
+		levels[l].r.resize(n);
+	}
+}
+
+void AMGPreconditioner::smooth(Level& level, bool forward) const {
+	long n = level.A.rows();
+	for (long k = 0; k < n; k++) {
+		long i = forward ? k : n - 1 - k;
+		double s = level.b[i];
+		for (SparseMatrix::InnerIterator it(level.A, i); it; ++it)
+			if (it.row() != i)
+				s -= it.value() * level.x[it.row()];
+		level.x[i] = s * level.inverseDiagonal[i];
+	}
+}
+
+void AMGPreconditioner::cycle(size_t l) const {
+	Level& level = levels[l];
+	if (l + 1 == levels.size()) {
+		level.x = coarsest.solve(level.b);
+		return;
+	}
+	level.x.setZero();
+	smooth(level, true);
+	level.r = level.b - level.A * level.x;
+	levels[l + 1].b = level.R * level.r;
+	cycle(l + 1);
+	level.x += level.P * levels[l + 1].x;
+	smooth(level, false);
+}
+
+Eigen::VectorXd AMGPreconditioner::solve(const Eigen::VectorXd& b) const {
+	if (levels.empty())
+		return b;
+	levels[0].b = b;
+	cycle(0);
+	return levels[0].x;
+}
+
+int AMGPreconditioner::getNumLevels() {
+	return (int)levels.size();
+}
+
+long AMGPreconditioner::getOperatorNonzeros() {
+	return operatorNonzeros;
+}
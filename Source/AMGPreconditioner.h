@@ -0,0 +1,78 @@
+#ifndef AMGPRECONDITIONER_H
+#define AMGPRECONDITIONER_H
+
+#include <vector>
+#include "LinearSolver.h"
+#include "Eigen/SparseCholesky"
+
+using namespace std;
+
+/*
+*	smoothed aggregation algebraic multigrid for symmetric positive definite nodal matrices (a resistive
+*	mesh with its ground), used as the preconditioner of conjugate gradients. the rows of a voltage source
+*	or a closed switch make the nodal matrix unsymmetric, LinearSolver::select only picks the multigrid
+*	backend for the nodal systems of source-free circuits and for the loop systems.
+*	the setup builds a hierarchy of ever coarser matrices once, solves with new right hand sides reuse it:
+*		the nodes are grouped into aggregates along their strong couplings, |a_ij| >= theta sqrt(a_ii a_jj),
+*		the tentative prolongator is constant on every aggregate (the near null space of a Laplacian),
+*		it is smoothed by a damped Jacobi step, P = (I - omega D^-1 A) P_0, and the coarse matrix is P^T A P.
+*	the coarsest matrix is factorized directly. one application is a V-cycle with a forward Gauss-Seidel
+*	sweep before the coarse correction and a backward one after it, which keeps the cycle symmetric as CG needs.
+*	the work of a cycle grows with the nonzeros of the hierarchy, and its convergence rate hardly depends
+*	on the size of the mesh, so neither does the number of iterations.
+*	it follows the interface Eigen's iterative solvers expect of a preconditioner.
+*/
+
+class AMGPreconditioner {
+
+private:
+	struct Level {
+		SparseMatrix A;				// symmetric, its columns are its rows
+		SparseMatrix P, R;			// prolongation to this level from the next one, and restriction R = P^T
+		Eigen::VectorXd inverseDiagonal;
+		// work vectors of the cycle
+		Eigen::VectorXd x, b, r;
+	};
+
+	// the cycle only changes the work vectors, solve is const for the iterative solvers
+	mutable vector<Level> levels;
+	Eigen::SimplicialLDLT<SparseMatrix> coarsest;
+	Eigen::ComputationInfo status;
+	long operatorNonzeros;
+
+	void setup(const SparseMatrix& A);
+	// groups the nodes of "A" along strong couplings, returns the number of aggregates,
+	// a node without a strong coupling is left out (-1) for the smoother alone
+	static int aggregate(const SparseMatrix& A, vector<int>& aggregateOf);
+	// estimates the largest eigenvalue of D^-1 A of the level
+	static double spectralRadius(const Level& level);
+	void smooth(Level& level, bool forward) const;
+	void cycle(size_t l) const;
+
+public:
+	AMGPreconditioner();
+
+	template<typename MatrixType>
+	AMGPreconditioner& analyzePattern(const MatrixType&) { return *this; }
+
+	template<typename MatrixType>
+	AMGPreconditioner& factorize(const MatrixType& A) {
+		setup(SparseMatrix(A));
+		return *this;
+	}
+
+	template<typename MatrixType>
+	AMGPreconditioner& compute(const MatrixType& A) { return factorize(A); }
+
+	// one V-cycle from zero for A z = b
+	Eigen::VectorXd solve(const Eigen::VectorXd& b) const;
+
+	Eigen::ComputationInfo info() { return status; }
+
+	// levels of the hierarchy, the coarsest included
+	int getNumLevels();
+	// nonzeros of every matrix of the hierarchy, their ratio to those of A is the operator complexity
+	long getOperatorNonzeros();
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "BandedSolver.h"
+#include <algorithm>
+#include <cmath>
+
+BandedSolver::BandedSolver() {
+	n = 0;
+	lower = 0;
+	upper = 0;
+	top = 0;
+	cholesky = false;
+}
+
+bool BandedSolver::factorize(const SparseMatrix& A) {
+	n = A.rows();
+	Ordering::compute(A, Ordering::REVERSE_CUTHILL_MCKEE, perm);
+	lower = 0;
+	upper = 0;
+	for (int j = 0; j < A.outerSize(); j++) {
+		for (SparseMatrix::InnerIterator it(A, j); it; ++it) {
+			int i = perm.indices()[it.row()], k = perm.indices()[j];
+			lower = max(lower, i - k);
+			upper = max(upper, k - i);
+		}
+	}
+	// a nodal matrix is positive definite, the voltage source rows make the matrix unsymmetric
+	cholesky = isSymmetric(A);
+	return refactorize(A);
+}
+
+bool BandedSolver::refactorize(const SparseMatrix& A) {
+	if (A.rows() != n || perm.size() != n)
+		return factorize(A);
+	if (cholesky) {
+		top = 0;
+		load(A);
+		if (factorizeCholesky())
+			return true;
+		// symmetric but indefinite, the LU handles it
+		cholesky = false;
+	}
+	top = lower + upper;
+	load(A);
+	return factorizeLU();
+}
+
+void BandedSolver::load(const SparseMatrix& A) {
+	band.setZero(top + lower + 1, n);
+	for (int j = 0; j < A.outerSize(); j++) {
+		for (SparseMatrix::InnerIterator it(A, j); it; ++it) {
+			int i = perm.indices()[it.row()], k = perm.indices()[j];
+			if (cholesky && i < k)
+				continue;
+			band(top + i - k, k) += it.value();
+		}
+	}
+}
+
+bool BandedSolver::factorizeCholesky() {
+	for (int j = 0; j < n; j++) {
+		double* column = &band(0, j);
+		if (!(column[0] > 0))
+			return false;
+		double d = std::sqrt(column[0]);
+		column[0] = d;
+		int last = (int)min<long>(n - 1, j + lower);
+		for (int i = j + 1; i <= last; i++)
+			column[i - j] /= d;
+		// the columns to the right within the band, each updated by the rank one product of this one
+		for (int c = j + 1; c <= last; c++) {
+			double l = column[c - j];
+			if (l == 0)
+				continue;
+			double* target = &band(0, c);
+			for (int i = c; i <= last; i++)
+				target[i - c] -= column[i - j] * l;
+		}
+	}
+	return true;
+}
+
+bool BandedSolver::factorizeLU() {
+	pivots.resize(n);
+	for (int j = 0; j < n; j++) {
+		int last = (int)min<long>(n - 1, j + lower), right = (int)min<long>(n - 1, j + top);
+		int p = j;
+		for (int i = j + 1; i <= last; i++)
+			if (std::abs(band(top + i - j, j)) > std::abs(band(top + p - j, j)))
+				p = i;
+		if (band(top + p - j, j) == 0)
+			return false;
+		pivots[j] = p;
+		// row p reaches at most "lower + upper" columns past j, the room kept above the band
+		if (p != j)
+			for (int c = j; c <= right; c++)
+				swap(band(top + j - c, c), band(top + p - c, c));
+		double* column = &band(top, j);
+		for (int i = j + 1; i <= last; i++)
+			column[i - j] /= column[0];
+		for (int c = j + 1; c <= right; c++) {
+			double u = band(top + j - c, c);
+			if (u == 0)
+				continue;
+			double* target = &band(top + j - c, c);
+			for (int i = j + 1; i <= last; i++)
+				target[i - j] -= column[i - j] * u;
+		}
+	}
+	return true;
+}
+
+bool BandedSolver::solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+	Eigen::VectorXd y = perm * b;
+	if (cholesky) {
+		for (int j = 0; j < n; j++) {
+			y[j] /= band(0, j);
+			int last = (int)min<long>(n - 1, j + lower);
+			for (int i = j + 1; i <= last; i++)
+				y[i] -= band(i - j, j) * y[j];
+		}
+		for (int j = (int)n - 1; j >= 0; j--) {
+			int last = (int)min<long>(n - 1, j + lower);
+			double s = y[j];
+			for (int i = j + 1; i <= last; i++)
+				s -= band(i - j, j) * y[i];
+			y[j] = s / band(0, j);
+		}
+	}
+	else {
+		for (int j = 0; j < n; j++) {
+			swap(y[j], y[pivots[j]]);
+			int last = (int)min<long>(n - 1, j + lower);
+			for (int i = j + 1; i <= last; i++)
+				y[i] -= band(top + i - j, j) * y[j];
+		}
+		for (int j = (int)n - 1; j >= 0; j--) {
+			y[j] /= band(top, j);
+			for (int i = max(0, j - top); i < j; i++)
+				y[i] -= band(top + i - j, j) * y[j];
+		}
+	}
+	x = perm.transpose() * y;
+	return true;
+}
+
+// A^T = P^T (L U)^T P with the row interchanges of the LU applied last, in reverse
+bool BandedSolver::solveTransposed(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+	if (cholesky)
+		return solve(b, x);
+	Eigen::VectorXd y = perm * b;
+	for (int j = 0; j < n; j++) {
+		double s = y[j];
+		for (int i = max(0, j - top); i < j; i++)
+			s -= band(top + i - j, j) * y[i];
+		y[j] = s / band(top, j);
+	}
+	for (int j = (int)n - 1; j >= 0; j--) {
+		int last = (int)min<long>(n - 1, j + lower);
+		for (int i = j + 1; i <= last; i++)
+			y[j] -= band(top + i - j, j) * y[i];
+		swap(y[j], y[pivots[j]]);
+	}
+	x = perm.transpose() * y;
+	return true;
+}
+
+LinearSolver::Type BandedSolver::getType() {
+	return BANDED;
+}
+
+long BandedSolver::getFactorNonzeros() {
+	return n * (top + lower + 1);
+}
+
+double BandedSolver::getFactorFlops() {
+	return cholesky ? (double)n * lower * lower : 2.0 * n * lower * (top + 1);
+}
+
+double BandedSolver::getSolveFlops() {
+	return 2.0 * n * (top + 2 * lower + 1);
+}
+
+int BandedSolver::getBandwidth() {
+	return max(lower, upper);
+}
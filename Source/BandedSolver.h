@@ -0,0 +1,53 @@
+#ifndef BANDEDSOLVER_H
+#define BANDEDSOLVER_H
+
+#include <vector>
+#include "LinearSolver.h"
+#include "Ordering.h"
+#include "Eigen/Dense"
+
+/*
+*	banded backend for chain-like circuits (ladders, transmission line models, cascaded filters), whose
+*	matrix keeps its nonzeros within a narrow band of the diagonal once its unknowns are renumbered.
+*	the backend orders the unknowns itself by reverse Cuthill-McKee and stores only the band, column by column:
+*		a symmetric positive definite matrix (a nodal matrix without voltage sources) is factorized by a
+*		band Cholesky, L L^T, which stays within the lower band,
+*		any other by a band LU with partial pivoting, whose row interchanges widen U by the lower bandwidth.
+*	with a bandwidth b the factorization costs O(n b^2) and a solve O(n b), linear in n for a long ladder.
+*/
+
+class BandedSolver : public LinearSolver {
+
+private:
+	long n;
+	Ordering::Permutation perm;		// the factors are those of P A P^T
+	int lower, upper;				// bandwidths of P A P^T below and above the diagonal
+	bool cholesky;
+	// column j holds the entries of rows j - top ... j + lower, at band(top + i - j, j),
+	// top is 0 for Cholesky (which only stores the lower band) and "lower + upper" for LU
+	Eigen::MatrixXd band;
+	int top;
+	vector<int> pivots;			// the row swapped with row j at step j of the LU
+
+	// copies P A P^T into the band, zero elsewhere
+	void load(const SparseMatrix& A);
+	bool factorizeCholesky();
+	bool factorizeLU();
+
+public:
+	BandedSolver();
+
+	bool factorize(const SparseMatrix& A);
+	bool refactorize(const SparseMatrix& A);
+	bool solve(const Eigen::VectorXd& b, Eigen::VectorXd& x);
+	bool solveTransposed(const Eigen::VectorXd& b, Eigen::VectorXd& x);
+	Type getType();
+	long getFactorNonzeros();
+	double getFactorFlops();
+	double getSolveFlops();
+
+	// the bandwidth of the renumbered matrix, the larger of its lower and upper ones
+	int getBandwidth();
+};
+
+#endif
@@ -0,0 +1,311 @@
+#include "BatchRunner.h"
+#include "Circuit.h"
+#include "Netlist.h"
+#include <cstdio>
+#include <cctype>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// circuits read, solved or written at the same time per worker of the pool
+#define IN_FLIGHT_PER_THREAD 4
+
+static const char* netlistExtensions[] = { ".cir", ".net", ".sp", ".spice", ".ckt" };
+
+static bool hasNetlistExtension(const string& name) {
+	size_t dot = name.rfind('.');
+	if (dot == string::npos)
+		return false;
+	string extension = name.substr(dot);
+	transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	for (size_t i = 0; i < sizeof(netlistExtensions) / sizeof(netlistExtensions[0]); i++)
+		if (extension == netlistExtensions[i])
+			return true;
+	return false;
+}
+
+// the names of the netlists in "directory", false if it is not a directory
+static bool listDirectory(const string& directory, vector<string>& names) {
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE)
+		return false;
+	do {
+		if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && hasNetlistExtension(data.cFileName))
+			names.push_back(data.cFileName);
+	} while (FindNextFileA(find, &data));
+	FindClose(find);
+	return true;
+#else
+	DIR* dir = opendir(directory.c_str());
+	if (dir == NULL)
+		return false;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		string name = entry->d_name;
+		struct stat info;
+		if (hasNetlistExtension(name) && stat((directory + "/" + name).c_str(), &info) == 0 && S_ISREG(info.st_mode))
+			names.push_back(name);
+	}
+	closedir(dir);
+	return true;
+#endif
+}
+
+static bool isAbsolute(const string& path) {
+	return (!path.empty() && (path[0] == '/' || path[0] == '\\')) || (path.size() > 1 && path[1] == ':');
+}
+
+static string directoryOf(const string& path) {
+	size_t slash = path.find_last_of("/\\");
+	return slash == string::npos ? "." : path.substr(0, slash);
+}
+
+// the whole file in one read, the netlists are small and many
+static bool readFile(const string& path, string& text) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == NULL)
+		return false;
+	bool success = fseek(file, 0, SEEK_END) == 0;
+	long size = success ? ftell(file) : -1;
+	success = size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+	if (success) {
+		text.resize(size);
+		success = size == 0 || fread(&text[0], 1, size, file) == (size_t)size;
+	}
+	fclose(file);
+	return success;
+}
+
+BatchRunner::BatchRunner(ThreadPool* pool) {
+	this->pool = pool;
+	format = ResultExporter::CSV;
+	solverType = LinearSolver::AUTO;
+	orderingType = Ordering::AUTO;
+	statsEnabled = false;
+	inFlight = 0;
+	solved = 0;
+	stats = new SolveStats();
+	seconds = 0;
+}
+
+BatchRunner::~BatchRunner() {
+	delete stats;
+}
+
+bool BatchRunner::addInput(string path) {
+	vector<string> names;
+	if (listDirectory(path, names)) {
+		sort(names.begin(), names.end());
+		for (size_t i = 0; i < names.size(); i++)
+			paths.push_back(path + "/" + names[i]);
+		return true;
+	}
+	string text;
+	if (!readFile(path, text)) {
+		cout << "ERROR: Can not open batch input " << path << ".\n";
+		return false;
+	}
+	string base = directoryOf(path);
+	size_t begin = 0;
+	while (begin < text.size()) {
+		size_t end = text.find('\n', begin);
+		if (end == string::npos)
+			end = text.size();
+		string line = text.substr(begin, end - begin);
+		begin = end + 1;
+		size_t first = line.find_first_not_of(" \t\r");
+		if (first == string::npos || line[first] == '#')
+			continue;
+		line = line.substr(first, line.find_last_not_of(" \t\r") + 1 - first);
+		paths.push_back(isAbsolute(line) ? line : base + "/" + line);
+	}
+	return true;
+}
+
+void BatchRunner::setOutput(string directory, ResultExporter::Format format) {
+	outputDirectory = directory;
+	this->format = format;
+}
+
+void BatchRunner::setSolver(LinearSolver::Type type) {
+	solverType = type;
+}
+
+void BatchRunner::setOrdering(Ordering::Type type) {
+	orderingType = type;
+}
+
+void BatchRunner::enableStats(bool enabled) {
+	statsEnabled = enabled;
+}
+
+// the file name of "path" without its directory, and without its extension too when "stem" is set
+static string fileName(const string& path, bool stem) {
+	size_t slash = path.find_last_of("/\\");
+	string name = slash == string::npos ? path : path.substr(slash + 1);
+	size_t dot = name.rfind('.');
+	if (stem && dot != string::npos && dot > 0)
+		name = name.substr(0, dot);
+	return name;
+}
+
+// the key two output names are the same file under, case-insensitive file systems included
+static string nameKey(string name) {
+	transform(name.begin(), name.end(), name.begin(), ::tolower);
+	return name;
+}
+
+void BatchRunner::getOutputPaths(vector<string>& outputs) {
+	outputs.assign(paths.size(), string());
+	if (outputDirectory.empty())
+		return;
+	unordered_map<string, int> stems;
+	for (size_t i = 0; i < paths.size(); i++)
+		stems[nameKey(fileName(paths[i], true))]++;
+	const char* extension = format == ResultExporter::CSV ? ".csv" : format == ResultExporter::JSONL ? ".jsonl" : ".bin";
+	unordered_map<string, size_t> owners;
+	for (size_t i = 0; i < paths.size(); i++) {
+		// "x.sp" and "x.cir" keep their extensions apart, "a/x.sp" and "b/x.sp" can not be told apart
+		string name = fileName(paths[i], true);
+		if (stems[nameKey(name)] > 1)
+			name = fileName(paths[i], false);
+		pair<unordered_map<string, size_t>::iterator, bool> owner = owners.insert(make_pair(nameKey(name), i));
+		if (owner.second)
+			outputs[i] = outputDirectory + "/" + name + extension;
+		else
+			failures.push_back(paths[i] + ": export to " + name + extension + " (already the output of " + paths[owner.first->second] + ")");
+	}
+}
+
+void BatchRunner::parse(Job* job) {
+	Circuit* c = new Circuit();
+	job->circuit = c;
+	c->enableStats(statsEnabled);
+	c->setSolver(solverType);
+	c->setOrdering(orderingType);
+	const char* failed = NULL;
+	{
+		ScopedPhase phase(c->getStats(), SolveStats::PARSE);
+		if (!readFile(job->path, job->text))
+			failed = "read";
+		else if (!parseNetlist(job->text, c, job->path))
+			failed = "parse";
+		string().swap(job->text);
+	}
+	if (failed == NULL && !c->checkCircuit())
+		failed = "check";
+	if (failed != NULL) {
+		finish(job, failed);
+		return;
+	}
+	pool->submit([this, job] { solve(job); });
+}
+
+void BatchRunner::solve(Job* job) {
+	if (!job->circuit->solve()) {
+		finish(job, "solve");
+		return;
+	}
+	if (outputDirectory.empty()) {
+		finish(job, NULL);
+		return;
+	}
+	pool->submit([this, job] { write(job); });
+}
+
+void BatchRunner::write(Job* job) {
+	Circuit* c = job->circuit;
+	bool success;
+	{
+		ScopedPhase phase(c->getStats(), SolveStats::EXPORT);
+		ResultExporter exporter;
+		success = exporter.open(job->output, format);
+		if (success) {
+			c->exportResults(&exporter);
+			success = exporter.close();
+		}
+	}
+	finish(job, success ? NULL : "export");
+}
+
+void BatchRunner::finish(Job* job, const char* stage) {
+	Circuit* c = job->circuit;
+	if (stage == NULL)
+		solved++;
+	{
+		unique_lock<mutex> guard(lock);
+		if (stage != NULL)
+			failures.push_back(job->path + ": " + stage);
+		if (statsEnabled && c != NULL)
+			stats->merge(c->getStats());
+	}
+	delete c;
+	delete job;
+	// notified under the lock, run() may return and destroy the runner as soon as it is released
+	unique_lock<mutex> guard(lock);
+	inFlight--;
+	progress.notify_all();
+}
+
+bool BatchRunner::run() {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	solved = 0;
+	failures.clear();
+	stats->reset();
+	vector<string> outputs;
+	getOutputPaths(outputs);
+	int limit = IN_FLIGHT_PER_THREAD * pool->getNumThreads();
+	for (size_t i = 0; i < paths.size(); i++) {
+		if (!outputDirectory.empty() && outputs[i].empty())
+			continue;
+		{
+			unique_lock<mutex> guard(lock);
+			progress.wait(guard, [this, limit] { return inFlight < limit; });
+			inFlight++;
+		}
+		Job* job = new Job();
+		job->path = paths[i];
+		job->output = outputs[i];
+		job->circuit = NULL;
+		pool->submit([this, job] { parse(job); });
+	}
+	{
+		unique_lock<mutex> guard(lock);
+		progress.wait(guard, [this] { return inFlight == 0; });
+	}
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	return failures.empty();
+}
+
+int BatchRunner::getNumCircuits() {
+	return (int)paths.size();
+}
+
+int BatchRunner::getNumSolved() {
+	return solved;
+}
+
+int BatchRunner::getNumFailed() {
+	return (int)failures.size();
+}
+
+void BatchRunner::print(ostream& out) {
+	vector<string> sorted(failures);
+	sort(sorted.begin(), sorted.end());
+	for (size_t i = 0; i < sorted.size(); i++)
+		out << "ERROR: " << sorted[i] << " failed.\n";
+	double perCircuit = paths.empty() ? 0 : seconds / paths.size();
+	out << "Solved " << solved << " of " << paths.size() << " circuits in " << seconds * 1e3 << " ms, "
+		<< perCircuit * 1e6 << " us per circuit on " << pool->getNumThreads() << " threads.\n";
+	if (statsEnabled)
+		stats->print(out);
+}
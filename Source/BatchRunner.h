@@ -0,0 +1,93 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+#include "ThreadPool.h"
+#include "ResultExport.h"
+#include "LinearSolver.h"
+#include "Ordering.h"
+#include "SolveStats.h"
+
+using namespace std;
+
+class Circuit;
+
+/*
+*	solves many independent netlists in one process.
+*	the inputs are the netlists of a directory (*.cir, *.net, *.sp, *.spice, *.ckt) or the paths listed in a
+*	manifest, one per line, relative to the manifest's directory, '#' starts a comment line.
+*	every circuit goes through three tasks on the pool, each one queued by the one before:
+*		read + parse + check		assemble + solve + deploy		export + free
+*	so the circuits at different stages run side by side on the workers. at most a few circuits per worker
+*	are in flight at once, which bounds the memory whatever the length of the batch.
+*	the results of "dir/name.cir" are written to "<output>/name.csv" (or .jsonl, .bin), or to "<output>/name.cir.csv"
+*	when another input is also called "name" apart from its extension. an input whose file name is the same as one
+*	before it in another directory fails instead of overwriting its results.
+*/
+
+class BatchRunner {
+
+private:
+	struct Job {
+		string path;
+		string output;
+		string text;
+		Circuit* circuit;
+	};
+
+	ThreadPool* pool;
+	vector<string> paths;
+	string outputDirectory;
+	ResultExporter::Format format;
+	LinearSolver::Type solverType;
+	Ordering::Type orderingType;
+	bool statsEnabled;
+
+	mutex lock;
+	condition_variable progress;
+	int inFlight;
+	atomic<int> solved;
+	vector<string> failures;		// "path: stage" of every failed circuit
+	SolveStats* stats;				// the statistics of every circuit added up
+	double seconds;					// wall time of the last run
+
+	void parse(Job* job);
+	void solve(Job* job);
+	void write(Job* job);
+	// frees the job and records its outcome, "stage" names where it failed, NULL if it did not
+	void finish(Job* job, const char* stage);
+
+	// the output path of every input, empty for those whose results would overwrite an earlier input's,
+	// which are recorded as failures
+	void getOutputPaths(vector<string>& outputs);
+
+public:
+	BatchRunner(ThreadPool* pool);
+	~BatchRunner();
+
+	// adds the netlists of the directory or the manifest "path", returns false if it can not be read
+	bool addInput(string path);
+
+	// writes the results of every circuit into "directory", nothing is written when it is empty
+	void setOutput(string directory, ResultExporter::Format format);
+	void setSolver(LinearSolver::Type type);
+	void setOrdering(Ordering::Type type);
+	void enableStats(bool enabled);
+
+	// solves every circuit added, returns true if all of them were solved (and written)
+	bool run();
+
+	int getNumCircuits();
+	int getNumSolved();
+	int getNumFailed();
+
+	// the failed circuits, the throughput and, while enabled, the statistics of all circuits
+	void print(ostream& out);
+};
+
+#endif
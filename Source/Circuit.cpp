@@ -1,12 +1,32 @@
 #include "Circuit.h"
 #include <cfloat>
+#include <climits>
 #include <cstdlib>
 #include <iostream>
 #include "Element.h"
+#include "Snapshot.h"
+#include "RefinedSolver.h"
+#include "EffectiveResistance.h"
+#include "SelectiveSolver.h"
+#include "LoopAnalysis.h"
+#include "Sparsifier.h"
 #include "Eigen/Dense"
 
 using namespace std;
 
+// singular systems are retried with a dense QR up to this many unknowns
+#define QR_FALLBACK_MAX_UNKNOWNS 3000
+// right hand sides per solve when extracting port matrices, bounds the memory to this many solution vectors
+#define PORT_BLOCK_COLUMNS 64
+// the loop equations are chosen when they have at most this fraction of the nodal unknowns,
+// and their fundamental loops at most this many branches per nodal unknown in all
+#define LOOP_MAX_UNKNOWN_FRACTION 0.5
+#define LOOP_MAX_ENTRIES_PER_UNKNOWN 8
+// the factors of the switch states are kept up to this many bytes unless setFactorCacheCapacity says otherwise
+#define FACTOR_CACHE_BYTES (256L << 20)
+// the sparsifiers draw their samples from this seed, so that a circuit solves the same way every run
+#define SPARSIFIER_SEED 1
+
 // adds a node with name "name"
 bool Circuit::addNode(string name) {
 	if (getNode(name) != NULL)
@@ -21,14 +41,19 @@ bool Circuit::addNode(string name) {
 	}
 	this->lastId++;
 	this->nodes->push_back(tNode);
+	(*nodeNames)[name] = tNode;
+	topologyVersion++;
 	return true;
 }
 
 // gets current through element "name"
 double Circuit::getCurrent(string name) {
 	Element* tElement = getElement(name);
-	if (tElement == NULL)
-		return DBL_MAX;
+	if (tElement == NULL) {
+		string local;
+		Instance* instance = getInstance(name, local);
+		return instance != NULL ? instance->getElementCurrent(local) : DBL_MAX;
+	}
 	return tElement->getCurrent();
 }
 // gets voltage across element or node "name"
@@ -38,7 +63,13 @@ double Circuit::getVoltage(string name) {
 		Node* node = getNode(name);
 		if (node != NULL)
 			return node->getVoltage();
-		else return DBL_MAX;
+		string local;
+		Instance* instance = getInstance(name, local);
+		if (instance == NULL)
+			return DBL_MAX;
+		if (instance->getElementType(local) != Element::ElementType::ERROR)
+			return instance->getElementVoltage(local);
+		return instance->getNodeVoltage(local);
 	}
 	else {
 		return tElement->getVoltage();
@@ -52,10 +83,10 @@ double Circuit::getResistance(string name) {
 }
 
 Node* Circuit::getNode(string name) {
-	for (vector<Node*>::iterator it = this->nodes->begin(); it != nodes->end(); it++) {
-		if ((*it)->getName() == name) return (*it);
-	}
-	return NULL;
+	unordered_map<string, Node*>::iterator it = nodeNames->find(name);
+	if (it == nodeNames->end())
+		return NULL;
+	return it->second;
 }
 Node* Circuit::getNode(int id) {
 	for (vector<Node*>::iterator it = this->nodes->begin(); it != nodes->end(); it++) {
@@ -73,17 +104,28 @@ Element* Circuit::getElement(int id) {
 	return NULL;
 }
 Element* Circuit::getElement(string name) {
-	for (vector<Element*>::iterator it = this->elements->begin(); it != elements->end(); it++) {
-		if ((*it)->getName() == name) return (*it);
-	}
-	for (vector<Element*>::iterator it = this->voltageSources->begin(); it != voltageSources->end(); it++) {
-		if ((*it)->getName() == name) return (*it);
-	}
-	return NULL;
+	unordered_map<string, Element*>::iterator it = elementNames->find(name);
+	if (it == elementNames->end())
+		return NULL;
+	return it->second;
+}
+Instance* Circuit::getInstance(string name, string& local) {
+	size_t dot = name.find('.');
+	if (dot == string::npos)
+		return NULL;
+	unordered_map<string, Instance*>::iterator it = instanceNames->find(name.substr(0, dot));
+	if (it == instanceNames->end())
+		return NULL;
+	local = name.substr(dot + 1);
+	return it->second;
 }
 
 void Circuit::getNodeNames (string elementName, string& negNode, string& posNode) {
 	Element* tElem = this->getElement(elementName);
+	string local;
+	Instance* instance;
+	if (tElem == NULL && (instance = getInstance(elementName, local)) != NULL && instance->getElementNodes(local, negNode, posNode))
+		return;
 	if (tElem == NULL) {
 		negNode = "0";
 		posNode = "0";
@@ -93,39 +135,278 @@ void Circuit::getNodeNames (string elementName, string& negNode, string& posNode
 	posNode = (tElem->getPosNode())->getName();
 }
 
-bool Circuit::solveEquations(double* eqn, double* vals) {
-	int numofeqs = nodes->size() - 1 + voltageSources->size();
-	Eigen::Map < Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> > A(eqn, numofeqs, numofeqs);
+const Ordering::Permutation& Circuit::getOrdering(const SparseMatrix& eqn) {
+	if (permutationVersion != topologyVersion) {
+		ScopedPhase phase(stats, SolveStats::ORDER);
+		lastOrderingType = Ordering::compute(eqn, orderingType, *permutation);
+		permutationVersion = topologyVersion;
+	}
+	return *permutation;
+}
 
-	Eigen::Map<Eigen::VectorXd> b(vals, numofeqs);
-	Eigen::VectorXd x = A.colPivHouseholderQr().solve(b);
-	double relative_error = (A*x - b).norm() / b.norm();
+bool Circuit::trySolve(LinearSolver::Type type, const SparseMatrix& eqn, const Eigen::MatrixXd& vals, Eigen::MatrixXd& x) {
+	RefinedSolver* solver;
+	bool reuse, factorized = true, success;
+	FactorCache::Key state;
+	if (switches->empty()) {
+		// superposition and repeated solves only change values, the symbolic analysis is kept
+		reuse = cachedSolver != NULL && cachedSolverVersion == topologyVersion && cachedSolver->getType() == type;
+		if (!reuse) {
+			delete cachedSolver;
+			cachedSolver = new RefinedSolver(LinearSolver::create(type), stats);
+			cachedSolverVersion = topologyVersion;
+			if (LinearSolver::usesOrdering(type))
+				cachedSolver->setOrdering(getOrdering(eqn));
+		}
+		solver = cachedSolver;
+	}
+	else {
+		// between topology changes the system only changes with the switches, a state solved before
+		// is solved again with its factors as they are
+		if (factorsVersion != topologyVersion) {
+			factors->clear();
+			factorsVersion = topologyVersion;
+		}
+		getSwitchState(state);
+		reuse = factors->find(state, type, solver);
+		// the fallbacks take over at once where this backend failed before
+		if (reuse && solver == NULL) {
+			lastSolver = NULL;
+			return false;
+		}
+		factorized = !reuse;
+		if (!reuse) {
+			solver = new RefinedSolver(LinearSolver::create(type), stats);
+			if (LinearSolver::usesOrdering(type))
+				solver->setOrdering(getOrdering(eqn));
+		}
+	}
+	{
+		ScopedPhase phase(stats, SolveStats::FACTORIZE);
+		if (!factorized)
+			success = true;
+		else
+			success = reuse ? solver->refactorize(eqn) : solver->factorize(eqn);
+	}
+	if (success)
+		success = solver->solveMany(vals, x);
+	lastSolverType = type;
+	lastBackwardError = solver->getBackwardError();
+	lastConditionEstimate = solver->getConditionEstimate();
 
-	if (relative_error > 0.1) {
-		cout << "ERROR: Invalid circuit, either two different voltage sources in parallel or two different current sources in series, or "
-			<< " source is short-circuited.\n";
+	if (stats->isEnabled()) {
+		stats->setSolverName(LinearSolver::getTypeName(type));
+		if (type == LinearSolver::BANDED)
+			stats->setOrderingName(Ordering::getTypeName(Ordering::REVERSE_CUTHILL_MCKEE));
+		else
+			stats->setOrderingName(LinearSolver::usesOrdering(type) ? Ordering::getTypeName(lastOrderingType) : "none");
+		stats->addFlops((factorized ? solver->getFactorFlops() : 0) + solver->getSolveFlops());
+		long factorNonzeros = solver->getFactorNonzeros();
+		stats->setFillIn(factorNonzeros < 0 ? 0 : factorNonzeros - eqn.nonZeros());
+		stats->setAccuracy(lastBackwardError, lastConditionEstimate, solver->getRefinementSteps());
+	}
+	success = success && lastBackwardError <= BACKWARD_ERROR_TOLERANCE;
+	// the factors that solved their state are cached with the copy of the system they refine against,
+	// the failures without them
+	if (!switches->empty() && !reuse) {
+		if (success)
+			factors->insert(state, type, solver, (max(0L, solver->getFactorNonzeros()) + eqn.nonZeros()) * (sizeof(double) + sizeof(int)));
+		else {
+			delete solver;
+			solver = NULL;
+			factors->insert(state, type, NULL, 0);
+		}
+	}
+	lastSolver = solver;
+	return success;
+}
+
+bool Circuit::solveEquations(const SparseMatrix& eqn, const Eigen::VectorXd& vals, Eigen::VectorXd& x) {
+	Eigen::MatrixXd X;
+	if (!solveEquations(eqn, Eigen::MatrixXd(vals), X))
 		return false;
+	x = X.col(0);
+	return true;
+}
+
+bool Circuit::solveEquations(const SparseMatrix& eqn, const Eigen::MatrixXd& vals, Eigen::MatrixXd& x) {
+	return solveReferenced(eqn, vals, x, true);
+}
+
+bool Circuit::solveReferenced(const SparseMatrix& eqn, const Eigen::MatrixXd& vals, Eigen::MatrixXd& x, bool factorize) {
+	int reference = getReference(eqn);
+	if (reference < 0) {
+		if (factorize)
+			return solveSystem(eqn, vals, x, solverType);
+		return solveAgain(vals, x);
 	}
+	SparseMatrix movedEqn;
+	Eigen::MatrixXd movedVals;
+	moveReference(vals, reference, movedVals);
+	if (factorize) {
+		// getReference only moves the reference of the systems the banded backend takes
+		moveReference(eqn, reference, movedEqn);
+		if (!solveSystem(movedEqn, movedVals, x, LinearSolver::BANDED))
+			return false;
+	}
+	else if (!solveAgain(movedVals, x))
+		return false;
+	// back to the ground: the row of the reference holds the ground's voltage measured from the reference
+	Eigen::RowVectorXd ground = x.row(reference);
+	for (vector<Node*>::iterator it = nodes->begin(); it != nodes->end(); it++)
+		if (!(*it)->isGround() && (*it)->getId() != reference)
+			x.row((*it)->getId()) -= ground;
+	x.row(reference) = -ground;
+	return true;
+}
 
+bool Circuit::solveAgain(const Eigen::MatrixXd& vals, Eigen::MatrixXd& x) {
+	if (lastSolver == NULL || !lastSolver->solveMany(vals, x) || lastSolver->getBackwardError() > BACKWARD_ERROR_TOLERANCE) {
+		cout << "ERROR: The equations could not be solved accurately with the last factors.\n";
+		return false;
+	}
+	return true;
+}
 
-	for (int i = 0; i < numofeqs; i++) vals[i] = x[i];
+int Circuit::getReference(const SparseMatrix& eqn) {
+	// only the banded backend gains from it, and the admittances of the instances are not stamped on the ground
+	if ((solverType != LinearSolver::AUTO && solverType != LinearSolver::BANDED) || !instances->empty())
+		return -1;
+	if (referenceVersion == topologyVersion)
+		return referenceId;
+	referenceVersion = topologyVersion;
+	referenceId = -1;
+	// the automatic selection never takes the banded backend for systems of this size, whatever their band
+	if (solverType == LinearSolver::AUTO && !LinearSolver::admitsBanded(eqn))
+		return -1;
+
+	Node* ground = NULL;
+	Node* hub = NULL;
+	for (vector<Node*>::iterator it = nodes->begin(); it != nodes->end(); it++) {
+		if ((*it)->isGround())
+			ground = *it;
+		else if (hub == NULL || (*it)->getNumOfElements() > hub->getNumOfElements())
+			hub = *it;
+	}
+	if (ground == NULL || hub == NULL || hub->getNumOfElements() <= ground->getNumOfElements())
+		return -1;
+	SparseMatrix moved;
+	moveReference(eqn, hub->getId(), moved);
+	Ordering::Permutation perm, movedPerm;
+	Ordering::compute(moved, Ordering::REVERSE_CUTHILL_MCKEE, movedPerm);
+	int movedBandwidth = Ordering::bandwidth(moved, movedPerm);
+	// under AUTO the moved system must also be one the selection hands to the banded backend
+	if (solverType == LinearSolver::AUTO && (movedBandwidth > LinearSolver::getMaxBandwidth() || !LinearSolver::admitsBanded(moved)))
+		return -1;
+	Ordering::compute(eqn, Ordering::REVERSE_CUTHILL_MCKEE, perm);
+	if (movedBandwidth < Ordering::bandwidth(eqn, perm))
+		referenceId = hub->getId();
+	return referenceId;
+}
+
+void Circuit::moveReference(const SparseMatrix& eqn, int reference, SparseMatrix& moved) {
+	vector<Eigen::Triplet<double> > triplets;
+	triplets.reserve(eqn.nonZeros());
+	for (int j = 0; j < eqn.outerSize(); j++)
+		for (SparseMatrix::InnerIterator it(eqn, j); it; ++it)
+			if (it.row() != reference && j != reference)
+				triplets.push_back(Eigen::Triplet<double>(it.row(), j, it.value()));
+
+	// the ground's row and column, stamped from its elements like those of any other node
+	for (vector<Node*>::iterator n = nodes->begin(); n != nodes->end(); n++) {
+		if (!(*n)->isGround()) continue;
+		Node* ground = *n;
+		for (vector<Element*>::iterator it = ground->getElements()->begin(); it != ground->getElements()->end(); it++) {
+			Node* other = (*it)->getTheOtherNode(ground);
+			double x;
+			switch ((*it)->getType()) {
+			case Element::ElementType::RESISTOR:
+				x = 1 / (*it)->getResistance();
+				triplets.push_back(Eigen::Triplet<double>(reference, reference, x));
+				if (!other->isGround() && other->getId() != reference) {
+					triplets.push_back(Eigen::Triplet<double>(reference, other->getId(), -x));
+					triplets.push_back(Eigen::Triplet<double>(other->getId(), reference, -x));
+				}
+				break;
+			case Element::ElementType::VOLTAGE_SOURCE:
+				// its equation reads V(pos) - V(neg), and its current is stamped the other way round in the equations of its nodes
+				x = (*it)->getPosNode() == ground ? 1 : -1;
+				triplets.push_back(Eigen::Triplet<double>((*it)->getId(), reference, x));
+				triplets.push_back(Eigen::Triplet<double>(reference, (*it)->getId(), -x));
+				break;
+			case Element::ElementType::SWITCH:
+				// the same as a voltage source while closed, kept as zeros while open so that the pattern does not change
+				x = ((*it)->getPosNode() == ground ? 1 : -1) * ((*it)->isClosed() ? 1 : 0);
+				triplets.push_back(Eigen::Triplet<double>((*it)->getId(), reference, x));
+				triplets.push_back(Eigen::Triplet<double>(reference, (*it)->getId(), -x));
+				break;
+			default:
+				break;
+			}
+		}
+	}
+	moved.resize(eqn.rows(), eqn.cols());
+	moved.setFromTriplets(triplets.begin(), triplets.end());
+	moved.makeCompressed();
+}
+
+void Circuit::moveReference(const Eigen::MatrixXd& vals, int reference, Eigen::MatrixXd& moved) {
+	// the currents into every node sum to zero, the ground's are minus those into the others
+	moved = vals;
+	moved.row(reference).setZero();
+	for (vector<Node*>::iterator it = nodes->begin(); it != nodes->end(); it++)
+		if (!(*it)->isGround())
+			moved.row(reference) -= vals.row((*it)->getId());
+}
+
+bool Circuit::solveSystem(const SparseMatrix& eqn, const Eigen::MatrixXd& vals, Eigen::MatrixXd& x, LinearSolver::Type type) {
+	if (type == LinearSolver::AUTO)
+		type = LinearSolver::select(eqn);
+
+	bool success = trySolve(type, eqn, vals, x);
+	// the iterative solvers may stall, the symmetric ones reject unsymmetric systems and the single precision
+	// factors of the mixed one can not be refined on badly conditioned systems, the sparse LU is the robust fallback
+	if (!success && type != LinearSolver::SPARSE_LU && type != LinearSolver::DENSE_LU && type != LinearSolver::DENSE_QR) {
+		type = LinearSolver::SPARSE_LU;
+		success = trySolve(type, eqn, vals, x);
+	}
+	// LU breaks down on singular systems, column pivoting QR still finds a solution when one exists
+	// (two equal voltage sources in parallel), so it is kept as the last resort for moderate sizes
+	if (!success && type != LinearSolver::DENSE_QR && eqn.rows() <= QR_FALLBACK_MAX_UNKNOWNS)
+		success = trySolve(LinearSolver::DENSE_QR, eqn, vals, x);
+
+	if (!success) {
+		cout << "ERROR: Invalid circuit, either two different voltage sources in parallel or two different current sources in series, or "
+			<< " source is short-circuited.\n";
+		return false;
+	}
 
 	return true;
 }
 
 void Circuit::deployResults(double* vals) {
+	ScopedPhase phase(stats, SolveStats::DEPLOY);
 	int n = voltageSources->size() + nodes->size() - 1;
-	for (int i = 0; i < n; i++) {
-		Node* tNode = getNode(i);
-		if (tNode != NULL)
-			tNode->setVoltage(vals[i]);
-		else
-		{
-			Element* tElem = getElement(i);
-			if (tElem != NULL) {
-				tElem->setCurrent(vals[i]);
-			}
-		}
+	if (solution->data() != vals)
+		solution->assign(vals, vals + n);
+	// unknown i is the node with id i or the voltage source with id i, walk both lists once
+	// instead of searching for every id
+	for (vector<Node*>::iterator it = nodes->begin(); it != nodes->end(); it++) {
+		int id = (*it)->getId();
+		if (!(*it)->isGround() && id >= 0 && id < n)
+			(*it)->setVoltage(vals[id]);
+	}
+	for (vector<Element*>::iterator it = voltageSources->begin(); it != voltageSources->end(); it++) {
+		int id = (*it)->getId();
+		if (id >= 0 && id < n)
+			(*it)->setCurrent(vals[id]);
+	}
+	// the interiors of the instances are recovered from the new port voltages when asked for
+	for (vector<Instance*>::iterator it = instances->begin(); it != instances->end(); it++)
+		(*it)->invalidate();
+	if (resultStream != NULL) {
+		resultStream->beginSolve(streamedSolves++);
+		exportResults(resultStream);
 	}
 }
 
@@ -135,21 +416,150 @@ Circuit::Circuit() {
 	nodes = new vector<Node*>(0);
 	elements = new vector<Element*>(0);
 	voltageSources = new vector<Element*>(0);
+	switches = new vector<Element*>(0);
+	nodeNames = new unordered_map<string, Node*>();
+	elementNames = new unordered_map<string, Element*>();
+	subcircuits = new unordered_map<string, Subcircuit*>();
+	instances = new vector<Instance*>(0);
+	instanceNames = new unordered_map<string, Instance*>();
+	solution = new vector<double>(0);
+	resultStream = NULL;
+	streamedSolves = 0;
+	stats = new SolveStats();
+	solverType = LinearSolver::AUTO;
+	lastSolverType = LinearSolver::AUTO;
+	lastBackwardError = -1;
+	lastConditionEstimate = -1;
+	topologyVersion = 0;
+	orderingType = Ordering::AUTO;
+	lastOrderingType = Ordering::AUTO;
+	permutation = new Ordering::Permutation();
+	permutationVersion = -1;
+	cachedSolver = NULL;
+	cachedSolverVersion = -1;
+	factors = new FactorCache(FACTOR_CACHE_BYTES);
+	factorsVersion = -1;
+	lastSolver = NULL;
+	resistances = NULL;
+	resistancesVersion = -1;
+	selectiveSolver = NULL;
+	selectiveSolverVersion = -1;
+	referenceId = -1;
+	referenceVersion = -1;
+	formulation = LoopAnalysis::AUTO;
+	lastFormulation = LoopAnalysis::NODAL;
+	loops = NULL;
+	loopsVersion = -1;
+	sparsifyEpsilon = 0;
+	sparsifyRefine = false;
+	sparsifier = NULL;
+	sparsifierVersion = -1;
+	lastSparsified = false;
 	lastId = 0;
 	iscleaned = true;
 }
 
+Circuit::~Circuit() {
+	for (vector<Instance*>::iterator it = instances->begin(); it != instances->end(); it++)
+		delete *it;
+	for (unordered_map<string, Subcircuit*>::iterator it = subcircuits->begin(); it != subcircuits->end(); it++)
+		delete it->second;
+	for (vector<Element*>::iterator it = elements->begin(); it != elements->end(); it++)
+		delete *it;
+	for (vector<Element*>::iterator it = voltageSources->begin(); it != voltageSources->end(); it++)
+		delete *it;
+	for (vector<Node*>::iterator it = nodes->begin(); it != nodes->end(); it++)
+		delete *it;
+	delete nodes;
+	delete elements;
+	delete voltageSources;
+	delete switches;
+	delete nodeNames;
+	delete elementNames;
+	delete subcircuits;
+	delete instances;
+	delete instanceNames;
+	delete solution;
+	delete stats;
+	delete permutation;
+	delete cachedSolver;
+	delete factors;
+	delete resistances;
+	delete selectiveSolver;
+	delete loops;
+	delete sparsifier;
+}
+
+
+LoopAnalysis* Circuit::getLoopAnalysis() {
+	if (formulation == LoopAnalysis::NODAL)
+		return NULL;
+	if (loopsVersion != topologyVersion) {
+		delete loops;
+		loops = NULL;
+		loopsVersion = topologyVersion;
+		// fewer unknowns alone is not enough, long fundamental loops couple many loops through every branch
+		long nodal = voltageSources->size() + nodes->size() - 1;
+		bool forced = formulation == LoopAnalysis::LOOP;
+		if (forced || LoopAnalysis::countUnknowns(this) <= LOOP_MAX_UNKNOWN_FRACTION * nodal) {
+			loops = new LoopAnalysis(this, forced ? LONG_MAX : LOOP_MAX_ENTRIES_PER_UNKNOWN * nodal);
+			if (!loops->isReady()) {
+				delete loops;
+				loops = NULL;
+			}
+		}
+	}
+	return loops;
+}
+
+Sparsifier* Circuit::getSparsifier() {
+	if (sparsifyEpsilon <= 0)
+		return NULL;
+	if (sparsifierVersion != topologyVersion) {
+		delete sparsifier;
+		sparsifierVersion = topologyVersion;
+		sparsifier = new Sparsifier(this, sparsifyEpsilon, SPARSIFIER_SEED);
+		if (!sparsifier->isReady()) {
+			delete sparsifier;
+			sparsifier = NULL;
+		}
+	}
+	return sparsifier;
+}
 
 bool Circuit::_solve() {
-	double* eqn = NULL;
-	double* vals = NULL;
+	SparseMatrix eqn;
+	Eigen::VectorXd vals, x;
 
+	// a sparsifier that can not solve leaves the circuit to the exact equations
+	Sparsifier* sampled = getSparsifier();
+	lastSparsified = sampled != NULL && sampled->solve(sparsifyRefine, x);
+	if (lastSparsified) {
+		lastFormulation = LoopAnalysis::NODAL;
+		lastSolverType = sampled->getType();
+		lastBackwardError = sampled->getBackwardError();
+		lastConditionEstimate = sampled->getConditionEstimate();
+		stats->setFormulationName(LoopAnalysis::getFormulationName(LoopAnalysis::NODAL));
+		deployResults(x.data());
+		return true;
+	}
+
+	// the loop equations give the same unknowns, a singular loop system is left to the nodal fallbacks
+	LoopAnalysis* analysis = getLoopAnalysis();
+	if (analysis != NULL && analysis->solve(x)) {
+		lastFormulation = LoopAnalysis::LOOP;
+		stats->setFormulationName(LoopAnalysis::getFormulationName(LoopAnalysis::LOOP));
+		deployResults(x.data());
+		return true;
+	}
+	lastFormulation = LoopAnalysis::NODAL;
+	stats->setFormulationName(LoopAnalysis::getFormulationName(LoopAnalysis::NODAL));
 	createEquations(eqn, vals);
 
-	if (!solveEquations(eqn, vals))
+	if (!solveEquations(eqn, vals, x))
 		return false;
 
-	deployResults(vals);
+	deployResults(x.data());
 
 	return true;
 }
@@ -160,39 +570,74 @@ bool Circuit::solve() {
 	return this->_solve();
 }
 
-bool Circuit::createEquations(double*& eqs, double*& vals) {
+bool Circuit::createEquations(SparseMatrix& eqn, Eigen::VectorXd& vals) {
+	ScopedPhase phase(stats, SolveStats::ASSEMBLE);
 	int n = voltageSources->size() + nodes->size() - 1;
-	//cout << endl << endl << n << endl << endl;
-	eqs = new double[n*n];
-	vals = new double[n];
-
-	for (int i = 0; i < n; i++) {
-		vals[i] = 0;
-		for (int j = 0; j < n; j++) {
-			eqs[i + n*j] = 0;
-		}
-	}
+	vals = Eigen::VectorXd::Zero(n);
 
-	int i = 0;
+	// each resistor stamps four coefficients and each voltage source four, duplicates are summed
+	vector<Eigen::Triplet<double> > triplets;
+	triplets.reserve(4 * (elements->size() + voltageSources->size()) + n);
+
+	// every unknown writes its equation on its own row, which keeps the pattern structurally symmetric
+	// (a voltage source couples its nodes in both its row and its column) for the symmetric orderings
 	for (vector<Node*>::iterator it = nodes->begin(); it != nodes->end(); it++) {
 		if ((*it)->isGround()) continue;
-		createEquation((*it), (eqs + n*i), vals[i]);
-		i++;
+		int row = (*it)->getId();
+		createEquation((*it), row, triplets, vals[row]);
 	}
 
 	for (vector<Element*>::iterator it = voltageSources->begin(); it != voltageSources->end(); it++) {
-		createEquation((*it), (eqs + n*i), vals[i]);
-		i++;
+		int row = (*it)->getId();
+		createEquation((*it), row, triplets, vals[row]);
 	}
 
+	for (vector<Instance*>::iterator it = instances->begin(); it != instances->end(); it++)
+		createEquation((*it), triplets, vals);
+
+	eqn.resize(n, n);
+	eqn.setFromTriplets(triplets.begin(), triplets.end());
+	eqn.makeCompressed();
+	stats->setSystemSize(n, eqn.nonZeros());
+
 	return true;
 }
 
-bool Circuit::createEquation(Element* vsource, double* eqn, double& val) {
+bool Circuit::createEquation(Instance* instance, vector<Eigen::Triplet<double> >& eqn, Eigen::VectorXd& vals) {
+	Eigen::MatrixXd& Y = *instance->getDefinition()->getAdmittance();
+	Eigen::VectorXd& J = *instance->getDefinition()->getNortonCurrents();
+	vector<Node*>* ports = instance->getPorts();
+	for (size_t a = 0; a < ports->size(); a++) {
+		Node* node = (*ports)[a];
+		if (node->isGround()) continue;
+		int row = node->getId();
+		if (instance->isEnabled())
+			vals[row] += J[a];
+		for (size_t b = 0; b < ports->size(); b++) {
+			if ((*ports)[b]->isGround() || Y(a, b) == 0) continue;
+			eqn.push_back(Eigen::Triplet<double>(row, (*ports)[b]->getId(), Y(a, b)));
+		}
+	}
+	return true;
+}
+
+bool Circuit::createEquation(Element* vsource, int row, vector<Eigen::Triplet<double> >& eqn, double& val) {
+	if (vsource->getType() == Element::ElementType::SWITCH) {
+		// V2 - V1 = 0 while closed, I = 0 while open. both states stamp the same entries, the ones a state
+		// does not use as zeros, so that the ordering and the pattern of the factors do not change with the switches
+		double closed = vsource->isClosed() ? 1 : 0;
+		if (!vsource->getPosNode()->isGround())
+			eqn.push_back(Eigen::Triplet<double>(row, vsource->getPosNode()->getId(), closed));
+		if (!vsource->getNegNode()->isGround())
+			eqn.push_back(Eigen::Triplet<double>(row, vsource->getNegNode()->getId(), -closed));
+		eqn.push_back(Eigen::Triplet<double>(row, row, 1 - closed));
+		val = 0;
+		return true;
+	}
 	if(!vsource->getPosNode()->isGround())
-		eqn[vsource->getPosNode()->getId()] = 1;
+		eqn.push_back(Eigen::Triplet<double>(row, vsource->getPosNode()->getId(), 1));
 	if (!vsource->getNegNode()->isGround())
-		eqn[vsource->getNegNode()->getId()] = -1;
+		eqn.push_back(Eigen::Triplet<double>(row, vsource->getNegNode()->getId(), -1));
 	if (vsource->isEnabled())
 		val = vsource->getVoltage();
 	else
@@ -201,15 +646,15 @@ bool Circuit::createEquation(Element* vsource, double* eqn, double& val) {
 }
 
 
-bool Circuit::createEquation(Node* node, double* eqn, double& val) {
+bool Circuit::createEquation(Node* node, int row, vector<Eigen::Triplet<double> >& eqn, double& val) {
 	for (vector<Element*>::iterator it = node->getElements()->begin(); it != node->getElements()->end(); it++) {
 		double x;
 		switch ((*it)->getType()) {
 		case Element::ElementType::RESISTOR:
 			x = 1 / (*it)->getResistance();
-			eqn[node->getId()] += x;
+			eqn.push_back(Eigen::Triplet<double>(row, node->getId(), x));
 			if (!(*it)->getTheOtherNode(node)->isGround())
-				eqn[(*it)->getTheOtherNode(node)->getId()] -= x;
+				eqn.push_back(Eigen::Triplet<double>(row, (*it)->getTheOtherNode(node)->getId(), -x));
 			break;
 		case Element::ElementType::CURRENT_SOURCE:
 			if ((*it)->isEnabled()) {
@@ -230,7 +675,16 @@ bool Circuit::createEquation(Node* node, double* eqn, double& val) {
 				x = -1;
 			}
 			else x = 1;
-			eqn[(*it)->getId()] += x;
+			eqn.push_back(Eigen::Triplet<double>(row, (*it)->getId(), x));
+			break;
+		case Element::ElementType::SWITCH:
+			x = (*it)->isClosed() ? 1 : 0;
+			if ((*it)->getPosNode() == node)
+				x = -x;
+			eqn.push_back(Eigen::Triplet<double>(row, (*it)->getId(), x));
+			break;
+		case Element::ElementType::CAPACITOR:
+			// open in the DC solution
 			break;
 		case Element::ElementType::ERROR:
 			return false;
@@ -245,7 +699,8 @@ bool Circuit::createEquation(Node* node, double* eqn, double& val) {
 bool Circuit::addElement(string name, double value, string nodename, Element::ElementType et) {
 	Node* n = getNode(nodename);
 
-	if (n == NULL || (et == Element::ElementType::RESISTOR && value <= 0) || et == Element::ElementType::ERROR) {
+	if (n == NULL || (et == Element::ElementType::RESISTOR && value <= 0) || (et == Element::ElementType::CAPACITOR && value < 0)
+		|| et == Element::ElementType::ERROR) {
 		return false;
 	}
 
@@ -253,14 +708,17 @@ bool Circuit::addElement(string name, double value, string nodename, Element::El
 
 	if (e == NULL) {
 		e = new Element(name, et, value);
-		if (e->getType() == Element::ElementType::VOLTAGE_SOURCE) {
+		if (e->getType() == Element::ElementType::VOLTAGE_SOURCE || e->getType() == Element::ElementType::SWITCH) {
 			e->setId(lastId);
 			lastId++;
 			this->voltageSources->push_back(e);
+			if (e->getType() == Element::ElementType::SWITCH)
+				this->switches->push_back(e);
 		}
 		else {
 			this->elements->push_back(e);
 		}
+		(*elementNames)[name] = e;
 	}
 	else {
 		if (et != e->getType()) {
@@ -295,23 +753,121 @@ bool Circuit::addElement(string name, double value, string nodename, Element::El
 		cout << "ERROR: element " << name << " already exists.\n";
 	}
 	n->addElement(e);
+	topologyVersion++;
 
 	return true;
 }
 
+bool Circuit::addElement(string name, double value, string posNode, string negNode, Element::ElementType et) {
+	if (posNode == negNode || getElement(name) != NULL || et == Element::ElementType::ERROR
+		|| (et == Element::ElementType::RESISTOR && value <= 0) || (et == Element::ElementType::CAPACITOR && value < 0)) {
+		return false;
+	}
+	addNode(posNode);
+	addNode(negNode);
+	Node* p = getNode(posNode);
+	Node* n = getNode(negNode);
+
+	Element* e = new Element(name, et, value);
+	if (et == Element::ElementType::VOLTAGE_SOURCE || et == Element::ElementType::SWITCH) {
+		e->setId(lastId);
+		lastId++;
+		this->voltageSources->push_back(e);
+		if (et == Element::ElementType::SWITCH)
+			this->switches->push_back(e);
+	}
+	else {
+		this->elements->push_back(e);
+	}
+	(*elementNames)[name] = e;
+	e->setPosNode(p);
+	e->setNegNode(n);
+	p->addElement(e);
+	n->addElement(e);
+	topologyVersion++;
+	return true;
+}
+
+Element::ElementType Circuit::getElementType(string name) {
+	Element* tElement = getElement(name);
+	if (tElement == NULL) {
+		string local;
+		Instance* instance = getInstance(name, local);
+		return instance != NULL ? instance->getElementType(local) : Element::ElementType::ERROR;
+	}
+	return tElement->getType();
+}
+
+bool Circuit::isTopLevel(string name) {
+	return getElement(name) != NULL || getNode(name) != NULL;
+}
 
 double Circuit::getPower(string name)
 {
 	Element* telement = getElement(name);
-	if (telement == NULL)
-		return 0;
+	if (telement == NULL) {
+		string local;
+		Instance* instance = getInstance(name, local);
+		return instance != NULL ? instance->getElementPower(local) : 0;
+	}
 	else
 		return telement->getPower();
 }
 
+bool Circuit::addSubcircuit(Subcircuit* definition) {
+	if (getSubcircuit(definition->getName()) != NULL)
+		return false;
+	(*subcircuits)[definition->getName()] = definition;
+	return true;
+}
+
+Subcircuit* Circuit::getSubcircuit(string name) {
+	unordered_map<string, Subcircuit*>::iterator it = subcircuits->find(name);
+	if (it == subcircuits->end())
+		return NULL;
+	return it->second;
+}
+
+bool Circuit::addInstance(string name, string definition, const vector<string>& nodes) {
+	Subcircuit* sub = getSubcircuit(definition);
+	if (sub == NULL || (int)nodes.size() != sub->getNumPorts() || getElement(name) != NULL || instanceNames->count(name))
+		return false;
+	for (size_t i = 0; i < nodes.size(); i++)
+		addNode(nodes[i]);
+
+	// the interior is eliminated once per definition and shared by all of its instances
+	if (sub->reduce()) {
+		Instance* instance = new Instance(name, sub);
+		for (size_t i = 0; i < nodes.size(); i++)
+			instance->addPort(getNode(nodes[i]));
+		instances->push_back(instance);
+		(*instanceNames)[name] = instance;
+		topologyVersion++;
+		return true;
+	}
+
+	// no port admittance, the elements are added with "name." in front of their names and interior nodes
+	unordered_map<string, string> rename;
+	for (size_t i = 0; i < nodes.size(); i++)
+		rename[sub->getPort(i)] = nodes[i];
+	rename["0"] = (*this->nodes)[0]->getName();
+	vector<Subcircuit::Entry>* entries = sub->getEntries();
+	for (vector<Subcircuit::Entry>::iterator it = entries->begin(); it != entries->end(); it++) {
+		string pos = rename.count(it->posNode) ? rename[it->posNode] : name + "." + it->posNode;
+		string neg = rename.count(it->negNode) ? rename[it->negNode] : name + "." + it->negNode;
+		if (!addElement(name + "." + it->name, it->value, pos, neg, it->type))
+			return false;
+	}
+	return true;
+}
+
+int Circuit::getNumInstances() {
+	return instances->size();
+}
+
 bool Circuit::solveDue(string sourcename) {
 	Element* source = getElement(sourcename);
-	if (source == NULL || source->getType() == Element::ElementType::RESISTOR) {
+	if (source == NULL || (source->getType() != Element::ElementType::VOLTAGE_SOURCE && source->getType() != Element::ElementType::CURRENT_SOURCE)) {
 		cout << sourcename << " does not exist or is not a source.\n";
 		return false;
 	}
@@ -319,22 +875,125 @@ bool Circuit::solveDue(string sourcename) {
 		cleanUpSP();
 
 	for (vector<Element*>::iterator it = elements->begin(); it != elements->end(); it++) {
-		if ((*it)->getType() != Element::ElementType::RESISTOR) {
+		if ((*it)->getType() == Element::ElementType::CURRENT_SOURCE) {
 			if ((*it) != source) (*it)->setEnabled(false);
 		}
 	}
 
+	// the switches stay as they are, they are part of the circuit the source drives
 	for (vector<Element*>::iterator it = voltageSources->begin(); it != voltageSources->end(); it++) {
-		if ((*it) != source) (*it)->setEnabled(false);
+		if ((*it) != source && (*it)->getType() != Element::ElementType::SWITCH) (*it)->setEnabled(false);
 	}
 
+	for (vector<Instance*>::iterator it = instances->begin(); it != instances->end(); it++)
+		(*it)->setEnabled(false);
+
+	// the response to one source is not a result of the circuit
+	ResultExporter* stream = resultStream;
+	resultStream = NULL;
 	bool success = _solve();
+	resultStream = stream;
 
 	this->iscleaned = false;
 	return success;
 
 }
 
+SelectiveSolver* Circuit::getSelectiveSolver() {
+	if (selectiveSolverVersion != topologyVersion) {
+		SparseMatrix eqn;
+		Eigen::VectorXd vals;
+		createEquations(eqn, vals);
+		const Ordering::Permutation& perm = getOrdering(eqn);
+		ScopedPhase phase(stats, SolveStats::FACTORIZE);
+		delete selectiveSolver;
+		selectiveSolver = new SelectiveSolver();
+		if (!selectiveSolver->factorize(eqn, perm)) {
+			delete selectiveSolver;
+			selectiveSolver = NULL;
+		}
+		selectiveSolverVersion = topologyVersion;
+	}
+	if (selectiveSolver == NULL)
+		cout << "ERROR: Invalid circuit, either two different voltage sources in parallel or two different current sources in series, or "
+			<< " source is short-circuited.\n";
+	return selectiveSolver;
+}
+
+void Circuit::getSwitchState(FactorCache::Key& state) {
+	state.assign((switches->size() + 63) / 64, 0);
+	for (size_t k = 0; k < switches->size(); k++)
+		if ((*switches)[k]->isClosed())
+			state[k / 64] |= (uint64_t)1 << (k % 64);
+}
+
+void Circuit::addSourceTerms(Element* source, vector<int>& rows, vector<double>& values) {
+	// a switch has no source terms in either state
+	if (source->getType() == Element::ElementType::SWITCH)
+		return;
+	if (source->getType() == Element::ElementType::VOLTAGE_SOURCE) {
+		rows.push_back(source->getId());
+		values.push_back(source->getVoltage());
+		return;
+	}
+	if (!source->getPosNode()->isGround()) {
+		rows.push_back(source->getPosNode()->getId());
+		values.push_back(source->getCurrent());
+	}
+	if (!source->getNegNode()->isGround()) {
+		rows.push_back(source->getNegNode()->getId());
+		values.push_back(-source->getCurrent());
+	}
+}
+
+bool Circuit::findUnknowns(const vector<string>& names, vector<int>& ids) {
+	ids.resize(names.size());
+	for (size_t i = 0; i < names.size(); i++) {
+		Node* node = getNode(names[i]);
+		Element* element = node == NULL ? getElement(names[i]) : NULL;
+		if (node != NULL)
+			ids[i] = node->isGround() ? -1 : node->getId();
+		else if (element != NULL && (element->getType() == Element::ElementType::VOLTAGE_SOURCE || element->getType() == Element::ElementType::SWITCH))
+			ids[i] = element->getId();
+		else {
+			cout << "ERROR: " << names[i] << " is neither a node, a voltage source nor a switch.\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Circuit::solveDue(string sourcename, const vector<string>& outputs, vector<double>& values) {
+	Element* source = getElement(sourcename);
+	if (source == NULL || (source->getType() != Element::ElementType::VOLTAGE_SOURCE && source->getType() != Element::ElementType::CURRENT_SOURCE)) {
+		cout << sourcename << " does not exist or is not a source.\n";
+		return false;
+	}
+	vector<int> ids;
+	if (!findUnknowns(outputs, ids))
+		return false;
+	// a disabled source reads as DBL_MAX
+	if (!iscleaned)
+		cleanUpSP();
+	SelectiveSolver* solver = getSelectiveSolver();
+	if (solver == NULL)
+		return false;
+
+	ScopedPhase phase(stats, SolveStats::SOLVE);
+	vector<int> rows, wanted;
+	vector<double> terms, solution;
+	addSourceTerms(source, rows, terms);
+	for (size_t i = 0; i < ids.size(); i++)
+		if (ids[i] >= 0)
+			wanted.push_back(ids[i]);
+	if (!solver->solve(rows, terms, wanted, solution))
+		return false;
+	values.resize(ids.size());
+	for (size_t i = 0, k = 0; i < ids.size(); i++)
+		values[i] = ids[i] < 0 ? 0 : solution[k++];
+	return true;
+}
+
 void Circuit::cleanUpSP () {
 	for (vector<Element*>::iterator it = elements->begin(); it != elements->end(); it++) {
 		if ((*it)->getType() != Element::ElementType::RESISTOR) {
@@ -345,14 +1004,18 @@ void Circuit::cleanUpSP () {
 	for (vector<Element*>::iterator it = voltageSources->begin(); it != voltageSources->end(); it++) {
 		(*it)->setEnabled(true);
 	}
+
+	for (vector<Instance*>::iterator it = instances->begin(); it != instances->end(); it++)
+		(*it)->setEnabled(true);
 	this->iscleaned = true;
 }
 
 
 bool Circuit::checkCircuit() {
+	ScopedPhase phase(stats, SolveStats::CHECK);
 	// check empty nodes
 	for (vector<Node*>::iterator it = nodes->begin(); it != nodes->end(); it++) {
-		if ((*it)->getNumOfElements() < 2)
+		if ((*it)->getNumOfElements() + (*it)->getNumOfPorts() < 2)
 		{
 			cout << "ERROR: Node [" << (*it)->getName() << "] is connected to less than two elements, please enter other elements.\n";
 			return false;
@@ -381,13 +1044,45 @@ int Circuit::getNumVoltageSources() {
 	return voltageSources->size();
 }
 
+bool Circuit::setSwitch(string name, bool closed) {
+	Element* s = getElement(name);
+	if (s == NULL || s->getType() != Element::ElementType::SWITCH) {
+		cout << "ERROR: " << name << " is not a switch.\n";
+		return false;
+	}
+	if (s->isClosed() == closed)
+		return true;
+	s->setClosed(closed);
+	// the factors of the point queries and the effective resistances are those of the old state,
+	// the solves find the factors of the new one in the cache
+	selectiveSolverVersion = -1;
+	resistancesVersion = -1;
+	return true;
+}
+
+int Circuit::getNumSwitches() {
+	return switches->size();
+}
+
+void Circuit::setFactorCacheCapacity(long bytes) {
+	factors->setCapacity(bytes);
+}
+
+FactorCache* Circuit::getFactorCache() {
+	return factors;
+}
+
 double Circuit::getMaxPower(string name, double& Rmax)
 {
 	Element* telement = getElement(name);
 	if (telement == NULL || telement->getType() != Element::ElementType::RESISTOR)
         return DBL_MAX;
 	telement->setType(Element::ElementType::CURRENT_SOURCE);
+	topologyVersion++;
 
+	// the solves of the modified circuit are not results of the circuit
+	ResultExporter* stream = resultStream;
+	resultStream = NULL;
 	telement->setCurrent(0);
 	solve();
 	double Vth = telement->getVoltage();
@@ -395,12 +1090,15 @@ double Circuit::getMaxPower(string name, double& Rmax)
 	telement->setId(lastId);
 	telement->setVoltage(1);
 	voltageSources->push_back(telement);
+	topologyVersion++;
 	solveDue(telement->getName());
 	cleanUpSP();
 	double i = telement->getCurrent();
 	telement->setType(Element::ElementType::RESISTOR);
 	voltageSources->pop_back();
 	telement->setId(-1);
+	topologyVersion++;
+	resultStream = stream;
 
 	if (i == 0)	return DBL_MAX;
 	Rmax = 1.0 / i;
@@ -408,6 +1106,173 @@ double Circuit::getMaxPower(string name, double& Rmax)
 	return (Vth*Vth) / (4 * Rmax);
 }
 
+bool Circuit::getPortNodes(const vector<string>& posNodes, const vector<string>& negNodes, vector<Node*>& pos, vector<Node*>& neg) {
+	if (posNodes.size() != negNodes.size()) {
+		cout << "ERROR: Every port needs a positive and a negative node.\n";
+		return false;
+	}
+	pos.resize(posNodes.size());
+	neg.resize(negNodes.size());
+	for (size_t k = 0; k < posNodes.size(); k++) {
+		pos[k] = getNode(posNodes[k]);
+		neg[k] = getNode(negNodes[k]);
+		if (pos[k] == NULL || neg[k] == NULL) {
+			cout << "ERROR: Node [" << (pos[k] == NULL ? posNodes[k] : negNodes[k]) << "] does not exist.\n";
+			return false;
+		}
+		if (pos[k] == neg[k]) {
+			cout << "ERROR: Port " << posNodes[k] << " " << negNodes[k] << " is shorted on itself.\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Circuit::getPortImpedances(const vector<string>& posNodes, const vector<string>& negNodes, Eigen::MatrixXd& Z, Eigen::VectorXd& openVoltages) {
+	vector<Node*> pos, neg;
+	if (!getPortNodes(posNodes, negNodes, pos, neg))
+		return false;
+	if (!iscleaned)
+		cleanUpSP();
+	SparseMatrix eqn;
+	Eigen::VectorXd vals;
+	createEquations(eqn, vals);
+
+	long ports = pos.size(), n = eqn.rows();
+	Z.resize(ports, ports);
+	openVoltages.resize(ports);
+	// column 0 of the first block holds the sources, every other column a unit current into one port.
+	// the first block factorizes, the others reuse the factors
+	Eigen::MatrixXd rhs, x;
+	for (long first = -1; first < ports; first += PORT_BLOCK_COLUMNS) {
+		long last = min(first + PORT_BLOCK_COLUMNS, ports);
+		rhs = Eigen::MatrixXd::Zero(n, last - first);
+		for (long k = max(first, 0L); k < last; k++) {
+			if (!pos[k]->isGround())
+				rhs(pos[k]->getId(), k - first) += 1;
+			if (!neg[k]->isGround())
+				rhs(neg[k]->getId(), k - first) -= 1;
+		}
+		if (first < 0)
+			rhs.col(0) = vals;
+		if (!solveReferenced(eqn, rhs, x, first < 0))
+			return false;
+		for (long j = 0; j < ports; j++) {
+			Eigen::VectorXd v = Eigen::VectorXd::Zero(last - first);
+			if (!pos[j]->isGround())
+				v += x.row(pos[j]->getId()).transpose();
+			if (!neg[j]->isGround())
+				v -= x.row(neg[j]->getId()).transpose();
+			if (first < 0)
+				openVoltages[j] = v[0];
+			for (long k = max(first, 0L); k < last; k++)
+				Z(j, k) = v[k - first];
+		}
+	}
+	return true;
+}
+
+bool Circuit::getPortAdmittances(const vector<string>& posNodes, const vector<string>& negNodes, Eigen::MatrixXd& Y, Eigen::VectorXd& shortCurrents) {
+	Eigen::MatrixXd Z;
+	Eigen::VectorXd openVoltages;
+	if (!getPortImpedances(posNodes, negNodes, Z, openVoltages))
+		return false;
+	Eigen::FullPivLU<Eigen::MatrixXd> lu(Z);
+	lu.setThreshold(BACKWARD_ERROR_TOLERANCE);
+	if (!lu.isInvertible()) {
+		cout << "ERROR: The ports have no admittance matrix, an ideal voltage source ties some of them.\n";
+		return false;
+	}
+	Y = lu.inverse();
+	shortCurrents = Y * openVoltages;
+	return true;
+}
+
+bool Circuit::getThevenin(string posNode, string negNode, double& voltage, double& resistance) {
+	vector<Node*> pos, neg;
+	if (!getPortNodes(vector<string>(1, posNode), vector<string>(1, negNode), pos, neg))
+		return false;
+	if (!iscleaned)
+		cleanUpSP();
+	SelectiveSolver* solver = getSelectiveSolver();
+	if (solver == NULL)
+		return false;
+	Node* port[2] = { pos[0], neg[0] };
+	vector<int> outputs;
+	for (int i = 0; i < 2; i++)
+		if (!port[i]->isGround())
+			outputs.push_back(port[i]->getId());
+
+	// the open port with every source on, then a unit current into the port with the sources off
+	ScopedPhase phase(stats, SolveStats::SOLVE);
+	vector<int> rows;
+	vector<double> values, v;
+	for (vector<Element*>::iterator it = elements->begin(); it != elements->end(); it++)
+		if ((*it)->getType() == Element::ElementType::CURRENT_SOURCE)
+			addSourceTerms(*it, rows, values);
+	for (vector<Element*>::iterator it = voltageSources->begin(); it != voltageSources->end(); it++)
+		addSourceTerms(*it, rows, values);
+	for (vector<Instance*>::iterator it = instances->begin(); it != instances->end(); it++) {
+		vector<Node*>* ports = (*it)->getPorts();
+		Eigen::VectorXd& J = *(*it)->getDefinition()->getNortonCurrents();
+		for (size_t a = 0; a < ports->size(); a++) {
+			if ((*ports)[a]->isGround()) continue;
+			rows.push_back((*ports)[a]->getId());
+			values.push_back(J[a]);
+		}
+	}
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 1) {
+			rows.clear();
+			values.clear();
+			for (int i = 0; i < 2; i++) {
+				if (port[i]->isGround()) continue;
+				rows.push_back(port[i]->getId());
+				values.push_back(i == 0 ? 1 : -1);
+			}
+		}
+		if (!solver->solve(rows, values, outputs, v)) {
+			cout << "ERROR: The port of " << posNode << " and " << negNode << " could not be solved.\n";
+			return false;
+		}
+		double difference = (port[0]->isGround() ? 0 : v[0]) - (port[1]->isGround() ? 0 : v.back());
+		if (pass == 0)
+			voltage = difference;
+		else
+			resistance = difference;
+	}
+	return true;
+}
+
+bool Circuit::getNorton(string posNode, string negNode, double& current, double& conductance) {
+	double voltage, resistance;
+	if (!getThevenin(posNode, negNode, voltage, resistance))
+		return false;
+	if (resistance == 0) {
+		cout << "ERROR: Node [" << posNode << "] and [" << negNode << "] are tied by a voltage source, there is no Norton equivalent.\n";
+		return false;
+	}
+	conductance = 1 / resistance;
+	current = voltage * conductance;
+	return true;
+}
+
+EffectiveResistance* Circuit::getEffectiveResistances() {
+	if (resistancesVersion != topologyVersion) {
+		delete resistances;
+		resistances = new EffectiveResistance(this);
+		resistancesVersion = topologyVersion;
+	}
+	return resistances->isReady() ? resistances : NULL;
+}
+
+double Circuit::getEffectiveResistance(string node1, string node2) {
+	EffectiveResistance* engine = getEffectiveResistances();
+	if (engine == NULL)
+		return DBL_MAX;
+	return engine->getResistance(node1, node2);
+}
+
 bool Circuit::checkPowerBalance(double& dissipated, double& supplied) {
 	dissipated = 0;
 	supplied = 0;
@@ -422,5 +1287,122 @@ bool Circuit::checkPowerBalance(double& dissipated, double& supplied) {
 		if (p > 0)	dissipated += p;
 		else		supplied -= p;
 	}
+	for (vector<Instance*>::iterator it = instances->begin(); it != instances->end(); it++)
+		(*it)->addPower(dissipated, supplied);
 	return ( ( dissipated - supplied ) / supplied) < 0.01;
 }
+
+
+bool Circuit::saveSnapshot(string path, bool withSolution) {
+	return Snapshot::write(this, path, withSolution);
+}
+
+bool Circuit::loadSnapshot(string path) {
+	ScopedPhase phase(stats, SolveStats::PARSE);
+	Snapshot snapshot;
+	if (!snapshot.open(path))
+		return false;
+	topologyVersion++;
+	return snapshot.load(this);
+}
+
+bool Circuit::exportResults(ResultExporter* exporter) {
+	if (exporter == NULL || !exporter->isOpen())
+		return false;
+	for (vector<Node*>::iterator it = nodes->begin(); it != nodes->end(); it++)
+		exporter->writeNode((*it)->getName(), (*it)->getVoltage());
+	for (int k = 0; k < 2; k++) {
+		vector<Element*>* list = (k == 0) ? elements : voltageSources;
+		for (vector<Element*>::iterator it = list->begin(); it != list->end(); it++) {
+			char type;
+			switch ((*it)->getType()) {
+			case Element::ElementType::RESISTOR:
+				type = 'R';
+				break;
+			case Element::ElementType::CURRENT_SOURCE:
+				type = 'J';
+				break;
+			case Element::ElementType::VOLTAGE_SOURCE:
+				type = 'E';
+				break;
+			case Element::ElementType::SWITCH:
+				type = 'S';
+				break;
+			case Element::ElementType::CAPACITOR:
+				type = 'C';
+				break;
+			default:
+				continue;
+			}
+			exporter->writeElement((*it)->getName(), type, (*it)->getVoltage(), (*it)->getCurrent(), (*it)->getPower());
+		}
+	}
+	return true;
+}
+
+bool Circuit::setResultStream(ResultExporter* exporter) {
+	// the records of the solves are told apart by their indices, the binary columns hold a single solve
+	if (exporter != NULL && !exporter->isIndexed()) {
+		cout << "ERROR: Streamed results need an indexed CSV or JSON lines exporter.\n";
+		return false;
+	}
+	resultStream = exporter;
+	return true;
+}
+
+void Circuit::enableStats(bool enabled) {
+	stats->setEnabled(enabled);
+}
+
+SolveStats* Circuit::getStats() {
+	return stats;
+}
+
+void Circuit::setSolver(LinearSolver::Type type) {
+	solverType = type;
+	// the reference is chosen for the backend
+	referenceVersion = -1;
+}
+
+LinearSolver::Type Circuit::getLastSolver() {
+	return lastSolverType;
+}
+
+void Circuit::setOrdering(Ordering::Type type) {
+	orderingType = type;
+	// recompute the ordering and the factorization with the new choice
+	permutationVersion = -1;
+	cachedSolverVersion = -1;
+	factorsVersion = -1;
+}
+
+void Circuit::setFormulation(LoopAnalysis::Formulation formulation) {
+	this->formulation = formulation;
+	loopsVersion = -1;
+}
+
+LoopAnalysis::Formulation Circuit::getLastFormulation() {
+	return lastFormulation;
+}
+
+void Circuit::setSparsification(double epsilon, bool refine) {
+	sparsifyEpsilon = epsilon;
+	sparsifyRefine = refine;
+	sparsifierVersion = -1;
+}
+
+Sparsifier* Circuit::getLastSparsifier() {
+	return lastSparsified ? sparsifier : NULL;
+}
+
+Ordering::Type Circuit::getLastOrdering() {
+	return lastOrderingType;
+}
+
+double Circuit::getBackwardError() {
+	return lastBackwardError;
+}
+
+double Circuit::getConditionEstimate() {
+	return lastConditionEstimate;
+}
@@ -3,7 +3,21 @@
 
 #include "Node.h"
 #include "Element.h"
+#include "ResultExport.h"
+#include "SolveStats.h"
+#include "LinearSolver.h"
+#include "Ordering.h"
+#include "Subcircuit.h"
+#include "Instance.h"
+#include "LoopAnalysis.h"
+#include "FactorCache.h"
 #include <vector>
+#include <unordered_map>
+
+class RefinedSolver;
+class EffectiveResistance;
+class SelectiveSolver;
+class Sparsifier;
 
 /*
 *	all interactions will be through this class, the user will know nothing about the other classes
@@ -13,11 +27,97 @@
 
 class Circuit {
 
+	friend class Snapshot;
+	friend class LockstepSolver;
+	friend class EffectiveResistance;
+	friend class ContingencyAnalysis;
+	friend class LoopAnalysis;
+	friend class ModelReduction;
+	friend class Sparsifier;
+	friend class NodeMerge;
+
 private:
 
 	vector<Node*>*		nodes;
 	vector<Element*>*	elements;
 	vector<Element*>*	voltageSources;
+	// the switches among the voltage sources, in the order of their bits in the switch state
+	vector<Element*>*	switches;
+
+	// name lookups, so that large circuits do not pay a linear search per query
+	unordered_map<string, Node*>*		nodeNames;
+	unordered_map<string, Element*>*	elementNames;
+
+	// subcircuit definitions, and the instances that stamp their reduced port models
+	unordered_map<string, Subcircuit*>*	subcircuits;
+	vector<Instance*>*					instances;
+	unordered_map<string, Instance*>*	instanceNames;
+
+	// the unknown vector of the last solve, indexed by the ids of the nodes and voltage sources
+	vector<double>*	solution;
+
+	// when set, every solve of the circuit streams its results here as they are deployed, under the index
+	// streamedSolves. the solves made inside a query (superposition, maximum power) are kept out of it
+	ResultExporter*	resultStream;
+	long streamedSolves;
+
+	// timings and counters of every phase, recorded only while enabled
+	SolveStats*	stats;
+
+	// the backend used for the linear system, AUTO picks one per solve
+	LinearSolver::Type solverType;
+	LinearSolver::Type lastSolverType;
+	double lastBackwardError;
+	double lastConditionEstimate;
+
+	// bumped whenever the connections change, the ordering and the factorization are cached against it
+	long topologyVersion;
+
+	// the fill-reducing ordering of the sparse backends, computed once per topology
+	Ordering::Type orderingType;
+	Ordering::Type lastOrderingType;
+	Ordering::Permutation* permutation;
+	long permutationVersion;
+
+	// the backend of the last solve, refactorized in place while the topology is unchanged
+	RefinedSolver* cachedSolver;
+	long cachedSolverVersion;
+
+	// the factors of every switch state solved since the topology changed, used in place of cachedSolver
+	// when the circuit has switches
+	FactorCache* factors;
+	long factorsVersion;
+
+	// the backend that solved the last system, cachedSolver or one of the factors
+	RefinedSolver* lastSolver;
+
+	// the factorized resistor network of the effective resistance queries, rebuilt when the topology changes
+	EffectiveResistance* resistances;
+	long resistancesVersion;
+
+	// the LU factors of the point queries, whose right hand sides have a few nonzeros, kept until the topology changes
+	SelectiveSolver* selectiveSolver;
+	long selectiveSolverVersion;
+
+	// nodal or loop equations, AUTO takes the loops when there are far fewer of them than nodal unknowns
+	LoopAnalysis::Formulation formulation;
+	LoopAnalysis::Formulation lastFormulation;
+	// the loops of the circuit, built once per topology, NULL when the nodal equations are solved
+	LoopAnalysis* loops;
+	long loopsVersion;
+
+	// the resistors sampled within sparsifyEpsilon in place of the full network, 0 solves the circuit exactly.
+	// the sample is drawn once per topology, NULL when the resistances could not be estimated
+	double sparsifyEpsilon;
+	bool sparsifyRefine;
+	Sparsifier* sparsifier;
+	long sparsifierVersion;
+	bool lastSparsified;
+
+	// the node the banded systems are measured from in place of the ground, -1 for the ground itself,
+	// chosen once per topology
+	int referenceId;
+	long referenceVersion;
 
 	int lastId;
 	bool iscleaned;
@@ -27,40 +127,111 @@ private:
 	Element* getElement(string name);
 	Element* getElement(int id);
 
+	// finds the instance a hierarchical name "instance.local" belongs to, "local" gets the rest of the name
+	Instance* getInstance(string name, string& local);
+
 	/*
 	*	creates all of the equations that represent the circuit
-	*	in the form Ax = B where A and B are matricies
+	*	in the form Ax = B where A is a sparse matrix and B a vector
 	*	@param eqn : A
 	*	@param vals : B
 	*/
-	bool createEquations(double*& eqs, double*& vals);
+	bool createEquations(SparseMatrix& eqn, Eigen::VectorXd& vals);
 
 	/*
 	*	creates the nodal equation of the node 'node' GV = I
 	*	in the form Ax = B where A is a matrix with one row, B a value
 	*	@param node : the node to be analyzed
-	*	@param eqn : A
+	*	@param row : the row of A the equation goes to
+	*	@param eqn : the coefficients of A as (row, column, value) triplets
 	*	@param val : B
 	*/
-	bool createEquation(Node* node, double* eqn, double& val);
+	bool createEquation(Node* node, int row, vector<Eigen::Triplet<double> >& eqn, double& val);
 
 	/*
 	*	craetes the equation V2 - V1 = E of the voltage source
 	*	in the form Ax = B where A is a matrix with one row, B a value
 	*	@param vsource : the voltage source
-	*	@param eqn : A
+	*	@param row : the row of A the equation goes to
+	*	@param eqn : the coefficients of A as (row, column, value) triplets
 	*	@param val : B
 	*/
-	bool createEquation(Element* vsource, double* eqn, double& val);
+	bool createEquation(Element* vsource, int row, vector<Eigen::Triplet<double> >& eqn, double& val);
+
+	/*
+	*	stamps the port admittance Y and the Norton currents J of a subcircuit instance
+	*	into the equations of the nodes its ports are connected to
+	*	@param instance : the instance
+	*	@param eqn : the coefficients of A as (row, column, value) triplets
+	*	@param vals : B
+	*/
+	bool createEquation(Instance* instance, vector<Eigen::Triplet<double> >& eqn, Eigen::VectorXd& vals);
 
 	/*
 	*	solves the system of linear equations Ax = B
 	*	@param eqn : A
 	*	@param vals : B
+	*	@param x : the solution
+	*/
+	bool solveEquations(const SparseMatrix& eqn, const Eigen::VectorXd& vals, Eigen::VectorXd& x);
+
+	// solves AX = B for every column of B with one factorization
+	bool solveEquations(const SparseMatrix& eqn, const Eigen::MatrixXd& vals, Eigen::MatrixXd& x);
+
+	/*
+	*	solves AX = B in the reference of getReference and moves the solution back to the ground
+	*	@param factorize : false solves with the factors of the last call, for more columns of the same system
+	*/
+	bool solveReferenced(const SparseMatrix& eqn, const Eigen::MatrixXd& vals, Eigen::MatrixXd& x, bool factorize);
+
+	// solves AX = B with the factors of the last solve, with an error unless the backward error is acceptable
+	bool solveAgain(const Eigen::MatrixXd& vals, Eigen::MatrixXd& x);
+
+	// solves AX = B with the backend "type", AUTO selects one, falling back to the robust ones
+	bool solveSystem(const SparseMatrix& eqn, const Eigen::MatrixXd& vals, Eigen::MatrixXd& x, LinearSolver::Type type);
+
+	// the node whose removal leaves the narrowest band, -1 when it is the ground. a hub other than the ground
+	// (a supply rail feeding every stage of a ladder) would stretch the band across the whole chain.
+	// under AUTO the reference only moves when the moved system goes to the banded backend
+	int getReference(const SparseMatrix& eqn);
+
+	/*
+	*	the system with node "reference" as the reference in place of the ground: the unknown and the
+	*	equation of "reference" become those of the ground, whose voltage is then measured from "reference"
+	*	@param eqn, vals : the system of createEquations
+	*	@param moved : the system in the new reference
 	*/
-	bool solveEquations(double* eqn, double* vals);
+	void moveReference(const SparseMatrix& eqn, int reference, SparseMatrix& moved);
+	void moveReference(const Eigen::MatrixXd& vals, int reference, Eigen::MatrixXd& moved);
+
+	// gets the fill-reducing ordering of "eqn", computing it only when the topology changed
+	const Ordering::Permutation& getOrdering(const SparseMatrix& eqn);
+
+	// factorizes and solves with one backend, returns false unless the backward error is acceptable
+	bool trySolve(LinearSolver::Type type, const SparseMatrix& eqn, const Eigen::MatrixXd& vals, Eigen::MatrixXd& x);
+
+	// factorizes the system for the point queries once per topology, NULL with an error if it is singular
+	SelectiveSolver* getSelectiveSolver();
+
+	// the bitmask of the closed switches
+	void getSwitchState(FactorCache::Key& state);
+
+	// the right hand side entries of source "source" alone
+	void addSourceTerms(Element* source, vector<int>& rows, vector<double>& values);
+
+	// the unknowns of nodes (their voltage) or voltage sources and switches (their current), -1 for the ground
+	bool findUnknowns(const vector<string>& names, vector<int>& ids);
+
+	// finds the nodes of the ports, false if one does not exist or a port is shorted on itself
+	bool getPortNodes(const vector<string>& posNodes, const vector<string>& negNodes, vector<Node*>& pos, vector<Node*>& neg);
 
 	void deployResults(double* vals);
+
+	// the loop formulation when it is the one chosen for the present topology, NULL for the nodal equations
+	LoopAnalysis* getLoopAnalysis();
+
+	// the sparsifier of the present topology, NULL when the circuit is solved exactly
+	Sparsifier* getSparsifier();
 
 	bool _solve();
 
@@ -69,6 +240,8 @@ public:
 
 	// a Constructor, same functionality as "init" functions
 	Circuit();
+	// frees the nodes, elements, subcircuits and instances of the circuit
+	~Circuit();
 
 	// solves the circuit and deploys the results
 	bool solve();
@@ -76,13 +249,36 @@ public:
 	// adds an element with name "name", type "type" and value "value" to the node "nodename"
 	bool addElement(string name, double value, string nodename, Element::ElementType et);
 
+	// adds an element connected across "posNode" and "negNode", adding the nodes that do not exist yet.
+	// follows the conventions of Element for the sign of "value".
+	bool addElement(string name, double value, string posNode, string negNode, Element::ElementType et);
+
 	// adds a node with name "name"
 	bool addNode(string name);
 
+	// adds the subcircuit definition "definition" and takes ownership of it, false if its name is taken.
+	bool addSubcircuit(Subcircuit* definition);
+
+	// gets the subcircuit definition "name", NULL if there is none.
+	Subcircuit* getSubcircuit(string name);
+
+	// instantiates the subcircuit "definition" as "name" on "nodes", one per port, adding the nodes that do not exist yet.
+	// definitions without a port admittance (a source across two ports) are flattened into ordinary elements.
+	bool addInstance(string name, string definition, const vector<string>& nodes);
+
+	// gets the number of subcircuit instances that are solved through their reduced models.
+	int getNumInstances();
+
+	// gets the type of element "name", ERROR if there is no such element.
+	Element::ElementType getElementType(string name);
+
+	// whether "name" is a node or an element of the circuit itself, not one inside an instance
+	bool isTopLevel(string name);
+
 	// gets current through element "name"
 	double getCurrent(string name);
 
-	// gets voltage across element or node "name"
+	// gets voltage across element or node "name", names inside an instance are "instance.local"
 	double getVoltage(string name);
 
 	// gets the names of the nodes an element is connected across.
@@ -91,18 +287,62 @@ public:
 	// solves due to sourcename
 	bool solveDue(string sourcename);
 
+	// gets the responses "outputs" (voltages of nodes, currents of voltage sources) to the source "sourcename" alone,
+	// leaving the deployed solution as it is. only the parts of the factors the source reaches and the outputs
+	// depend on are visited, which keeps point queries on large circuits far cheaper than a full solve.
+	bool solveDue(string sourcename, const vector<string>& outputs, vector<double>& values);
+
 	// gets power dissipated or supplied by an element
 	double getPower(string name);
 
 	// gets the resistance of an element.
 	double getResistance(string name);
 
-	// gets the number of voltage sources in the circuit.
+	// gets the number of voltage sources in the circuit, switches included.
 	int getNumVoltageSources();
+
+	// opens or closes the switch "name", false if there is no such switch. the topology is kept, the next solve
+	// factorizes the new state unless the factors of an earlier visit of it are still cached.
+	bool setSwitch(string name, bool closed);
+
+	// gets the number of switches in the circuit.
+	int getNumSwitches();
+
+	// bounds the bytes of the factors kept for the switch states, the least recently used ones are evicted beyond it.
+	void setFactorCacheCapacity(long bytes);
+
+	// gets the factors of the switch states, with their hit and miss counters.
+	FactorCache* getFactorCache();
 
 	// gets the maximum power transferred to the resistor and the value of the resistance in such case.
 	double getMaxPower(string name, double& Rmax);
 
+	/*
+	*	the impedance matrix of the ports (posNodes[k], negNodes[k]) and their open-circuit voltages,
+	*	V = openVoltages + Z I where I[k] is the current driven into posNodes[k] and out of negNodes[k].
+	*	the circuit is left as it is: the ports are unit current injections added to the right hand side,
+	*	factorized once and solved a block of ports at a time.
+	*/
+	bool getPortImpedances(const vector<string>& posNodes, const vector<string>& negNodes, Eigen::MatrixXd& Z, Eigen::VectorXd& openVoltages);
+
+	// the admittance matrix Y = Z^-1 of the ports and the currents Y openVoltages their short circuits carry
+	// from posNodes[k] to negNodes[k], false when Z is singular (ports tied by an ideal source).
+	bool getPortAdmittances(const vector<string>& posNodes, const vector<string>& negNodes, Eigen::MatrixXd& Y, Eigen::VectorXd& shortCurrents);
+
+	// gets the Thevenin equivalent seen between "posNode" and "negNode", from two point queries.
+	bool getThevenin(string posNode, string negNode, double& voltage, double& resistance);
+
+	// gets the Norton equivalent seen between "posNode" and "negNode", false when its resistance is zero.
+	bool getNorton(string posNode, string negNode, double& current, double& conductance);
+
+	// gets the effective resistance between "node1" and "node2" with every source turned off, DBL_MAX on error.
+	// the first query factorizes the resistor network, the following ones reuse it until the topology changes.
+	double getEffectiveResistance(string node1, string node2);
+
+	// gets the effective resistance engine of the circuit, for batches of exact queries and the approximate
+	// all-pairs and driving-point maps, NULL if the network can not be factorized.
+	EffectiveResistance* getEffectiveResistances();
+
 	// checks if the circuit's connections are correct.
 	bool checkCircuit();
 
@@ -111,6 +351,58 @@ public:
 
 	bool checkPowerBalance(double& dissipated, double& supplied);
 
+	// writes the circuit, and its last solution if "withSolution" is set, to a binary snapshot file.
+	bool saveSnapshot(string path, bool withSolution);
+
+	// loads a binary snapshot into this circuit, which must be empty.
+	bool loadSnapshot(string path);
+
+	// writes every node voltage and element voltage/current/power of the last solve.
+	bool exportResults(ResultExporter* exporter);
+
+	// streams the results of every following solve to "exporter", NULL stops streaming. the solves are numbered
+	// from 0 in the order this circuit streams them, across every exporter it streams to.
+	// false unless the exporter is indexed (see ResultExporter::open).
+	bool setResultStream(ResultExporter* exporter);
+
+	// chooses the linear solver backend, AUTO (the default) selects one from the system's size, symmetry and density.
+	void setSolver(LinearSolver::Type type);
+
+	// gets the backend that solved the last system.
+	LinearSolver::Type getLastSolver();
+
+	// chooses the fill-reducing ordering of the sparse backends, AUTO (the default) keeps the one with the least fill.
+	void setOrdering(Ordering::Type type);
+
+	// gets the ordering of the last sparse factorization.
+	Ordering::Type getLastOrdering();
+
+	// chooses between the nodal and the loop equations, AUTO (the default) takes the one with fewer unknowns.
+	// the results are the same either way.
+	void setFormulation(LoopAnalysis::Formulation formulation);
+
+	// gets the formulation of the last solve.
+	LoopAnalysis::Formulation getLastFormulation();
+
+	// solves on a spectral sparsifier of the resistors within "epsilon" in place of the full network, for dense
+	// networks, refining the solution against the full system when "refine" is set. 0 (the default) solves exactly.
+	void setSparsification(double epsilon, bool refine);
+
+	// gets the sparsifier of the last solve, NULL when it was solved exactly.
+	Sparsifier* getLastSparsifier();
+
+	// gets the normwise backward error of the last solve, |b - A x| / (|A| |x| + |b|).
+	double getBackwardError();
+
+	// gets the estimated 1-norm condition number of the last system, -1 if it was not estimated.
+	double getConditionEstimate();
+
+	// turns the collection of per-phase timings and counters on or off.
+	void enableStats(bool enabled);
+
+	// gets the statistics collected so far, readers may also record their parse time in them.
+	SolveStats* getStats();
+
 };
 
 
@@ -0,0 +1,290 @@
+#include "ContingencyAnalysis.h"
+#include "Circuit.h"
+#include "ResultExport.h"
+#include <cfloat>
+#include <cmath>
+
+// a rank-one update whose pivot falls below this fraction of its terms is singular
+#define SINGULAR_UPDATE_TOLERANCE 1e-9
+
+static const char* outageNames[] = { "open", "short" };
+static const char* statusNames[] = { "solved", "islanded", "invalid" };
+
+ContingencyAnalysis::ContingencyAnalysis(Circuit* c) {
+	circuit = c;
+	n = 0;
+	ready = false;
+	if (!c->iscleaned)
+		c->cleanUpSP();
+	SparseMatrix A;
+	Eigen::VectorXd b;
+	c->createEquations(A, b);
+	n = A.rows();
+	if (n == 0)
+		return;
+	lu.compute(A);
+	if (lu.info() != Eigen::Success) {
+		cout << "ERROR: The base circuit is singular, its contingencies can not be analyzed.\n";
+		return;
+	}
+	x = lu.solve(b);
+	ready = lu.info() == Eigen::Success;
+}
+
+bool ContingencyAnalysis::isReady() {
+	return ready;
+}
+
+bool ContingencyAnalysis::addCase(string name, Outage outage) {
+	Element* element = circuit->getElement(name);
+	if (element == NULL) {
+		cout << "ERROR: Element " << name << " does not exist.\n";
+		return false;
+	}
+	if (element->getType() == Element::ElementType::SWITCH) {
+		cout << "ERROR: Switch " << name << " is opened and closed with Circuit::setSwitch, not as a contingency.\n";
+		return false;
+	}
+	if (element->getType() == Element::ElementType::CAPACITOR) {
+		cout << "ERROR: Capacitor " << name << " is open in the DC solution, opening or shorting it is not a contingency.\n";
+		return false;
+	}
+	Result result;
+	result.element = element;
+	result.outage = outage;
+	result.status = INVALID;
+	result.highestNode = result.lowestNode = NULL;
+	result.largestElement = NULL;
+	result.highestVoltage = result.lowestVoltage = result.largestCurrent = 0;
+	results.push_back(result);
+	return true;
+}
+
+void ContingencyAnalysis::addAllCases() {
+	vector<Element*>* lists[] = { circuit->elements, circuit->voltageSources };
+	for (int l = 0; l < 2; l++) {
+		for (vector<Element*>::iterator it = lists[l]->begin(); it != lists[l]->end(); it++) {
+			if ((*it)->getType() == Element::ElementType::SWITCH || (*it)->getType() == Element::ElementType::CAPACITOR)
+				continue;
+			addCase((*it)->getName(), OPEN);
+			addCase((*it)->getName(), SHORT);
+		}
+	}
+}
+
+void ContingencyAnalysis::solvePort(Node* pos, Node* neg, Eigen::VectorXd& w) {
+	Eigen::VectorXd u = Eigen::VectorXd::Zero(n);
+	if (!pos->isGround())
+		u[pos->getId()] += 1;
+	if (!neg->isGround())
+		u[neg->getId()] -= 1;
+	w = lu.solve(u);
+}
+
+double ContingencyAnalysis::across(Node* pos, Node* neg, const Eigen::VectorXd& v) {
+	return (pos->isGround() ? 0 : v[pos->getId()]) - (neg->isGround() ? 0 : v[neg->getId()]);
+}
+
+void ContingencyAnalysis::evaluate(Result& result) {
+	Element* element = result.element;
+	Node* pos = element->getPosNode();
+	Node* neg = element->getNegNode();
+	Element::ElementType type = element->getType();
+	Eigen::VectorXd w, y;
+	// the current through the short from the negative node to the positive, signed as Element::getCurrent
+	double shortCurrent = 0;
+
+	if (type == Element::ElementType::VOLTAGE_SOURCE) {
+		// an ideal source can not be shorted
+		if (result.outage == SHORT) {
+			result.status = INVALID;
+			return;
+		}
+		// with z = A^-1 e_r, the row "current = 0" and no voltage on the right hand side give
+		// y = x - E z and x' = y - z y_r / z_r
+		int r = element->getId();
+		Eigen::VectorXd e = Eigen::VectorXd::Zero(n);
+		e[r] = 1;
+		w = lu.solve(e);
+		if (std::abs(w[r]) <= SINGULAR_UPDATE_TOLERANCE * w.lpNorm<Eigen::Infinity>()) {
+			result.status = ISLANDED;
+			return;
+		}
+		y = x - element->getVoltage() * w;
+		y -= w * (y[r] / w[r]);
+	}
+	else if (type == Element::ElementType::CURRENT_SOURCE && result.outage == OPEN) {
+		solvePort(pos, neg, w);
+		y = x - element->getCurrent() * w;
+	}
+	else if (result.outage == SHORT) {
+		// the limit of A + G u u^T as G grows: x' = x - w (u^T x) / (u^T w), which holds u^T x' = 0
+		solvePort(pos, neg, w);
+		double uw = across(pos, neg, w), ux = across(pos, neg, x);
+		if (std::abs(uw) <= SINGULAR_UPDATE_TOLERANCE * w.lpNorm<Eigen::Infinity>()) {
+			// the nodes are already tied by voltage sources, shorting them changes nothing unless they differ
+			if (std::abs(ux) > SINGULAR_UPDATE_TOLERANCE * x.lpNorm<Eigen::Infinity>()) {
+				result.status = INVALID;
+				return;
+			}
+			y = x;
+		}
+		else {
+			y = x - w * (ux / uw);
+			// G u^T x' tends to u^T x / u^T w, the current the short carries from the positive node to the negative
+			shortCurrent = -ux / uw;
+		}
+	}
+	else {
+		// A - g u u^T: x' = x + w g (u^T x) / (1 - g u^T w), the denominator vanishes when the resistor was a bridge
+		double g = 1 / element->getResistance();
+		solvePort(pos, neg, w);
+		double denominator = 1 - g * across(pos, neg, w);
+		if (std::abs(denominator) <= SINGULAR_UPDATE_TOLERANCE) {
+			result.status = ISLANDED;
+			return;
+		}
+		y = x + w * (g * across(pos, neg, x) / denominator);
+	}
+	if (!y.allFinite()) {
+		result.status = ISLANDED;
+		return;
+	}
+	result.status = SOLVED;
+	summarize(result, y, shortCurrent);
+}
+
+void ContingencyAnalysis::summarize(Result& result, const Eigen::VectorXd& y, double shortCurrent) {
+	result.highestVoltage = -DBL_MAX;
+	result.lowestVoltage = DBL_MAX;
+	for (vector<Node*>::iterator it = circuit->nodes->begin(); it != circuit->nodes->end(); it++) {
+		double v = (*it)->isGround() ? 0 : y[(*it)->getId()];
+		if (v > result.highestVoltage) {
+			result.highestVoltage = v;
+			result.highestNode = *it;
+		}
+		if (v < result.lowestVoltage) {
+			result.lowestVoltage = v;
+			result.lowestNode = *it;
+		}
+	}
+	result.largestCurrent = 0;
+	result.largestElement = NULL;
+	vector<Element*>* lists[] = { circuit->elements, circuit->voltageSources };
+	for (int l = 0; l < 2; l++) {
+		for (vector<Element*>::iterator it = lists[l]->begin(); it != lists[l]->end(); it++) {
+			Element* element = *it;
+			double i;
+			if (element == result.element && result.outage == OPEN)
+				i = 0;
+			// the across voltage of a shorted element is zero, the short carries its current,
+			// a shorted current source still drives its own current around the short
+			else if (element == result.element)
+				i = shortCurrent + (element->getType() == Element::ElementType::CURRENT_SOURCE ? element->getCurrent() : 0);
+			else if (element->getType() == Element::ElementType::RESISTOR)
+				i = -across(element->getPosNode(), element->getNegNode(), y) / element->getResistance();
+			else if (element->getType() == Element::ElementType::CURRENT_SOURCE)
+				i = element->getCurrent();
+			else
+				i = y[element->getId()];
+			if (result.largestElement == NULL || std::abs(i) > std::abs(result.largestCurrent)) {
+				result.largestCurrent = i;
+				result.largestElement = element;
+			}
+		}
+	}
+}
+
+int ContingencyAnalysis::run(ThreadPool* pool) {
+	if (!ready)
+		return 0;
+	// the solves with the factors only read them, the cases share them across the workers
+	pool->parallelFor((int)results.size(), [this](int i) {
+		evaluate(results[i]);
+	});
+	int solved = 0;
+	for (size_t i = 0; i < results.size(); i++)
+		if (results[i].status == SOLVED)
+			solved++;
+	return solved;
+}
+
+int ContingencyAnalysis::getNumCases() {
+	return (int)results.size();
+}
+
+const ContingencyAnalysis::Result& ContingencyAnalysis::getResult(int i) {
+	return results[i];
+}
+
+bool ContingencyAnalysis::writeReport(string path) {
+	BufferedWriter out;
+	if (!out.open(path)) {
+		cout << "ERROR: Can not write " << path << ".\n";
+		return false;
+	}
+	out.putString("element,outage,status,highest node,highest voltage,lowest node,lowest voltage,largest current element,largest current\n");
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+		out.putString(r.element->getName());
+		out.put(',');
+		out.putString(getOutageName(r.outage));
+		out.put(',');
+		out.putString(getStatusName(r.status));
+		if (r.status == SOLVED) {
+			out.put(',');
+			out.putString(r.highestNode->getName());
+			out.put(',');
+			out.putDouble(r.highestVoltage);
+			out.put(',');
+			out.putString(r.lowestNode->getName());
+			out.put(',');
+			out.putDouble(r.lowestVoltage);
+			out.put(',');
+			out.putString(r.largestElement->getName());
+			out.put(',');
+			out.putDouble(r.largestCurrent);
+		}
+		else
+			out.putString(",,,,,,");
+		out.put('\n');
+	}
+	return out.close();
+}
+
+void ContingencyAnalysis::print(ostream& out) {
+	int counts[3] = { 0, 0, 0 };
+	const Result* highest = NULL;
+	const Result* lowest = NULL;
+	const Result* largest = NULL;
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+		counts[r.status]++;
+		if (r.status != SOLVED)
+			continue;
+		if (highest == NULL || r.highestVoltage > highest->highestVoltage)
+			highest = &r;
+		if (lowest == NULL || r.lowestVoltage < lowest->lowestVoltage)
+			lowest = &r;
+		if (largest == NULL || std::abs(r.largestCurrent) > std::abs(largest->largestCurrent))
+			largest = &r;
+	}
+	out << results.size() << " contingencies: " << counts[SOLVED] << " solved, " << counts[ISLANDED] << " islanded, "
+		<< counts[INVALID] << " invalid.\n";
+	if (highest == NULL)
+		return;
+	out << "Highest voltage " << highest->highestVoltage << " volts at Node [" << highest->highestNode->getName() << "] with "
+		<< highest->element->getName() << " " << getOutageName(highest->outage) << ".\n";
+	out << "Lowest voltage " << lowest->lowestVoltage << " volts at Node [" << lowest->lowestNode->getName() << "] with "
+		<< lowest->element->getName() << " " << getOutageName(lowest->outage) << ".\n";
+	out << "Largest current " << largest->largestCurrent << " amperes through " << largest->largestElement->getName() << " with "
+		<< largest->element->getName() << " " << getOutageName(largest->outage) << ".\n";
+}
+
+const char* ContingencyAnalysis::getOutageName(Outage outage) {
+	return outageNames[outage];
+}
+
+const char* ContingencyAnalysis::getStatusName(Status status) {
+	return statusNames[status];
+}
@@ -0,0 +1,94 @@
+#ifndef CONTINGENCYANALYSIS_H
+#define CONTINGENCYANALYSIS_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "Eigen/SparseLU"
+#include "LinearSolver.h"
+#include "ThreadPool.h"
+#include "Element.h"
+
+using namespace std;
+
+class Circuit;
+class Node;
+
+/*
+*	N-1 contingency analysis: the circuit with one element opened or shorted, for many elements.
+*	the base circuit A x = b is factorized once, and every outage is a rank-one change of it
+*	solved with the Sherman-Morrison formula, one solve with the base factors per case:
+*		resistor (or current source) shorted		A + G u u^T with G -> infinity, u = e_pos - e_neg
+*		resistor opened								A - g u u^T
+*		current source opened						b - I u
+*		voltage source opened						its row replaced by "its current is zero"
+*	(a shorted voltage source has no solution.) a case whose update is singular islands part of the circuit,
+*	the nodes cut off from every source and from the ground have no voltage.
+*	the cases run in parallel, each one keeps only its extremes: the highest and the lowest node voltage and
+*	the largest element current.
+*/
+
+class ContingencyAnalysis {
+
+public:
+	enum Outage { OPEN, SHORT };
+	enum Status { SOLVED, ISLANDED, INVALID };
+
+	struct Result {
+		Element* element;
+		Outage outage;
+		Status status;
+		Node* highestNode;
+		double highestVoltage;
+		Node* lowestNode;
+		double lowestVoltage;
+		Element* largestElement;
+		double largestCurrent;		// signed as Element::getCurrent
+	};
+
+private:
+	Circuit* circuit;
+	long n;
+	bool ready;
+	Eigen::SparseLU<SparseMatrix, Eigen::COLAMDOrdering<int> > lu;
+	Eigen::VectorXd x;				// the base solution
+	vector<Result> results;
+
+	// solves A w = e_pos - e_neg, the ground left out
+	void solvePort(Node* pos, Node* neg, Eigen::VectorXd& w);
+	// the voltage across "pos" and "neg" in the unknowns "v"
+	double across(Node* pos, Node* neg, const Eigen::VectorXd& v);
+	void evaluate(Result& result);
+	// records the extremes of the solution "y" of a case, "shortCurrent" flows through the element of a SHORT case
+	void summarize(Result& result, const Eigen::VectorXd& y, double shortCurrent);
+
+public:
+	// factorizes the circuit "c", which must have a solution
+	ContingencyAnalysis(Circuit* c);
+
+	// false if the base circuit could not be factorized
+	bool isReady();
+
+	// adds the outage of element "name", false if there is no such element
+	bool addCase(string name, Outage outage);
+
+	// adds the opening and the shorting of every element
+	void addAllCases();
+
+	// solves every case on "pool", returns the number of cases that have a solution
+	int run(ThreadPool* pool);
+
+	int getNumCases();
+	const Result& getResult(int i);
+
+	// writes one CSV line per case with its extremes
+	bool writeReport(string path);
+
+	// prints the number of cases solved, islanded and invalid, and the worst of them
+	void print(ostream& out);
+
+	static const char* getOutageName(Outage outage);
+	static const char* getStatusName(Status status);
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include "DomainSolver.h"
+#include "Ordering.h"
+#include <algorithm>
+
+// interface columns eliminated per block solve while forming a domain's Schur complement
+#define SCHUR_BLOCK_COLUMNS 64
+
+DomainSolver::DomainSolver(ThreadPool* pool, int parts) {
+	this->pool = pool;
+	this->parts = parts > 0 ? parts : max(2, pool->getNumThreads());
+	n = 0;
+	schurNonzeros = 0;
+	factorNonzeros = 0;
+	factorFlops = 0;
+	solveFlops = 0;
+}
+
+DomainSolver::~DomainSolver() {
+	clear();
+}
+
+void DomainSolver::clear() {
+	for (size_t i = 0; i < domains.size(); i++)
+		delete domains[i];
+	domains.clear();
+	interface.clear();
+}
+
+// nonzeros of the L and U factors of a sparse LU, as counted by the sparse LU backend
+template<typename Factorization>
+static long countNonzeros(Factorization& lu, long n) {
+	return lu.matrixL().m_mapL.colIndexPtr()[n] + lu.matrixU().m_mapU.nonZeros();
+}
+
+bool DomainSolver::factorizeDomain(Domain* d, vector<Eigen::Triplet<double> >& contribution) {
+	long m = d->unknowns.size();
+	d->success = false;
+	d->factorNonzeros = 0;
+	if (m > 0) {
+		d->lu.analyzePattern(d->inner);
+		d->lu.factorize(d->inner);
+		if (d->lu.info() != Eigen::Success)
+			return false;
+		d->factorNonzeros = countNonzeros(d->lu, m);
+	}
+
+	// - A_Gd A_dd^-1 A_dG, a block of interface columns at a time to bound the dense intermediate
+	int k = (int)d->interface.size();
+	for (int c = 0; c < k && m > 0; c += SCHUR_BLOCK_COLUMNS) {
+		int w = min(SCHUR_BLOCK_COLUMNS, k - c);
+		Eigen::MatrixXd z = d->lu.solve(Eigen::MatrixXd(d->toInterface.middleCols(c, w)));
+		if (d->lu.info() != Eigen::Success)
+			return false;
+		Eigen::MatrixXd s = d->fromInterface * z;
+		for (int j = 0; j < w; j++)
+			for (int i = 0; i < k; i++)
+				if (s(i, j) != 0)
+					contribution.push_back(Eigen::Triplet<double>(d->interface[i], d->interface[c + j], -s(i, j)));
+	}
+	d->success = true;
+	return true;
+}
+
+bool DomainSolver::factorize(const SparseMatrix& A) {
+	clear();
+	n = A.rows();
+	vector<int> domainOf;
+	int count = Ordering::partition(A, parts, domainOf);
+
+	// number the unknowns within their domain or within the interface
+	vector<int> local(n);
+	for (int i = 0; i < count; i++)
+		domains.push_back(new Domain());
+	for (int i = 0; i < n; i++) {
+		if (domainOf[i] < 0) {
+			local[i] = (int)interface.size();
+			interface.push_back(i);
+		}
+		else {
+			local[i] = (int)domains[domainOf[i]]->unknowns.size();
+			domains[domainOf[i]]->unknowns.push_back(i);
+		}
+	}
+
+	// split A into its blocks, the partition guarantees that no coefficient couples two domains
+	vector<vector<Eigen::Triplet<double> > > inner(count), toInterface(count), fromInterface(count);
+	vector<Eigen::Triplet<double> > schurTriplets;
+	for (int j = 0; j < A.outerSize(); j++) {
+		for (SparseMatrix::InnerIterator it(A, j); it; ++it) {
+			int i = (int)it.row();
+			int di = domainOf[i], dj = domainOf[j];
+			Eigen::Triplet<double> t(local[i], local[j], it.value());
+			if (di >= 0 && dj >= 0)
+				inner[di].push_back(t);
+			else if (di >= 0)
+				toInterface[di].push_back(t);
+			else if (dj >= 0)
+				fromInterface[dj].push_back(t);
+			else
+				schurTriplets.push_back(t);
+		}
+	}
+
+	vector<vector<Eigen::Triplet<double> > > contributions(count);
+	pool->parallelFor(count, [&](int i) {
+		Domain* d = domains[i];
+		long m = d->unknowns.size();
+		// the interface unknowns the domain touches, and the blocks restricted to them
+		for (size_t k = 0; k < toInterface[i].size(); k++)
+			d->interface.push_back(toInterface[i][k].col());
+		for (size_t k = 0; k < fromInterface[i].size(); k++)
+			d->interface.push_back(fromInterface[i][k].row());
+		sort(d->interface.begin(), d->interface.end());
+		d->interface.erase(unique(d->interface.begin(), d->interface.end()), d->interface.end());
+		d->inner.resize(m, m);
+		d->inner.setFromTriplets(inner[i].begin(), inner[i].end());
+		d->inner.makeCompressed();
+		vector<Eigen::Triplet<double> >().swap(inner[i]);
+
+		// renumber the domain by minimum degree, the interface blocks and the unknown list follow
+		Ordering::Permutation perm(m);
+		perm.setIdentity();
+		if (m > 0) {
+			Ordering::compute(d->inner, Ordering::AMD, perm);
+			d->inner = d->inner.twistedBy(perm);
+			vector<int> unknowns(m);
+			for (long u = 0; u < m; u++)
+				unknowns[perm.indices()[u]] = d->unknowns[u];
+			d->unknowns.swap(unknowns);
+		}
+		for (size_t k = 0; k < toInterface[i].size(); k++) {
+			Eigen::Triplet<double>& t = toInterface[i][k];
+			int c = (int)(lower_bound(d->interface.begin(), d->interface.end(), t.col()) - d->interface.begin());
+			t = Eigen::Triplet<double>(perm.indices()[t.row()], c, t.value());
+		}
+		for (size_t k = 0; k < fromInterface[i].size(); k++) {
+			Eigen::Triplet<double>& t = fromInterface[i][k];
+			int r = (int)(lower_bound(d->interface.begin(), d->interface.end(), t.row()) - d->interface.begin());
+			t = Eigen::Triplet<double>(r, perm.indices()[t.col()], t.value());
+		}
+		long k = d->interface.size();
+		d->toInterface.resize(m, k);
+		d->toInterface.setFromTriplets(toInterface[i].begin(), toInterface[i].end());
+		d->fromInterface.resize(k, m);
+		d->fromInterface.setFromTriplets(fromInterface[i].begin(), fromInterface[i].end());
+		factorizeDomain(d, contributions[i]);
+	});
+
+	factorNonzeros = 0;
+	factorFlops = 0;
+	for (int i = 0; i < count; i++) {
+		Domain* d = domains[i];
+		if (!d->success)
+			return false;
+		double m = (double)max((size_t)1, d->unknowns.size());
+		factorNonzeros += d->factorNonzeros;
+		factorFlops += (double)d->factorNonzeros * d->factorNonzeros / (2.0 * m)
+			+ 2.0 * d->factorNonzeros * d->interface.size() + 2.0 * d->fromInterface.nonZeros() * d->interface.size();
+		schurTriplets.insert(schurTriplets.end(), contributions[i].begin(), contributions[i].end());
+		vector<Eigen::Triplet<double> >().swap(contributions[i]);
+	}
+
+	long g = interface.size();
+	schurNonzeros = 0;
+	if (g > 0) {
+		SparseMatrix S(g, g);
+		S.setFromTriplets(schurTriplets.begin(), schurTriplets.end());
+		S.makeCompressed();
+		schur.analyzePattern(S);
+		schur.factorize(S);
+		if (schur.info() != Eigen::Success)
+			return false;
+		schurNonzeros = countNonzeros(schur, g);
+		factorFlops += (double)schurNonzeros * schurNonzeros / (2.0 * g);
+	}
+	factorNonzeros += schurNonzeros;
+	return true;
+}
+
+bool DomainSolver::solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+	int count = (int)domains.size();
+	long g = interface.size();
+	x.resize(n);
+
+	// condense the right hand side onto the interface, b_G - sum A_Gd A_dd^-1 b_d
+	vector<Eigen::VectorXd> condensed(count);
+	vector<char> ok(count, 1);
+	pool->parallelFor(count, [&](int i) {
+		Domain* d = domains[i];
+		if (d->unknowns.empty() || d->interface.empty())
+			return;
+		Eigen::VectorXd bd(d->unknowns.size());
+		for (size_t k = 0; k < d->unknowns.size(); k++)
+			bd[k] = b[d->unknowns[k]];
+		Eigen::VectorXd y = d->lu.solve(bd);
+		ok[i] = d->lu.info() == Eigen::Success;
+		condensed[i] = d->fromInterface * y;
+	});
+	Eigen::VectorXd xG(g);
+	for (long i = 0; i < g; i++)
+		xG[i] = b[interface[i]];
+	for (int i = 0; i < count; i++) {
+		if (!ok[i])
+			return false;
+		for (long k = 0; k < condensed[i].size(); k++)
+			xG[domains[i]->interface[k]] -= condensed[i][k];
+	}
+	if (g > 0) {
+		xG = schur.solve(Eigen::VectorXd(xG));
+		if (schur.info() != Eigen::Success)
+			return false;
+	}
+	for (long i = 0; i < g; i++)
+		x[interface[i]] = xG[i];
+
+	// back substitute every domain, x_d = A_dd^-1 (b_d - A_dG x_G)
+	pool->parallelFor(count, [&](int i) {
+		Domain* d = domains[i];
+		if (d->unknowns.empty())
+			return;
+		Eigen::VectorXd rhs(d->unknowns.size()), xI(d->interface.size());
+		for (size_t k = 0; k < d->unknowns.size(); k++)
+			rhs[k] = b[d->unknowns[k]];
+		for (size_t k = 0; k < d->interface.size(); k++)
+			xI[k] = xG[d->interface[k]];
+		rhs -= d->toInterface * xI;
+		Eigen::VectorXd xd = d->lu.solve(rhs);
+		ok[i] = d->lu.info() == Eigen::Success;
+		for (size_t k = 0; k < d->unknowns.size(); k++)
+			x[d->unknowns[k]] = xd[k];
+	});
+	solveFlops = 4.0 * factorNonzeros;
+	for (int i = 0; i < count; i++)
+		if (!ok[i])
+			return false;
+	return true;
+}
+
+LinearSolver::Type DomainSolver::getType() {
+	return DOMAIN_DECOMPOSITION;
+}
+
+long DomainSolver::getFactorNonzeros() {
+	return factorNonzeros;
+}
+
+double DomainSolver::getFactorFlops() {
+	return factorFlops;
+}
+
+double DomainSolver::getSolveFlops() {
+	return solveFlops;
+}
+
+int DomainSolver::getNumDomains() {
+	return (int)domains.size();
+}
+
+long DomainSolver::getInterfaceSize() {
+	return interface.size();
+}
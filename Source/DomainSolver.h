@@ -0,0 +1,69 @@
+#ifndef DOMAINSOLVER_H
+#define DOMAINSOLVER_H
+
+#include <vector>
+#include "LinearSolver.h"
+#include "ThreadPool.h"
+#include "Eigen/SparseLU"
+
+/*
+*	domain decomposition backend. the unknowns are split into domains that only touch each other through
+*	separator (interface) unknowns, which orders the system as
+*		| A_11          A_1G |   | x_1 |   | b_1 |
+*		|       A_22    A_2G | * | x_2 | = | b_2 |
+*		| A_G1  A_G2    A_GG |   | x_G |   | b_G |
+*	the domain blocks A_dd are factorized in parallel and each domain adds its part of the interface
+*	Schur complement S = A_GG - sum A_Gd A_dd^-1 A_dG, computed in parallel too. only S is factorized globally,
+*	a solve is then two parallel sweeps of domain solves around one interface solve.
+*/
+
+class DomainSolver : public LinearSolver {
+
+private:
+	// the domains are ordered by minimum degree beforehand, like the sparse LU backend
+	typedef Eigen::SparseLU<SparseMatrix, Eigen::NaturalOrdering<int> > Factorization;
+
+	struct Domain {
+		vector<int> unknowns;		// the unknowns of the domain, global numbering
+		vector<int> interface;		// the interface unknowns it touches, numbered within the interface
+		SparseMatrix inner;			// A_dd
+		SparseMatrix toInterface;	// A_dG restricted to "interface", rows of the domain
+		SparseMatrix fromInterface;	// A_Gd restricted to "interface", columns of the domain
+		Factorization lu;
+		long factorNonzeros;
+		bool success;
+	};
+
+	ThreadPool* pool;
+	int parts;
+	long n;
+	vector<Domain*> domains;
+	vector<int> interface;			// the interface unknowns, global numbering
+	// the Schur complement is assembled in interface order, which leaves it to its own column ordering
+	Eigen::SparseLU<SparseMatrix, Eigen::COLAMDOrdering<int> > schur;
+	long schurNonzeros;
+	long factorNonzeros;
+	double factorFlops;
+	double solveFlops;
+
+	void clear();
+	bool factorizeDomain(Domain* d, vector<Eigen::Triplet<double> >& contribution);
+
+public:
+	// "parts" domains solved on "pool", 0 parts makes one per thread of the pool
+	DomainSolver(ThreadPool* pool, int parts);
+	~DomainSolver();
+
+	bool factorize(const SparseMatrix& A);
+	bool solve(const Eigen::VectorXd& b, Eigen::VectorXd& x);
+	Type getType();
+	long getFactorNonzeros();
+	double getFactorFlops();
+	double getSolveFlops();
+
+	// number of domains and interface unknowns of the last factorization
+	int getNumDomains();
+	long getInterfaceSize();
+};
+
+#endif
@@ -0,0 +1,244 @@
+#include "EffectiveResistance.h"
+#include "Circuit.h"
+#include "NodeMerge.h"
+#include "RefinedSolver.h"
+#include "Ordering.h"
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <iostream>
+
+// right hand sides per solve, bounds the memory of the exact batches and of building the sketch
+#define BLOCK_COLUMNS 64
+
+EffectiveResistance::EffectiveResistance(Circuit* c, LinearSolver::Type type) {
+	circuit = c;
+	ready = false;
+	n = 0;
+	solver = NULL;
+	if (!c->iscleaned)
+		c->cleanUpSP();
+	if (!c->instances->empty()) {
+		cout << "ERROR: Effective resistances are not supported across subcircuit instances.\n";
+		return;
+	}
+
+	// the rows of L, the nodes shorted together by a voltage source share one
+	Node* floating;
+	long merged = NodeMerge::merge(c, rowOf, floating);
+	if (merged < 0) {
+		cout << "ERROR: Node [" << floating->getName() << "] has no resistive path to the ground, its effective resistances are infinite.\n";
+		return;
+	}
+	n = merged;
+
+	vector<Eigen::Triplet<double> > triplets;
+	for (vector<Element*>::iterator it = c->elements->begin(); it != c->elements->end(); it++) {
+		if ((*it)->getType() != Element::ElementType::RESISTOR)
+			continue;
+		Edge edge;
+		edge.a = rowOf[NodeMerge::slotOf((*it)->getPosNode())];
+		edge.b = rowOf[NodeMerge::slotOf((*it)->getNegNode())];
+		if (edge.a == edge.b)
+			continue;
+		double g = 1 / (*it)->getResistance();
+		edge.root = sqrt(g);
+		edges.push_back(edge);
+		if (edge.a >= 0)
+			triplets.push_back(Eigen::Triplet<double>(edge.a, edge.a, g));
+		if (edge.b >= 0)
+			triplets.push_back(Eigen::Triplet<double>(edge.b, edge.b, g));
+		if (edge.a >= 0 && edge.b >= 0) {
+			triplets.push_back(Eigen::Triplet<double>(edge.a, edge.b, -g));
+			triplets.push_back(Eigen::Triplet<double>(edge.b, edge.a, -g));
+		}
+	}
+	L.resize(n, n);
+	L.setFromTriplets(triplets.begin(), triplets.end());
+	L.makeCompressed();
+	if (n == 0) {
+		ready = true;
+		return;
+	}
+
+	// L is symmetric positive definite, the backend is picked as for a circuit without voltage sources
+	if (type == LinearSolver::AUTO)
+		type = c->solverType == LinearSolver::AUTO ? LinearSolver::select(L) : c->solverType;
+	solver = new RefinedSolver(LinearSolver::create(type), NULL);
+	if (LinearSolver::usesOrdering(type)) {
+		Ordering::Permutation perm;
+		Ordering::compute(L, c->orderingType, perm);
+		solver->setOrdering(perm);
+	}
+	ready = solver->factorize(L);
+	if (!ready)
+		cout << "ERROR: The resistor network could not be factorized.\n";
+}
+
+EffectiveResistance::~EffectiveResistance() {
+	delete solver;
+}
+
+bool EffectiveResistance::isReady() {
+	return ready;
+}
+
+long EffectiveResistance::getNumNodes() {
+	return n;
+}
+
+bool EffectiveResistance::findRow(string name, int& row) {
+	Node* node = circuit->getNode(name);
+	if (node == NULL) {
+		cout << "ERROR: Node [" << name << "] does not exist.\n";
+		return false;
+	}
+	row = rowOf[NodeMerge::slotOf(node)];
+	return true;
+}
+
+bool EffectiveResistance::findRows(const vector<string>& names, vector<int>& rows) {
+	rows.resize(names.size());
+	for (size_t i = 0; i < names.size(); i++)
+		if (!findRow(names[i], rows[i]))
+			return false;
+	return true;
+}
+
+double EffectiveResistance::getResistance(string node1, string node2) {
+	vector<double> resistances;
+	if (!getResistances(vector<string>(1, node1), vector<string>(1, node2), resistances))
+		return DBL_MAX;
+	return resistances[0];
+}
+
+bool EffectiveResistance::getResistances(const vector<string>& from, const vector<string>& to, vector<double>& resistances) {
+	vector<int> a, b;
+	if (!ready || from.size() != to.size() || !findRows(from, a) || !findRows(to, b))
+		return false;
+	long pairs = a.size();
+	resistances.assign(pairs, 0);
+	// a unit current into a and out of b, R is then the voltage between them
+	Eigen::MatrixXd rhs, x;
+	for (long first = 0; first < pairs; first += BLOCK_COLUMNS) {
+		long last = min(first + BLOCK_COLUMNS, pairs);
+		rhs = Eigen::MatrixXd::Zero(n, last - first);
+		bool any = false;
+		for (long k = first; k < last; k++) {
+			if (a[k] == b[k])
+				continue;
+			any = true;
+			if (a[k] >= 0)
+				rhs(a[k], k - first) += 1;
+			if (b[k] >= 0)
+				rhs(b[k], k - first) -= 1;
+		}
+		if (!any)
+			continue;
+		if (!solver->solveMany(rhs, x) || solver->getBackwardError() > BACKWARD_ERROR_TOLERANCE) {
+			cout << "ERROR: The effective resistances could not be solved accurately.\n";
+			return false;
+		}
+		for (long k = first; k < last; k++)
+			if (a[k] != b[k])
+				resistances[k] = (a[k] >= 0 ? x(a[k], k - first) : 0) - (b[k] >= 0 ? x(b[k], k - first) : 0);
+	}
+	return true;
+}
+
+int EffectiveResistance::getSketchDimensions(long nodes, double epsilon) {
+	// Achlioptas' bound for +-1 projections, failing with probability 1/n over all pairs.
+	// it only holds for epsilon in (0, 1), its denominator is not positive from epsilon = 1.5 on
+	if (!(epsilon > 0 && epsilon < 1)) {
+		cout << "ERROR: The sketch epsilon must be between 0 and 1.\n";
+		return 0;
+	}
+	double dimensions = 6 * log((double)max(nodes, 2L)) / (epsilon * epsilon / 2 - epsilon * epsilon * epsilon / 3);
+	return (int)ceil(dimensions);
+}
+
+bool EffectiveResistance::buildSketch(int dimensions, unsigned seed) {
+	if (!ready || dimensions <= 0)
+		return false;
+	Z.resize(n, dimensions);
+	if (n == 0)
+		return true;
+	// column j of Z is L^-1 B^T W^1/2 q_j for the j-th row q_j of Q, drawn block by block
+	mt19937 random(seed);
+	double scale = 1 / sqrt((double)dimensions);
+	Eigen::MatrixXd rhs, x;
+	for (int first = 0; first < dimensions; first += BLOCK_COLUMNS) {
+		int last = min(first + BLOCK_COLUMNS, dimensions);
+		rhs = Eigen::MatrixXd::Zero(n, last - first);
+		for (size_t e = 0; e < edges.size(); e++) {
+			for (int j = 0; j < last - first; j++) {
+				double q = (random() & 1) ? edges[e].root * scale : -edges[e].root * scale;
+				if (edges[e].a >= 0)
+					rhs(edges[e].a, j) += q;
+				if (edges[e].b >= 0)
+					rhs(edges[e].b, j) -= q;
+			}
+		}
+		if (!solver->solveMany(rhs, x)) {
+			cout << "ERROR: The resistance sketch could not be solved.\n";
+			Z.resize(0, 0);
+			return false;
+		}
+		Z.middleCols(first, last - first) = x;
+	}
+	return true;
+}
+
+int EffectiveResistance::getSketchDimensions() {
+	return Z.cols();
+}
+
+double EffectiveResistance::distance(int a, int b) {
+	if (a == b)
+		return 0;
+	if (a < 0)
+		return Z.row(b).squaredNorm();
+	if (b < 0)
+		return Z.row(a).squaredNorm();
+	return (Z.row(a) - Z.row(b)).squaredNorm();
+}
+
+double EffectiveResistance::estimateResistance(string node1, string node2) {
+	int a, b;
+	if (Z.cols() == 0 || Z.rows() != n || !findRow(node1, a) || !findRow(node2, b))
+		return DBL_MAX;
+	return distance(a, b);
+}
+
+bool EffectiveResistance::estimateResistances(const vector<string>& names, Eigen::MatrixXd& resistances) {
+	vector<int> rows;
+	if (Z.cols() == 0 || Z.rows() != n || !findRows(names, rows))
+		return false;
+	// |z_a - z_b|^2 = |z_a|^2 + |z_b|^2 - 2 z_a.z_b, every dot product from one matrix product
+	long count = rows.size();
+	Eigen::MatrixXd S = Eigen::MatrixXd::Zero(count, Z.cols());
+	for (long i = 0; i < count; i++)
+		if (rows[i] >= 0)
+			S.row(i) = Z.row(rows[i]);
+	Eigen::MatrixXd G = S * S.transpose();
+	resistances.resize(count, count);
+	for (long j = 0; j < count; j++)
+		for (long i = 0; i < count; i++)
+			resistances(i, j) = rows[i] == rows[j] ? 0 : max(G(i, i) + G(j, j) - 2 * G(i, j), 0.0);
+	return true;
+}
+
+bool EffectiveResistance::estimateDrivingPoints(string reference, vector<string>& names, vector<double>& resistances) {
+	int r;
+	if (Z.cols() == 0 || Z.rows() != n || !findRow(reference, r))
+		return false;
+	names.clear();
+	resistances.clear();
+	for (vector<Node*>::iterator it = circuit->nodes->begin(); it != circuit->nodes->end(); it++) {
+		if ((*it)->getName() == reference)
+			continue;
+		names.push_back((*it)->getName());
+		resistances.push_back(distance(rowOf[NodeMerge::slotOf(*it)], r));
+	}
+	return true;
+}
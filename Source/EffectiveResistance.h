@@ -0,0 +1,97 @@
+#ifndef EFFECTIVERESISTANCE_H
+#define EFFECTIVERESISTANCE_H
+
+#include <string>
+#include <vector>
+#include "Eigen/Dense"
+#include "LinearSolver.h"
+
+using namespace std;
+
+class Circuit;
+class Node;
+class RefinedSolver;
+
+/*
+*	effective resistances between the nodes of a circuit with every source turned off: the voltage sources
+*	short their nodes together and the current sources are left open.
+*	the network is reduced once to its grounded Laplacian L, the conductance matrix of the resistors with the
+*	ground's row and column removed, which is factorized for the exact queries:
+*		R(a, b) = (e_a - e_b)^T L^-1 (e_a - e_b)
+*	the approximate queries read a random projection of the network (Spielman and Srivastava). with B the
+*	resistor incidence matrix, W their conductances and Q a k x m matrix of random +-1/sqrt(k),
+*	the columns of Z = Q W^1/2 B L^-1 satisfy
+*		R(a, b) ~ |Z e_a - Z e_b|^2
+*	within a factor 1 +- epsilon for every pair at once when k grows as log(n) / epsilon^2 (Johnson-Lindenstrauss).
+*	Z costs k solves and n k doubles, after which any pair is a k-term distance.
+*	the values are the ones at construction, Circuit rebuilds the engine when its topology changes.
+*/
+
+class EffectiveResistance {
+
+private:
+	Circuit* circuit;
+	bool ready;
+
+	// a resistor between rows a and b of L, -1 for the ground, with the square root of its conductance
+	struct Edge {
+		int a, b;
+		double root;
+	};
+
+	// the row of L every node is reduced to, -1 for the ground and the nodes shorted to it, by node id + 1
+	vector<int> rowOf;
+	long n;
+	SparseMatrix L;
+	vector<Edge> edges;
+	RefinedSolver* solver;
+
+	// the sketch, one row per row of L, k columns
+	Eigen::MatrixXd Z;
+
+	// the row of L of node "name", false with an error if there is no such node
+	bool findRow(string name, int& row);
+	bool findRows(const vector<string>& names, vector<int>& rows);
+	double distance(int a, int b);
+
+public:
+	// reduces and factorizes the resistor network of "c" with backend "type", AUTO for the one the circuit
+	// would use, see isReady
+	EffectiveResistance(Circuit* c, LinearSolver::Type type = LinearSolver::AUTO);
+	~EffectiveResistance();
+
+	// false if the network could not be factorized (a node with no resistive path to the ground)
+	bool isReady();
+
+	// gets the number of nodes left once the shorted ones are merged and the ground removed
+	long getNumNodes();
+
+	// gets the exact effective resistance between "node1" and "node2", DBL_MAX on error
+	double getResistance(string node1, string node2);
+
+	// gets the exact effective resistances between from[k] and to[k], all pairs solved together
+	bool getResistances(const vector<string>& from, const vector<string>& to, vector<double>& resistances);
+
+	// the sketch dimension k that keeps every resistance within 1 +- epsilon with probability 1 - 1/n,
+	// 0 for an epsilon outside (0, 1), which buildSketch rejects
+	static int getSketchDimensions(long nodes, double epsilon);
+
+	/*
+	*	builds the random projection with "dimensions" rows, the error/space trade-off of the approximate queries:
+	*	the relative error shrinks as 1/sqrt(dimensions) and the sketch holds dimensions doubles per node.
+	*/
+	bool buildSketch(int dimensions, unsigned seed);
+	int getSketchDimensions();
+
+	// gets the approximate effective resistance between "node1" and "node2" from the sketch, DBL_MAX on error
+	double estimateResistance(string node1, string node2);
+
+	// gets the approximate effective resistances between every two nodes of "names" from the sketch
+	bool estimateResistances(const vector<string>& names, Eigen::MatrixXd& resistances);
+
+	// gets the approximate driving-point resistance from every node to "reference" from the sketch,
+	// "names" receives the nodes in the order of "resistances"
+	bool estimateDrivingPoints(string reference, vector<string>& names, vector<double>& resistances);
+};
+
+#endif
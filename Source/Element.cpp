@@ -8,8 +8,10 @@ Element::Element(string name, ElementType type, double value) {
 	this->type = type;
 	this->isenabled = true;
 	this->resistance = 0;
+	this->capacitance = 0;
 	this->current = 0;
 	this->voltage = 0;
+	this->closed = false;
 	switch (type) {
 	case CURRENT_SOURCE:
 		this->current = value;
@@ -20,6 +22,12 @@ Element::Element(string name, ElementType type, double value) {
 	case RESISTOR:
 		this->resistance = value;
 		break;
+	case SWITCH:
+		this->closed = value != 0;
+		break;
+	case CAPACITOR:
+		this->capacitance = value;
+		break;
 	default:
 		cout << "ERROR: TYPE UNDEFINED.\n";
 		break;
@@ -46,6 +54,7 @@ double Element::getCurrent() {
 		return -1 * getVoltage() / resistance;
 	case Element::ElementType::CURRENT_SOURCE:
 	case Element::ElementType::VOLTAGE_SOURCE:
+	case Element::ElementType::SWITCH:
 		return current;
 	default:
 		return 0;
@@ -54,6 +63,9 @@ double Element::getCurrent() {
 double Element::getResistance() {
 	return this->resistance;
 }
+double Element::getCapacitance() {
+	return this->capacitance;
+}
 
 double Element::getPower() {
 	return 	-1 * getCurrent()*getVoltage();
@@ -106,6 +118,14 @@ void Element::setEnabled(bool isenabled) {
 	this->isenabled = isenabled;
 }
 
+bool Element::isClosed() {
+	return closed;
+}
+
+void Element::setClosed(bool closed) {
+	this->closed = closed;
+}
+
 void Element::setType(ElementType ET)
 {
 	this->type = ET;
@@ -8,19 +8,23 @@ using namespace std;
 class Node;
 
 /*
-*	An element is any component in the circuit (resistor, current source, voltage source)
+*	An element is any component in the circuit (resistor, current source, voltage source, switch, capacitor)
 *	Every element has two terminals pNode (positive terminal) and nNode (negative terminal)
 *	value is the resistance in case of a resistor, current in case of a current source
-*	and voltage in case of voltage source
+*	and voltage in case of voltage source, for an ideal switch it is 1 when closed and 0 when open,
+*	and the capacitance in farads in case of a capacitor
 *	Conventions used :
 *	1 - in case of a current source, "value" represents the current going from nNode to pNode
 *	2 - in case of a voltage source, "value" represents the voltage difference of pNode - nNode
+*	3 - a switch carries its current like a voltage source, a closed switch is a zero volt source and an open one
+*	carries no current
+*	4 - a capacitor is open in the DC solution, its capacitance only enters the reduced models of ModelReduction
 */
 
 class Element {
 
 public: enum ElementType {
-	RESISTOR, CURRENT_SOURCE, VOLTAGE_SOURCE, ERROR
+	RESISTOR, CURRENT_SOURCE, VOLTAGE_SOURCE, SWITCH, CAPACITOR, ERROR
 };
 
 private:
@@ -29,10 +33,12 @@ private:
 	double voltage;
 	double current;
 	double resistance;
+	double capacitance;
 	ElementType type;
 	string name;	// unique property, each object has distinctive and unique name
 	int id;			// a sequential ID number, might be useful when making the equation
 	bool isenabled;
+	bool closed;	// the state of a switch
 
 public:
 	// a constructor. same functionality as init functions in the last project
@@ -42,6 +48,7 @@ public:
 	double getVoltage();		// get the voltage across the element
 	double getCurrent();		// get the current running through the element
 	double getResistance();
+	double getCapacitance();
 	double getPower();
 	int getId();
 	Node* getPosNode();
@@ -49,6 +56,7 @@ public:
 	ElementType getType();
 	string getName();
 	bool isEnabled();
+	bool isClosed();
 
 	void setPosNode(Node* node);
 	void setNegNode(Node* node);
@@ -56,6 +64,7 @@ public:
 	void setVoltage(double voltage);
 	void setCurrent(double current);
 	void setEnabled(bool isenabled);
+	void setClosed(bool closed);
 
 	// if node == pNode, return nNode, else if node == nNode return pNode, else return NULL
 	Node* getTheOtherNode(Node* node);
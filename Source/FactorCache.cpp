@@ -0,0 +1,95 @@
+#include "FactorCache.h"
+#include "RefinedSolver.h"
+
+FactorCache::FactorCache(long capacity) {
+	this->capacity = capacity;
+	bytes = 0;
+	hits = 0;
+	misses = 0;
+	evictions = 0;
+}
+
+FactorCache::~FactorCache() {
+	clear();
+}
+
+bool FactorCache::find(const Key& key, LinearSolver::Type type, RefinedSolver*& solver) {
+	map<pair<Key, int>, list<Entry>::iterator>::iterator it = index.find(make_pair(key, (int)type));
+	if (it == index.end()) {
+		misses++;
+		return false;
+	}
+	hits++;
+	if (it->second != entries.begin())
+		entries.splice(entries.begin(), entries, it->second);
+	solver = it->second->solver;
+	return true;
+}
+
+void FactorCache::insert(const Key& key, LinearSolver::Type type, RefinedSolver* solver, long bytes) {
+	pair<Key, int> k = make_pair(key, (int)type);
+	map<pair<Key, int>, list<Entry>::iterator>::iterator it = index.find(k);
+	if (it != index.end()) {
+		this->bytes -= it->second->bytes;
+		delete it->second->solver;
+		entries.erase(it->second);
+		index.erase(it);
+	}
+	Entry entry;
+	entry.key = key;
+	entry.type = type;
+	entry.solver = solver;
+	entry.bytes = bytes;
+	entries.push_front(entry);
+	index[k] = entries.begin();
+	this->bytes += bytes;
+	evict();
+}
+
+void FactorCache::evict() {
+	while (entries.size() > 1 && bytes > capacity) {
+		Entry& victim = entries.back();
+		bytes -= victim.bytes;
+		index.erase(make_pair(victim.key, (int)victim.type));
+		delete victim.solver;
+		entries.pop_back();
+		evictions++;
+	}
+}
+
+void FactorCache::clear() {
+	for (list<Entry>::iterator it = entries.begin(); it != entries.end(); it++)
+		delete it->solver;
+	entries.clear();
+	index.clear();
+	bytes = 0;
+}
+
+void FactorCache::setCapacity(long capacity) {
+	this->capacity = capacity;
+	evict();
+}
+
+long FactorCache::getCapacity() {
+	return capacity;
+}
+
+long FactorCache::getBytes() {
+	return bytes;
+}
+
+int FactorCache::getNumEntries() {
+	return (int)entries.size();
+}
+
+long FactorCache::getHits() {
+	return hits;
+}
+
+long FactorCache::getMisses() {
+	return misses;
+}
+
+long FactorCache::getEvictions() {
+	return evictions;
+}
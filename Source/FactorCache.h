@@ -0,0 +1,75 @@
+#ifndef FACTORCACHE_H
+#define FACTORCACHE_H
+
+#include <vector>
+#include <list>
+#include <map>
+#include <stdint.h>
+#include "LinearSolver.h"
+
+using namespace std;
+
+class RefinedSolver;
+
+/*
+*	the factorizations of a switched circuit, one per state of its switches. opening or closing a switch only
+*	changes values in the system, so a converter cycling through a few topologies factorizes each distinct
+*	state once and every later visit of the state solves with the factors kept for it.
+*		the key is the bitmask of the closed switches, bit k of word k / 64 for the k-th switch, and the backend,
+*		a state the fallbacks solved with another backend is kept apart from the one they fell back from,
+*		which is remembered without factors so that it is not tried on the state again.
+*		the entries are kept in least recently used order, the oldest ones are evicted once the factors
+*		hold more bytes than the memory cap. the most recent entry is kept even when it alone is over the cap.
+*	the cache owns its solvers, a solver found is valid until the next insertion or clear.
+*/
+
+class FactorCache {
+
+public:
+	typedef vector<uint64_t> Key;
+
+private:
+	struct Entry {
+		Key key;
+		LinearSolver::Type type;
+		RefinedSolver* solver;
+		long bytes;
+	};
+	// most recently used first
+	list<Entry> entries;
+	map<pair<Key, int>, list<Entry>::iterator> index;
+	long capacity;
+	long bytes;
+	long hits, misses, evictions;
+
+	// evicts the least recently used entries beyond the memory cap, the first one is always kept
+	void evict();
+
+public:
+	// "capacity" bounds the bytes of the cached factors
+	FactorCache(long capacity);
+	~FactorCache();
+
+	// false if the state "key" was not solved with backend "type" yet, else "solver" gets its factors,
+	// NULL if the backend failed on it. counts a hit or a miss
+	bool find(const Key& key, LinearSolver::Type type, RefinedSolver*& solver);
+
+	// caches "solver", which factorized the state "key" and holds about "bytes", and takes ownership of it.
+	// a NULL "solver" records that backend "type" failed on the state
+	void insert(const Key& key, LinearSolver::Type type, RefinedSolver* solver, long bytes);
+
+	// drops every entry, the topology they were factorized for has changed
+	void clear();
+
+	// changes the memory cap, evicting at once the entries beyond it
+	void setCapacity(long capacity);
+
+	long getCapacity();
+	long getBytes();
+	int getNumEntries();
+	long getHits();
+	long getMisses();
+	long getEvictions();
+};
+
+#endif
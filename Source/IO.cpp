@@ -18,17 +18,21 @@ void inputValues (Circuit* c) {
 		cin >> n;
 	} while (n <= 1);
 
-	cout << "Code: [R]esistor, [E] Voltage Source, [J] Current Source.\n";
+	cout << "Code: [R]esistor, [E] Voltage Source, [J] Current Source, [S]witch (1 closed, 0 open), [C]apacitor.\n";
 	do {
 		for (int i = 0; i < n; i++) {
-			c->addNode(to_string(i));
-			cout << "Please enter all elements connected to Node " << i << " and press any character other than R/E/J when finished.\n";
+			// the parse phase times the building of the circuit, not the typing
+			{
+				ScopedPhase phase(c->getStats(), SolveStats::PARSE);
+				c->addNode(to_string(i));
+			}
+			cout << "Please enter all elements connected to Node " << i << " and press any character other than R/E/J/S/C when finished.\n";
 			string elemType;
 			double value;
 			while (true) {
 				cin >> elemType;
 				elemType[0] = toupper(elemType[0]);
-				if (elemType[0] != 'R' && elemType[0] != 'E' && elemType[0] != 'J')
+				if (elemType[0] != 'R' && elemType[0] != 'E' && elemType[0] != 'J' && elemType[0] != 'S' && elemType[0] != 'C')
 					break;
 				cin >> value;
 				Element::ElementType et = createType(elemType[0], value);
@@ -40,7 +44,12 @@ void inputValues (Circuit* c) {
 					cout << "ERROR: negative-valued index impossible.\n";
 					break;
 				}
-				if (!c->addElement(elemType, value, to_string(i), et)) {
+				bool added;
+				{
+					ScopedPhase phase(c->getStats(), SolveStats::PARSE);
+					added = c->addElement(elemType, value, to_string(i), et);
+				}
+				if (!added) {
 					cout << "Element addition failed, please re-add element.\n";
 				}
 			}
@@ -48,6 +57,11 @@ void inputValues (Circuit* c) {
 	} while (!(c->checkCircuit()));
 }
 
+static void printDifference (string responseName, string responseName2, double difference) {
+	cout << "Potential difference between Node [" << responseName << "] and [" << responseName2 << "] = " <<
+		difference << " volts. \n";
+}
+
 void printValue (string responseName, Circuit* c, char responseType) {
 	double v1 = c->getVoltage(responseName);
 	if (v1 == DBL_MAX) {
@@ -67,7 +81,7 @@ void printValue (string responseName, Circuit* c, char responseType) {
 		break;
 	case 'V':
 	case 'v':
-		if (responseName[0] == 'E' || responseName[0] == 'J' || responseName[0] == 'R') {
+		if (c->getElementType(responseName) != Element::ElementType::ERROR) {
 			c->getNodeNames(responseName, negNode, posNode);
 			cout << "Voltage across " << responseName << " = " << v1
 					<< " volts from Node[" << posNode << "] to Node [" << negNode << "].\n";
@@ -80,13 +94,12 @@ void printValue (string responseName, Circuit* c, char responseType) {
 				cout << "Node does not exist.\n";
 				break;
 			}
-			cout << "Potential difference between Node [" << responseName << "] and [" << responseName2 << "] = " <<
-				v1 - v2 << " volts. \n";
+			printDifference(responseName, responseName2, v1 - v2);
 		}
 		break;
 	case 'P':
 	case 'p':
-		if (responseName[0] == 'E' || responseName[0] == 'J' || responseName[0] == 'R') {
+		if (c->getElementType(responseName) != Element::ElementType::ERROR) {
 				cout << "Power in " << responseName << " = " << c->getPower(responseName) << " watts. \n";
 		}
 		else {
@@ -99,6 +112,70 @@ void printValue (string responseName, Circuit* c, char responseType) {
 	}
 }
 
+bool printDueValue (string sourceName, string responseName, Circuit* c, char responseType) {
+	// the responses of the circuit's own nodes and elements are point queries that leave its solution deployed,
+	// those inside an instance, of its capacitors and of its current sources are read from a full solve
+	Element::ElementType type = c->getElementType(responseName);
+	bool element = type == Element::ElementType::RESISTOR || type == Element::ElementType::VOLTAGE_SOURCE
+		|| type == Element::ElementType::SWITCH;
+	bool node = type == Element::ElementType::ERROR;
+	char lower = tolower(responseType);
+	bool point = element ? lower == 'i' || lower == 'v' || lower == 'p' : node && lower == 'v';
+	if (!c->isTopLevel(responseName) || !point) {
+		if (!c->solveDue(sourceName))
+			return false;
+		printValue (responseName, c, responseType);
+		return true;
+	}
+
+	string negNode, posNode, responseName2;
+	vector<string> outputs;
+	vector<double> values;
+	if (node) {
+		cin >> responseName2;
+		if (!c->isTopLevel(responseName2) || c->getElementType(responseName2) != Element::ElementType::ERROR) {
+			if (!c->solveDue(sourceName))
+				return false;
+			double v2 = c->getVoltage(responseName2);
+			if (v2 == DBL_MAX)
+				cout << "Node does not exist.\n";
+			else
+				printDifference(responseName, responseName2, c->getVoltage(responseName) - v2);
+			return true;
+		}
+		outputs.push_back(responseName);
+		outputs.push_back(responseName2);
+		if (c->solveDue(sourceName, outputs, values))
+			printDifference(responseName, responseName2, values[0] - values[1]);
+		return false;
+	}
+
+	// a source that is turned off is a short or an open, the unknown of a voltage source or a switch is its current
+	c->getNodeNames(responseName, negNode, posNode);
+	outputs.push_back(posNode);
+	outputs.push_back(negNode);
+	if (type != Element::ElementType::RESISTOR)
+		outputs.push_back(responseName);
+	if (!c->solveDue(sourceName, outputs, values))
+		return false;
+	double voltage = values[0] - values[1];
+	double current = type == Element::ElementType::RESISTOR ? -voltage / c->getResistance(responseName) : values[2];
+	switch (lower) {
+	case 'i':
+		cout << "Current through: " << responseName << " " << current
+				<< " amperes from Node[" << negNode << "] to Node[" << posNode << "]. \n";
+		break;
+	case 'v':
+		cout << "Voltage across " << responseName << " = " << voltage
+				<< " volts from Node[" << posNode << "] to Node [" << negNode << "].\n";
+		break;
+	default:
+		cout << "Power in " << responseName << " = " << -current * voltage << " watts. \n";
+		break;
+	}
+	return false;
+}
+
 Element::ElementType createType (char type, double value) {
 	Element::ElementType et;
 	switch (tolower(type)) {
@@ -108,6 +185,14 @@ Element::ElementType createType (char type, double value) {
 	case 'e':
 		et = Element::ElementType::VOLTAGE_SOURCE;
 		break;
+	case 's':
+		et = Element::ElementType::SWITCH;
+		break;
+	case 'c':
+		if (value < 0)
+			return Element::ElementType::ERROR;
+		et = Element::ElementType::CAPACITOR;
+		break;
 	case 'r':
 		if (value < 0)
 			return Element::ElementType::ERROR;
@@ -6,4 +6,6 @@ using namespace std;
 
 void inputValues (Circuit* c);
 void printValue (string responseName, Circuit* c, char responseType);
+// prints a response to the source "sourceName" alone, returns whether its solution was deployed in place of the circuit's
+bool printDueValue (string sourceName, string responseName, Circuit* c, char responseType);
 Element::ElementType createType (char type, double value);
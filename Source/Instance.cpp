@@ -0,0 +1,157 @@
+#include "Instance.h"
+#include <cfloat>
+
+Instance::Instance(string name, Subcircuit* definition) {
+	this->name = name;
+	this->definition = definition;
+	ports = new vector<Node*>();
+	isenabled = true;
+	interior = new Eigen::VectorXd();
+	recovered = false;
+}
+
+Instance::~Instance() {
+	delete ports;
+	delete interior;
+}
+
+void Instance::addPort(Node* node) {
+	ports->push_back(node);
+	node->addPort();
+}
+
+void Instance::invalidate() {
+	recovered = false;
+}
+
+bool Instance::recover() {
+	if (recovered)
+		return true;
+	Eigen::VectorXd portVoltages(ports->size());
+	for (size_t i = 0; i < ports->size(); i++)
+		portVoltages[i] = (*ports)[i]->isGround() ? 0 : (*ports)[i]->getVoltage();
+	recovered = definition->solveInterior(portVoltages, isenabled, *interior);
+	return recovered;
+}
+
+// value of a local unknown: a port voltage, an interior unknown or the ground
+double Instance::getUnknown(int unknown) {
+	int p = (int)ports->size();
+	if (unknown < 0)
+		return 0;
+	if (unknown < p)
+		return (*ports)[unknown]->isGround() ? 0 : (*ports)[unknown]->getVoltage();
+	return (*interior)[unknown - p];
+}
+
+bool Instance::getEntryNodes(int entry, double& vPos, double& vNeg) {
+	if (entry < 0 || !recover())
+		return false;
+	Subcircuit::Entry& e = (*definition->getEntries())[entry];
+	vPos = getUnknown(definition->getNodeUnknown(e.posNode));
+	vNeg = getUnknown(definition->getNodeUnknown(e.negNode));
+	return true;
+}
+
+string Instance::getName() {
+	return name;
+}
+
+Subcircuit* Instance::getDefinition() {
+	return definition;
+}
+
+vector<Node*>* Instance::getPorts() {
+	return ports;
+}
+
+bool Instance::isEnabled() {
+	return isenabled;
+}
+
+void Instance::setEnabled(bool isenabled) {
+	this->isenabled = isenabled;
+}
+
+double Instance::getNodeVoltage(string node) {
+	int unknown = definition->getNodeUnknown(node);
+	if (unknown == -2 || !recover())
+		return DBL_MAX;
+	return getUnknown(unknown);
+}
+
+Element::ElementType Instance::getElementType(string element) {
+	int entry = definition->getEntry(element);
+	if (entry < 0)
+		return Element::ElementType::ERROR;
+	return (*definition->getEntries())[entry].type;
+}
+
+double Instance::getElementVoltage(string element) {
+	int entry = definition->getEntry(element);
+	double vPos, vNeg;
+	if (!getEntryNodes(entry, vPos, vNeg))
+		return DBL_MAX;
+	Subcircuit::Entry& e = (*definition->getEntries())[entry];
+	if (e.type != Element::ElementType::RESISTOR && !isenabled)
+		return DBL_MAX;
+	if (e.type == Element::ElementType::VOLTAGE_SOURCE)
+		return e.value;
+	return vPos - vNeg;
+}
+
+double Instance::getElementCurrent(string element) {
+	int entry = definition->getEntry(element);
+	double vPos, vNeg;
+	if (!getEntryNodes(entry, vPos, vNeg))
+		return DBL_MAX;
+	Subcircuit::Entry& e = (*definition->getEntries())[entry];
+	if (e.type != Element::ElementType::RESISTOR && !isenabled)
+		return DBL_MAX;
+	switch (e.type) {
+	case Element::ElementType::RESISTOR:
+		return -1 * (vPos - vNeg) / e.value;
+	case Element::ElementType::CURRENT_SOURCE:
+		return e.value;
+	case Element::ElementType::VOLTAGE_SOURCE:
+		return getUnknown(definition->getSourceUnknown(entry));
+	default:
+		return 0;
+	}
+}
+
+double Instance::getElementPower(string element) {
+	double v = getElementVoltage(element);
+	double i = getElementCurrent(element);
+	if (v == DBL_MAX || i == DBL_MAX)
+		return 0;
+	return -1 * i * v;
+}
+
+bool Instance::getElementNodes(string element, string& negNode, string& posNode) {
+	int entry = definition->getEntry(element);
+	if (entry < 0)
+		return false;
+	Subcircuit::Entry& e = (*definition->getEntries())[entry];
+	string* local[2] = { &e.negNode, &e.posNode };
+	string* global[2] = { &negNode, &posNode };
+	for (int k = 0; k < 2; k++) {
+		int unknown = definition->getNodeUnknown(*local[k]);
+		if (unknown < 0)
+			*global[k] = "0";
+		else if (unknown < (int)ports->size())
+			*global[k] = (*ports)[unknown]->getName();
+		else
+			*global[k] = name + "." + *local[k];
+	}
+	return true;
+}
+
+void Instance::addPower(double& dissipated, double& supplied) {
+	vector<Subcircuit::Entry>* entries = definition->getEntries();
+	for (vector<Subcircuit::Entry>::iterator it = entries->begin(); it != entries->end(); it++) {
+		double p = getElementPower(it->name);
+		if (p > 0)	dissipated += p;
+		else		supplied -= p;
+	}
+}
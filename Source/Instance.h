@@ -0,0 +1,62 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <string>
+#include <vector>
+#include "Node.h"
+#include "Subcircuit.h"
+
+using namespace std;
+
+/*
+*	an instance (X line) of a reduced subcircuit, connected to one circuit node per port.
+*	it takes part in the circuit's equations through the port admittance of its definition only,
+*	the voltages and currents inside it are recovered from its port voltages when they are asked for.
+*	interior names are "instance.local", for example X1.R2 or X1.mid.
+*/
+
+class Instance {
+
+private:
+	string name;
+	Subcircuit* definition;
+	vector<Node*>* ports;
+	bool isenabled;				// disabled instances keep their resistances but not their sources
+	Eigen::VectorXd* interior;	// interior unknowns of the last solve
+	bool recovered;
+
+	bool recover();
+	double getUnknown(int unknown);
+	bool getEntryNodes(int entry, double& vPos, double& vNeg);
+
+public:
+	Instance(string name, Subcircuit* definition);
+	~Instance();
+
+	// connects the next port to "node"
+	void addPort(Node* node);
+
+	// forgets the interior of the previous solve
+	void invalidate();
+
+	string getName();
+	Subcircuit* getDefinition();
+	vector<Node*>* getPorts();
+	bool isEnabled();
+	void setEnabled(bool isenabled);
+
+	// voltage of the local node "node", DBL_MAX if there is no such node
+	double getNodeVoltage(string node);
+
+	// the same as the getters of Element for the local element "element", DBL_MAX if there is no such element
+	Element::ElementType getElementType(string element);
+	double getElementVoltage(string element);
+	double getElementCurrent(string element);
+	double getElementPower(string element);
+	bool getElementNodes(string element, string& negNode, string& posNode);
+
+	// adds the power dissipated and supplied inside the instance
+	void addPower(double& dissipated, double& supplied);
+};
+
+#endif
@@ -0,0 +1,440 @@
+#include "LinearSolver.h"
+#include "DomainSolver.h"
+#include "SupernodalSolver.h"
+#include "AMGPreconditioner.h"
+#include "BandedSolver.h"
+#include "Ordering.h"
+#include "Eigen/Dense"
+#include "Eigen/SparseLU"
+#include "Eigen/SparseCholesky"
+#include "Eigen/IterativeLinearSolvers"
+#include "Eigen/OrderingMethods"
+
+// systems up to this size are solved with dense kernels whatever their density
+#define DENSE_MAX_UNKNOWNS 400
+// denser systems up to this size are still solved densely
+#define DENSE_MAX_DENSE_UNKNOWNS 3000
+#define DENSE_MIN_DENSITY 0.05
+// systems that renumber into a band this narrow (ladders, lines, cascaded filters) are solved within it
+#define BANDED_MAX_BANDWIDTH 32
+// symmetric systems from this size are factorized by supernodes on the threads of the pool
+#define SUPERNODAL_MIN_UNKNOWNS 10000
+#define SUPERNODAL_MIN_THREADS 2
+// above this size the direct sparse factorizations give way to iterative solvers
+#define DIRECT_MAX_UNKNOWNS 2000000
+// large direct solves are split into domains when enough threads can factorize them side by side
+#define DOMAIN_MIN_UNKNOWNS 200000
+#define DOMAIN_MIN_THREADS 4
+
+#define ITERATIVE_TOLERANCE 1e-12
+// a matrix is symmetric when |A - A^T| <= tolerance * |A|, the stamps of a symmetric system may round differently
+// on either side of the diagonal. the refinement against the full matrix absorbs what the symmetric backends ignore
+#define SYMMETRY_TOLERANCE 1e-12
+
+static const char* typeNames[LinearSolver::NUM_TYPES] = {
+	"auto", "dense-lu", "dense-qr", "sparse-lu", "ldlt", "cg", "bicgstab", "dd", "mixed", "supernodal", "amg", "banded"
+};
+
+class DenseLUSolver : public LinearSolver {
+private:
+	Eigen::PartialPivLU<Eigen::MatrixXd> lu;
+	long n;
+public:
+	bool factorize(const SparseMatrix& A) {
+		n = A.rows();
+		lu.compute(Eigen::MatrixXd(A));
+		return true;
+	}
+	bool solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+		x = lu.solve(b);
+		return true;
+	}
+	bool solveMany(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) {
+		X = lu.solve(B);
+		return true;
+	}
+	bool solveTransposed(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+		x = lu.transpose().solve(b);
+		return true;
+	}
+	Type getType() { return DENSE_LU; }
+	long getFactorNonzeros() { return n * n; }
+	double getFactorFlops() { return 2.0 / 3.0 * n * n * (double)n; }
+	double getSolveFlops() { return 2.0 * n * n; }
+};
+
+class DenseQRSolver : public LinearSolver {
+private:
+	Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr;
+	long n;
+public:
+	bool factorize(const SparseMatrix& A) {
+		n = A.rows();
+		qr.compute(Eigen::MatrixXd(A));
+		return true;
+	}
+	bool solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+		x = qr.solve(b);
+		return true;
+	}
+	bool solveMany(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) {
+		X = qr.solve(B);
+		return true;
+	}
+	Type getType() { return DENSE_QR; }
+	long getFactorNonzeros() { return n * n; }
+	double getFactorFlops() { return 4.0 / 3.0 * n * n * (double)n; }
+	double getSolveFlops() { return 3.0 * n * n; }
+};
+
+class SparseLUSolver : public LinearSolver {
+private:
+	// the fill-reducing ordering is applied before the matrix gets here
+	Eigen::SparseLU<SparseMatrix, Eigen::NaturalOrdering<int> > lu;
+	long n, nnz;
+public:
+	bool factorize(const SparseMatrix& A) {
+		lu.analyzePattern(A);
+		return refactorize(A);
+	}
+	bool refactorize(const SparseMatrix& A) {
+		n = A.rows();
+		lu.factorize(A);
+		if (lu.info() != Eigen::Success)
+			return false;
+		// L is stored by supernodes, the column pointers count its stored values
+		nnz = lu.matrixL().m_mapL.colIndexPtr()[n] + lu.matrixU().m_mapU.nonZeros();
+		return true;
+	}
+	bool solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+		x = lu.solve(b);
+		return lu.info() == Eigen::Success;
+	}
+	bool solveMany(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) {
+		X = lu.solve(B);
+		return lu.info() == Eigen::Success;
+	}
+	Type getType() { return SPARSE_LU; }
+	long getFactorNonzeros() { return nnz; }
+	// with c = nnz / 2n entries per column of L and of U, eliminating a column costs 2 c^2
+	double getFactorFlops() { return (double)nnz * nnz / (2.0 * n); }
+	double getSolveFlops() { return 2.0 * nnz; }
+};
+
+class LDLTSolver : public LinearSolver {
+private:
+	Eigen::SimplicialLDLT<SparseMatrix, Eigen::Lower, Eigen::NaturalOrdering<int> > ldlt;
+	long n, nnz;
+public:
+	bool factorize(const SparseMatrix& A) {
+		// only the lower triangle is read, an unsymmetric matrix would silently be solved wrong
+		if (!isSymmetric(A))
+			return false;
+		ldlt.analyzePattern(A);
+		return refactorize(A);
+	}
+	bool refactorize(const SparseMatrix& A) {
+		n = A.rows();
+		ldlt.factorize(A);
+		if (ldlt.info() != Eigen::Success)
+			return false;
+		nnz = ldlt.matrixL().nestedExpression().nonZeros() + n;
+		return true;
+	}
+	bool solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+		x = ldlt.solve(b);
+		return ldlt.info() == Eigen::Success;
+	}
+	bool solveMany(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) {
+		X = ldlt.solve(B);
+		return ldlt.info() == Eigen::Success;
+	}
+	// symmetric, the transposed solve is the same
+	bool solveTransposed(const Eigen::VectorXd& b, Eigen::VectorXd& x) { return solve(b, x); }
+	Type getType() { return SIMPLICIAL_LDLT; }
+	long getFactorNonzeros() { return nnz; }
+	double getFactorFlops() { return (double)nnz * nnz / n; }
+	double getSolveFlops() { return 4.0 * nnz; }
+};
+
+/*
+*	factors in single precision, half the memory traffic of the factors and twice the SIMD width.
+*	a float solve is only accurate to about cond(A) * 6e-8, RefinedSolver recovers the double accuracy by
+*	refining against the double system, and when the conditioning is too poor for that the backward error
+*	stays high and Circuit falls back to the double sparse LU.
+*/
+class MixedPrecisionSolver : public LinearSolver {
+private:
+	typedef Eigen::SparseMatrix<float> SparseMatrixF;
+	Eigen::SimplicialLDLT<SparseMatrixF, Eigen::Lower, Eigen::NaturalOrdering<int> > ldlt;
+	Eigen::SparseLU<SparseMatrixF, Eigen::NaturalOrdering<int> > lu;
+	bool symmetric;
+	long n, nnz;
+public:
+	bool factorize(const SparseMatrix& A) {
+		symmetric = isSymmetric(A);
+		SparseMatrixF Af = A.cast<float>();
+		if (symmetric)
+			ldlt.analyzePattern(Af);
+		else
+			lu.analyzePattern(Af);
+		return factorizeSingle(Af);
+	}
+	bool refactorize(const SparseMatrix& A) {
+		if (isSymmetric(A) != symmetric)
+			return factorize(A);
+		return factorizeSingle(A.cast<float>());
+	}
+	bool factorizeSingle(const SparseMatrixF& Af) {
+		n = Af.rows();
+		if (symmetric) {
+			ldlt.factorize(Af);
+			if (ldlt.info() != Eigen::Success)
+				return false;
+			nnz = ldlt.matrixL().nestedExpression().nonZeros() + n;
+			return true;
+		}
+		lu.factorize(Af);
+		if (lu.info() != Eigen::Success)
+			return false;
+		nnz = lu.matrixL().m_mapL.colIndexPtr()[n] + lu.matrixU().m_mapU.nonZeros();
+		return true;
+	}
+	bool solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+		Eigen::VectorXf bf = b.cast<float>(), xf;
+		if (symmetric)
+			xf = ldlt.solve(bf);
+		else
+			xf = lu.solve(bf);
+		x = xf.cast<double>();
+		return symmetric ? ldlt.info() == Eigen::Success : lu.info() == Eigen::Success;
+	}
+	bool solveMany(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) {
+		Eigen::MatrixXf Bf = B.cast<float>(), Xf;
+		if (symmetric)
+			Xf = ldlt.solve(Bf);
+		else
+			Xf = lu.solve(Bf);
+		X = Xf.cast<double>();
+		return symmetric ? ldlt.info() == Eigen::Success : lu.info() == Eigen::Success;
+	}
+	bool solveTransposed(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+		if (!symmetric)
+			return false;
+		return solve(b, x);
+	}
+	Type getType() { return MIXED_PRECISION; }
+	long getFactorNonzeros() { return nnz; }
+	double getFactorFlops() { return (symmetric ? 1.0 : 0.5) * nnz * nnz / n; }
+	double getSolveFlops() { return (symmetric ? 4.0 : 2.0) * nnz; }
+};
+
+class CGSolver : public LinearSolver {
+private:
+	Eigen::ConjugateGradient<SparseMatrix, Eigen::Lower | Eigen::Upper, Eigen::IncompleteCholesky<double> > cg;
+	SparseMatrix A;		// the iterative solvers only keep a reference to their matrix
+	long n, nnz, iterations;
+public:
+	bool factorize(const SparseMatrix& A) {
+		if (!isSymmetric(A))
+			return false;
+		this->A = A;
+		n = A.rows();
+		nnz = A.nonZeros();
+		iterations = 0;
+		cg.setTolerance(ITERATIVE_TOLERANCE);
+		cg.compute(this->A);
+		return cg.info() == Eigen::Success;
+	}
+	bool solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+		x = cg.solve(b);
+		iterations = cg.iterations();
+		return cg.info() == Eigen::Success;
+	}
+	bool solveTransposed(const Eigen::VectorXd& b, Eigen::VectorXd& x) { return solve(b, x); }
+	Type getType() { return CONJUGATE_GRADIENT; }
+	long getFactorNonzeros() { return -1; }
+	double getFactorFlops() { return 2.0 * nnz; }
+	// a product with A and with the preconditioner and a few vector updates per iteration
+	double getSolveFlops() { return iterations * (4.0 * nnz + 10.0 * n); }
+};
+
+class AMGSolver : public LinearSolver {
+private:
+	Eigen::ConjugateGradient<SparseMatrix, Eigen::Lower | Eigen::Upper, AMGPreconditioner> cg;
+	SparseMatrix A;
+	long n, nnz, iterations;
+public:
+	// the setup of the hierarchy is the factorization, every solve after it reuses it.
+	// a nodal system with voltage sources is unsymmetric and rejected, the fallback solves it
+	bool factorize(const SparseMatrix& A) {
+		if (!isSymmetric(A))
+			return false;
+		this->A = A;
+		n = A.rows();
+		nnz = A.nonZeros();
+		iterations = 0;
+		cg.setTolerance(ITERATIVE_TOLERANCE);
+		cg.compute(this->A);
+		return cg.info() == Eigen::Success;
+	}
+	bool solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+		x = cg.solve(b);
+		iterations = cg.iterations();
+		return cg.info() == Eigen::Success;
+	}
+	bool solveTransposed(const Eigen::VectorXd& b, Eigen::VectorXd& x) { return solve(b, x); }
+	Type getType() { return ALGEBRAIC_MULTIGRID; }
+	long getFactorNonzeros() { return cg.preconditioner().getOperatorNonzeros(); }
+	// the triple products of every level
+	double getFactorFlops() { return 20.0 * cg.preconditioner().getOperatorNonzeros(); }
+	// a product with A, a V-cycle of two Gauss-Seidel sweeps, a residual and the transfers on every level,
+	// and a few vector updates per iteration
+	double getSolveFlops() { return iterations * (2.0 * nnz + 10.0 * cg.preconditioner().getOperatorNonzeros() + 10.0 * n); }
+};
+
+class BiCGSTABSolver : public LinearSolver {
+private:
+	Eigen::BiCGSTAB<SparseMatrix, Eigen::IncompleteLUT<double> > bicg;
+	SparseMatrix A;
+	long n, nnz, iterations;
+public:
+	bool factorize(const SparseMatrix& A) {
+		this->A = A;
+		n = A.rows();
+		nnz = A.nonZeros();
+		iterations = 0;
+		bicg.setTolerance(ITERATIVE_TOLERANCE);
+		bicg.compute(this->A);
+		return bicg.info() == Eigen::Success;
+	}
+	bool solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+		x = bicg.solve(b);
+		iterations = bicg.iterations();
+		return bicg.info() == Eigen::Success;
+	}
+	Type getType() { return BICGSTAB; }
+	long getFactorNonzeros() { return -1; }
+	double getFactorFlops() { return 20.0 * nnz; }
+	// two products with A and with the preconditioner per iteration
+	double getSolveFlops() { return iterations * (8.0 * nnz + 20.0 * n); }
+};
+
+
+LinearSolver::~LinearSolver() {
+}
+
+bool LinearSolver::refactorize(const SparseMatrix& A) {
+	return factorize(A);
+}
+
+bool LinearSolver::solveMany(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) {
+	Eigen::VectorXd b, x;
+	X.resize(B.rows(), B.cols());
+	for (long j = 0; j < B.cols(); j++) {
+		b = B.col(j);
+		if (!solve(b, x))
+			return false;
+		X.col(j) = x;
+	}
+	return true;
+}
+
+bool LinearSolver::solveTransposed(const Eigen::VectorXd&, Eigen::VectorXd&) {
+	return false;
+}
+
+long LinearSolver::getFactorNonzeros() {
+	return -1;
+}
+
+double LinearSolver::getFactorFlops() {
+	return 0;
+}
+
+double LinearSolver::getSolveFlops() {
+	return 0;
+}
+
+LinearSolver* LinearSolver::create(Type type) {
+	switch (type) {
+	case DENSE_LU: return new DenseLUSolver();
+	case DENSE_QR: return new DenseQRSolver();
+	case SPARSE_LU: return new SparseLUSolver();
+	case SIMPLICIAL_LDLT: return new LDLTSolver();
+	case CONJUGATE_GRADIENT: return new CGSolver();
+	case BICGSTAB: return new BiCGSTABSolver();
+	case DOMAIN_DECOMPOSITION: return new DomainSolver(ThreadPool::getShared(), 0);
+	case MIXED_PRECISION: return new MixedPrecisionSolver();
+	case SUPERNODAL: return new SupernodalSolver(ThreadPool::getShared());
+	case ALGEBRAIC_MULTIGRID: return new AMGSolver();
+	case BANDED: return new BandedSolver();
+	default: return NULL;
+	}
+}
+
+bool LinearSolver::isSymmetric(const SparseMatrix& A) {
+	SparseMatrix At = A.transpose();
+	return (A - At).norm() <= SYMMETRY_TOLERANCE * A.norm();
+}
+
+bool LinearSolver::usesOrdering(Type type) {
+	// the dense backends ignore sparsity, the preconditioners and the banded backend order themselves
+	return type == SPARSE_LU || type == SIMPLICIAL_LDLT || type == MIXED_PRECISION || type == SUPERNODAL;
+}
+
+LinearSolver::Type LinearSolver::select(const SparseMatrix& A) {
+	long n = A.rows();
+	double density = n == 0 ? 1 : (double)A.nonZeros() / ((double)n * n);
+	if (n <= DENSE_MAX_UNKNOWNS || (n <= DENSE_MAX_DENSE_UNKNOWNS && density >= DENSE_MIN_DENSITY))
+		return DENSE_LU;
+	// a nodal matrix without voltage sources is symmetric positive definite,
+	// the voltage source rows make it unsymmetric (so do those of the closed switches)
+	bool symmetric = isSymmetric(A);
+	if (admitsBanded(A)) {
+		Ordering::Permutation rcm;
+		Ordering::compute(A, Ordering::REVERSE_CUTHILL_MCKEE, rcm);
+		if (Ordering::bandwidth(A, rcm) <= BANDED_MAX_BANDWIDTH)
+			return BANDED;
+	}
+	int threads = ThreadPool::getShared()->getNumThreads();
+	// the supernodal backend is a Cholesky factorization, only the nodal systems of source-free circuits
+	// (current sources driving resistors) and the loop systems reach it. a nodal system with any voltage
+	// source is left to the LU backends below
+	if (symmetric && n >= SUPERNODAL_MIN_UNKNOWNS && n <= DIRECT_MAX_UNKNOWNS && threads >= SUPERNODAL_MIN_THREADS)
+		return SUPERNODAL;
+	if (n >= DOMAIN_MIN_UNKNOWNS && n <= DIRECT_MAX_UNKNOWNS && threads >= DOMAIN_MIN_THREADS)
+		return DOMAIN_DECOMPOSITION;
+	if (n <= DIRECT_MAX_UNKNOWNS)
+		return symmetric ? SIMPLICIAL_LDLT : SPARSE_LU;
+	// multigrid keeps the iterations of a large mesh nearly as few as those of a small one. conjugate gradients
+	// need a symmetric positive definite system, the same ones as the supernodal backend, so a nodal system
+	// with any voltage source goes to BiCGSTAB instead
+	return symmetric ? ALGEBRAIC_MULTIGRID : BICGSTAB;
+}
+
+bool LinearSolver::admitsBanded(const SparseMatrix& A) {
+	long n = A.rows();
+	double density = n == 0 ? 1 : (double)A.nonZeros() / ((double)n * n);
+	return !(n <= DENSE_MAX_UNKNOWNS || (n <= DENSE_MAX_DENSE_UNKNOWNS && density >= DENSE_MIN_DENSITY)) && n <= DIRECT_MAX_UNKNOWNS;
+}
+
+int LinearSolver::getMaxBandwidth() {
+	return BANDED_MAX_BANDWIDTH;
+}
+
+bool LinearSolver::parseType(string name, Type& type) {
+	for (int i = 0; i < NUM_TYPES; i++) {
+		if (name == typeNames[i]) {
+			type = (Type)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* LinearSolver::getTypeName(Type type) {
+	if (type < 0 || type >= NUM_TYPES)
+		return "?";
+	return typeNames[type];
+}
@@ -0,0 +1,72 @@
+#ifndef LINEARSOLVER_H
+#define LINEARSOLVER_H
+
+#include <string>
+#include "Eigen/Sparse"
+
+using namespace std;
+
+typedef Eigen::SparseMatrix<double> SparseMatrix;
+
+/*
+*	interface of the backends that solve the circuit's linear system A x = b.
+*	a backend is factorized once and can then solve any number of right hand sides,
+*	the iterative backends set up their preconditioner in factorize and iterate in solve.
+*/
+
+class LinearSolver {
+
+public: enum Type {
+	AUTO, DENSE_LU, DENSE_QR, SPARSE_LU, SIMPLICIAL_LDLT, CONJUGATE_GRADIENT, BICGSTAB, DOMAIN_DECOMPOSITION, MIXED_PRECISION, SUPERNODAL, ALGEBRAIC_MULTIGRID, BANDED, NUM_TYPES
+};
+
+public:
+	virtual ~LinearSolver();
+
+	// factorizes "A", returns false if the backend can not handle it (singular, not positive definite, ...)
+	virtual bool factorize(const SparseMatrix& A) = 0;
+
+	// solves A x = b with the last factorization, returns false if the solve did not succeed
+	virtual bool solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) = 0;
+
+	// solves A X = B for every column of B, the direct backends do it in one blocked pass over their factors
+	virtual bool solveMany(const Eigen::MatrixXd& B, Eigen::MatrixXd& X);
+
+	// factorizes a matrix with the same nonzero pattern as the last one factorized, reusing its symbolic analysis
+	virtual bool refactorize(const SparseMatrix& A);
+
+	// solves A^T x = b, returns false if the backend can not solve with the transpose
+	virtual bool solveTransposed(const Eigen::VectorXd& b, Eigen::VectorXd& x);
+
+	virtual Type getType() = 0;
+
+	// nonzeros held by the factors, -1 when the backend does not factorize
+	virtual long getFactorNonzeros();
+
+	// estimated floating point operations of the last factorization and of the last solve
+	virtual double getFactorFlops();
+	virtual double getSolveFlops();
+
+	// creates a backend of type "type", which must not be AUTO
+	static LinearSolver* create(Type type);
+
+	// picks a backend for "A" from its size, symmetry and density
+	static Type select(const SparseMatrix& A);
+
+	// whether "A" is past the dense backends and within the direct ones, where select picks
+	// the banded backend for any bandwidth up to getMaxBandwidth
+	static bool admitsBanded(const SparseMatrix& A);
+	static int getMaxBandwidth();
+
+	// whether "A" equals its transpose up to rounding, relative to its norm
+	static bool isSymmetric(const SparseMatrix& A);
+
+	// whether the backend "type" factorizes in the order it is given, so that a fill-reducing ordering pays off
+	static bool usesOrdering(Type type);
+
+	// parses a backend name as printed by getTypeName
+	static bool parseType(string name, Type& type);
+	static const char* getTypeName(Type type);
+};
+
+#endif
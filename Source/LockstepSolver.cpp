@@ -0,0 +1,411 @@
+#include "LockstepSolver.h"
+#include "Circuit.h"
+#include "Netlist.h"
+#include "RefinedSolver.h"
+#include "ResultExport.h"
+#include "Eigen/SparseLU"
+#include <queue>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+LockstepSolver::LockstepSolver(Circuit* c) {
+	circuit = c;
+	n = 0;
+	ready = false;
+	fallbacks = 0;
+	if (!c->iscleaned)
+		c->cleanUpSP();
+	SparseMatrix A;
+	Eigen::VectorXd b;
+	c->createEquations(A, b);
+	n = A.rows();
+	unknownNames.resize(n);
+	for (vector<Node*>::iterator it = c->nodes->begin(); it != c->nodes->end(); it++)
+		if (!(*it)->isGround() && (*it)->getId() >= 0 && (*it)->getId() < n)
+			unknownNames[(*it)->getId()] = "V(" + (*it)->getName() + ")";
+	for (vector<Element*>::iterator it = c->voltageSources->begin(); it != c->voltageSources->end(); it++)
+		if ((*it)->getId() >= 0 && (*it)->getId() < n)
+			unknownNames[(*it)->getId()] = "I(" + (*it)->getName() + ")";
+	if (n == 0)
+		return;
+
+	// the pivots of the nominal circuit, every copy is eliminated in the same order
+	Eigen::SparseLU<SparseMatrix, Eigen::COLAMDOrdering<int> > lu;
+	lu.compute(A);
+	if (lu.info() != Eigen::Success) {
+		cout << "ERROR: The nominal circuit is singular, its copies can not be solved in lockstep.\n";
+		return;
+	}
+	rowOf.resize(n);
+	columnOf.resize(n);
+	for (long i = 0; i < n; i++) {
+		rowOf[i] = lu.rowsPermutation().indices()[i];
+		columnOf[i] = lu.colsPermutation().indices()[i];
+	}
+
+	vector<Eigen::Triplet<double> > triplets;
+	triplets.reserve(A.nonZeros());
+	for (int j = 0; j < A.outerSize(); j++)
+		for (SparseMatrix::InnerIterator it(A, j); it; ++it)
+			triplets.push_back(Eigen::Triplet<double>(rowOf[it.row()], columnOf[j], it.value()));
+	Eigen::SparseMatrix<double, Eigen::RowMajor> B(n, n);
+	B.setFromTriplets(triplets.begin(), triplets.end());
+	B.makeCompressed();
+	rowStart.assign(B.outerIndexPtr(), B.outerIndexPtr() + n + 1);
+	columns.assign(B.innerIndexPtr(), B.innerIndexPtr() + B.nonZeros());
+	coefficients.assign(B.valuePtr(), B.valuePtr() + B.nonZeros());
+	rhs.resize(n);
+	for (long i = 0; i < n; i++)
+		rhs[rowOf[i]] = b[i];
+
+	analyze();
+	ready = true;
+}
+
+// row by row symbolic elimination of B without pivoting: row i picks up the U part of every row k < i
+// it holds, in increasing k, including the entries that earlier rows filled in
+void LockstepSolver::analyze() {
+	vector<int> mark(n, -1);
+	vector<int> upper;
+	priority_queue<int, vector<int>, greater<int> > lower;
+	factorStart.assign(1, 0);
+	factorColumns.clear();
+	diagonal.resize(n);
+	for (long i = 0; i < n; i++) {
+		upper.clear();
+		mark[i] = (int)i;
+		upper.push_back((int)i);
+		for (int k = rowStart[i]; k < rowStart[i + 1]; k++) {
+			int j = columns[k];
+			if (mark[j] == i)
+				continue;
+			mark[j] = (int)i;
+			if (j < i)
+				lower.push(j);
+			else
+				upper.push_back(j);
+		}
+		while (!lower.empty()) {
+			int k = lower.top();
+			lower.pop();
+			factorColumns.push_back(k);
+			for (int q = diagonal[k] + 1; q < factorStart[k + 1]; q++) {
+				int j = factorColumns[q];
+				if (mark[j] == i)
+					continue;
+				mark[j] = (int)i;
+				if (j < i)
+					lower.push(j);
+				else
+					upper.push_back(j);
+			}
+		}
+		sort(upper.begin(), upper.end());
+		diagonal[i] = (int)factorColumns.size();
+		factorColumns.insert(factorColumns.end(), upper.begin(), upper.end());
+		factorStart.push_back((int)factorColumns.size());
+	}
+}
+
+int LockstepSolver::findSlot(int row, int column) {
+	vector<int>::iterator begin = columns.begin() + rowStart[row], end = columns.begin() + rowStart[row + 1];
+	vector<int>::iterator it = lower_bound(begin, end, column);
+	if (it == end || *it != column)
+		return -1;
+	return (int)(it - columns.begin());
+}
+
+double LockstepSolver::stampValue(const Parameter& p, double value) {
+	return p.type == Element::RESISTOR ? 1 / value : value;
+}
+
+bool LockstepSolver::isReady() {
+	return ready;
+}
+
+int LockstepSolver::addParameter(string name) {
+	Element* e = circuit->getElement(name);
+	if (e == NULL || !ready) {
+		cout << "ERROR: " << name << " is not an element of the circuit.\n";
+		return -1;
+	}
+	Parameter p;
+	p.name = name;
+	p.type = e->getType();
+	Node* ends[2] = { e->getPosNode(), e->getNegNode() };
+	switch (p.type) {
+	case Element::RESISTOR:
+		p.nominal = 1 / e->getResistance();
+		for (int a = 0; a < 2; a++) {
+			for (int b = 0; b < 2; b++) {
+				if (ends[a]->isGround() || ends[b]->isGround())
+					continue;
+				Stamp s;
+				s.slot = findSlot(rowOf[ends[a]->getId()], columnOf[ends[b]->getId()]);
+				s.row = -1;
+				s.sign = a == b ? 1 : -1;
+				p.stamps.push_back(s);
+			}
+		}
+		break;
+	case Element::CURRENT_SOURCE:
+		p.nominal = e->getCurrent();
+		for (int a = 0; a < 2; a++) {
+			if (ends[a]->isGround())
+				continue;
+			Stamp s;
+			s.slot = -1;
+			s.row = rowOf[ends[a]->getId()];
+			s.sign = a == 0 ? 1 : -1;
+			p.stamps.push_back(s);
+		}
+		break;
+	case Element::VOLTAGE_SOURCE: {
+		p.nominal = e->getVoltage();
+		Stamp s;
+		s.slot = -1;
+		s.row = rowOf[e->getId()];
+		s.sign = 1;
+		p.stamps.push_back(s);
+		break;
+	}
+	default:
+		return -1;
+	}
+	parameters.push_back(p);
+	return (int)parameters.size() - 1;
+}
+
+int LockstepSolver::getNumParameters() {
+	return (int)parameters.size();
+}
+
+long LockstepSolver::getNumUnknowns() {
+	return n;
+}
+
+string LockstepSolver::getUnknownName(long i) {
+	return unknownNames[i];
+}
+
+void LockstepSolver::factorize(const LaneVector& B, LaneVector& LU, LaneVector& work) {
+	for (long i = 0; i < n; i++) {
+		int begin = factorStart[i], end = factorStart[i + 1];
+		for (int p = begin; p < end; p++)
+			work[factorColumns[p]].setZero();
+		for (int k = rowStart[i]; k < rowStart[i + 1]; k++)
+			work[columns[k]] = B[k];
+		for (int p = begin; p < diagonal[i]; p++) {
+			int k = factorColumns[p];
+			Lane l = work[k] / LU[diagonal[k]];
+			work[k] = l;
+			for (int q = diagonal[k] + 1; q < factorStart[k + 1]; q++)
+				work[factorColumns[q]] -= l * LU[q];
+		}
+		for (int p = begin; p < end; p++)
+			LU[p] = work[factorColumns[p]];
+	}
+}
+
+void LockstepSolver::solve(const LaneVector& LU, LaneVector& y) {
+	for (long i = 0; i < n; i++)
+		for (int p = factorStart[i]; p < diagonal[i]; p++)
+			y[i] -= LU[p] * y[factorColumns[p]];
+	for (long i = n - 1; i >= 0; i--) {
+		for (int q = diagonal[i] + 1; q < factorStart[i + 1]; q++)
+			y[i] -= LU[q] * y[factorColumns[q]];
+		y[i] /= LU[diagonal[i]];
+	}
+}
+
+LockstepSolver::Lane LockstepSolver::computeBackwardError(const LaneVector& B, const LaneVector& b, const LaneVector& y, LaneVector& r) {
+	Lane normB = Lane::Zero(), normY = Lane::Zero(), normb = Lane::Zero(), normR = Lane::Zero();
+	// max() drops NaNs, a sum keeps them
+	Lane total = Lane::Zero();
+	for (long i = 0; i < n; i++) {
+		Lane s = b[i], rowSum = Lane::Zero();
+		for (int k = rowStart[i]; k < rowStart[i + 1]; k++) {
+			s -= B[k] * y[columns[k]];
+			rowSum += B[k].abs();
+		}
+		r[i] = s;
+		normR = normR.max(s.abs());
+		normB = normB.max(rowSum);
+		normY = normY.max(y[i].abs());
+		normb = normb.max(b[i].abs());
+		total += s.abs() + y[i].abs();
+	}
+	Lane denominator = normB * normY + normb;
+	Lane error = (denominator > 0).select(normR / denominator, Lane::Zero());
+	return total.isFinite().select(error, Lane::Constant(INFINITY));
+}
+
+bool LockstepSolver::solveAlone(const LaneVector& B, const LaneVector& b, int lane, Eigen::VectorXd& y) {
+	vector<Eigen::Triplet<double> > triplets;
+	triplets.reserve(columns.size());
+	for (long i = 0; i < n; i++)
+		for (int k = rowStart[i]; k < rowStart[i + 1]; k++)
+			triplets.push_back(Eigen::Triplet<double>((int)i, columns[k], B[k][lane]));
+	SparseMatrix S(n, n);
+	S.setFromTriplets(triplets.begin(), triplets.end());
+	Eigen::VectorXd bl(n);
+	for (long i = 0; i < n; i++)
+		bl[i] = b[i][lane];
+	RefinedSolver solver(LinearSolver::create(LinearSolver::SPARSE_LU), NULL);
+	return solver.factorize(S) && solver.solve(bl, y) && solver.getBackwardError() <= BACKWARD_ERROR_TOLERANCE;
+}
+
+bool LockstepSolver::solveBatch(const Eigen::MatrixXd& values, long first, Eigen::MatrixXd& solutions) {
+	int count = (int)min((long)LANES, (long)values.cols() - first);
+	LaneVector B(coefficients.size()), b(n), LU(factorColumns.size()), work(n), y(n), r(n);
+
+	// the nominal system in every lane, then each parameter's change from its nominal value,
+	// the lanes past the last copy stay nominal
+	for (size_t k = 0; k < coefficients.size(); k++)
+		B[k] = Lane::Constant(coefficients[k]);
+	for (long i = 0; i < n; i++)
+		b[i] = Lane::Constant(rhs[i]);
+	for (size_t p = 0; p < parameters.size(); p++) {
+		Parameter& param = parameters[p];
+		Lane delta = Lane::Zero();
+		for (int l = 0; l < count; l++)
+			delta[l] = stampValue(param, values(p, first + l)) - param.nominal;
+		for (size_t s = 0; s < param.stamps.size(); s++) {
+			Stamp& stamp = param.stamps[s];
+			if (stamp.slot >= 0)
+				B[stamp.slot] += stamp.sign * delta;
+			else
+				b[stamp.row] += stamp.sign * delta;
+		}
+	}
+
+	factorize(B, LU, work);
+	y = b;
+	solve(LU, y);
+	Lane error = computeBackwardError(B, b, y, r);
+	if (!(error <= BACKWARD_ERROR_TOLERANCE).all()) {
+		solve(LU, r);
+		for (long i = 0; i < n; i++)
+			y[i] += r[i];
+		error = computeBackwardError(B, b, y, r);
+	}
+
+	bool success = true;
+	for (int l = 0; l < count; l++) {
+		if (error[l] <= BACKWARD_ERROR_TOLERANCE) {
+			for (long i = 0; i < n; i++)
+				solutions(i, first + l) = y[columnOf[i]][l];
+			continue;
+		}
+		// the nominal pivots do not suit this copy
+		fallbacks++;
+		Eigen::VectorXd alone;
+		if (!solveAlone(B, b, l, alone)) {
+			solutions.col(first + l).setConstant(NAN);
+			success = false;
+			continue;
+		}
+		for (long i = 0; i < n; i++)
+			solutions(i, first + l) = alone[columnOf[i]];
+	}
+	return success;
+}
+
+bool LockstepSolver::solve(const Eigen::MatrixXd& values, Eigen::MatrixXd& solutions, ThreadPool* pool) {
+	if (!ready || values.rows() != (long)parameters.size()) {
+		cout << "ERROR: The copies need one value per parameter.\n";
+		return false;
+	}
+	long count = values.cols();
+	solutions.resize(n, count);
+	fallbacks = 0;
+	int batches = (int)((count + LANES - 1) / LANES);
+	vector<char> ok(batches, 1);
+	pool->parallelFor(batches, [&](int k) {
+		ok[k] = solveBatch(values, (long)k * LANES, solutions);
+	});
+	for (int k = 0; k < batches; k++)
+		if (!ok[k])
+			return false;
+	return true;
+}
+
+long LockstepSolver::getNumFallbacks() {
+	return fallbacks;
+}
+
+static string trim(const string& s) {
+	size_t first = s.find_first_not_of(" \t\r\"");
+	if (first == string::npos)
+		return "";
+	return s.substr(first, s.find_last_not_of(" \t\r\"") + 1 - first);
+}
+
+bool LockstepSolver::readValues(string path, vector<string>& names, Eigen::MatrixXd& values) {
+	ifstream in(path.c_str());
+	if (!in) {
+		cout << "ERROR: Can not open " << path << ".\n";
+		return false;
+	}
+	names.clear();
+	vector<double> read;
+	string line;
+	int lineNumber = 0;
+	while (getline(in, line)) {
+		lineNumber++;
+		if (trim(line).empty())
+			continue;
+		stringstream fields(line);
+		string field;
+		if (names.empty()) {
+			while (getline(fields, field, ','))
+				names.push_back(trim(field));
+			continue;
+		}
+		size_t count = 0;
+		while (getline(fields, field, ',')) {
+			string value = trim(field);
+			double x;
+			if (!parseValue(value.data(), value.data() + value.size(), x)) {
+				cout << "ERROR: " << path << ":" << lineNumber << ": invalid value \"" << value << "\".\n";
+				return false;
+			}
+			read.push_back(x);
+			count++;
+		}
+		if (count != names.size()) {
+			cout << "ERROR: " << path << ":" << lineNumber << ": expected " << names.size() << " values.\n";
+			return false;
+		}
+	}
+	long copies = names.empty() ? 0 : (long)(read.size() / names.size());
+	values = Eigen::Map<Eigen::MatrixXd>(read.data(), names.size(), copies);
+	return true;
+}
+
+bool LockstepSolver::writeSolutions(string path, const Eigen::MatrixXd& solutions) {
+	BufferedWriter out;
+	if (!out.open(path)) {
+		cout << "ERROR: Can not write " << path << ".\n";
+		return false;
+	}
+	out.putString("copy");
+	for (long i = 0; i < n; i++) {
+		out.putString(",\"");
+		out.putString(unknownNames[i]);
+		out.put('"');
+	}
+	out.put('\n');
+	for (long k = 0; k < solutions.cols(); k++) {
+		out.putString(to_string(k));
+		for (long i = 0; i < n; i++) {
+			out.put(',');
+			out.putDouble(solutions(i, k));
+		}
+		out.put('\n');
+	}
+	return out.close();
+}
@@ -0,0 +1,113 @@
+#ifndef LOCKSTEPSOLVER_H
+#define LOCKSTEPSOLVER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include "Eigen/Dense"
+#include "LinearSolver.h"
+#include "ThreadPool.h"
+#include "Element.h"
+
+using namespace std;
+
+class Circuit;
+
+/*
+*	solves many copies of one circuit that differ only in the values of some of their elements
+*	(corners, Monte Carlo samples), LANES copies at a time in lockstep.
+*	the pivot sequence and the fill pattern of the LU factors are found once, by a sparse LU with partial
+*	pivoting of the nominal circuit. every batch then stamps, factorizes and solves its LANES systems with
+*	one shared sequence of operations on Eigen arrays holding one copy per lane, so the arithmetic fills
+*	the SSE/AVX/AVX512 registers Eigen was built for.
+*	a copy whose backward error stays above the tolerance after a refinement step (its values moved too far
+*	for the nominal pivots) is solved again on its own with pivoting.
+*/
+
+class LockstepSolver {
+
+public:
+	// copies per batch, four packets of the widest vector unit enabled at compile time
+	enum { LANES = 4 * Eigen::internal::packet_traits<double>::size };
+	typedef Eigen::Array<double, LANES, 1> Lane;
+	typedef vector<Lane, Eigen::aligned_allocator<Lane> > LaneVector;
+
+private:
+	// where a parameter enters the permuted system: a coefficient of B or an entry of its right hand side
+	struct Stamp {
+		int slot;		// index into the coefficients of B, -1 for the right hand side
+		int row;		// row of the right hand side
+		double sign;
+	};
+
+	struct Parameter {
+		string name;
+		Element::ElementType type;
+		double nominal;			// the conductance of a resistor, the value of a source
+		vector<Stamp> stamps;
+	};
+
+	Circuit* circuit;
+	long n;
+	bool ready;
+
+	// B = Pr A Pc by rows with its nominal coefficients, and Pr b, A x = b is solved as B y = Pr b, x = Pc y
+	vector<int> rowStart, columns;
+	vector<double> coefficients;
+	vector<double> rhs;
+	vector<int> rowOf, columnOf;			// A row i is B row rowOf[i], A column j is B column columnOf[j]
+
+	// the filled pattern of the factors by rows: L left of the diagonal, then the diagonal and U
+	vector<int> factorStart, factorColumns, diagonal;
+
+	vector<Parameter> parameters;
+	vector<string> unknownNames;
+	atomic<long> fallbacks;
+
+	void analyze();
+	int findSlot(int row, int column);
+	// the value a parameter stamps with, the conductance of a resistor
+	double stampValue(const Parameter& p, double value);
+
+	void factorize(const LaneVector& B, LaneVector& LU, LaneVector& work);
+	void solve(const LaneVector& LU, LaneVector& y);
+	// the normwise backward error of every lane of y, and the residual Pr b - B y
+	Lane computeBackwardError(const LaneVector& B, const LaneVector& b, const LaneVector& y, LaneVector& r);
+	// solves lane "lane" alone with pivoting, false if its system is singular
+	bool solveAlone(const LaneVector& B, const LaneVector& b, int lane, Eigen::VectorXd& y);
+	bool solveBatch(const Eigen::MatrixXd& values, long first, Eigen::MatrixXd& solutions);
+
+public:
+	// takes the topology and the nominal values of "c", which must have a solution
+	LockstepSolver(Circuit* c);
+
+	// false if the nominal circuit could not be factorized
+	bool isReady();
+
+	// varies the value of element "name" across the copies, returns its parameter index, -1 if there is no such element
+	int addParameter(string name);
+	int getNumParameters();
+
+	long getNumUnknowns();
+	// the name of unknown i, "V(node)" or "I(voltage source)"
+	string getUnknownName(long i);
+
+	/*
+	*	solves one copy per column of "values", whose rows are the parameters in the order they were added
+	*	(resistances, source voltages and currents, as in the netlist).
+	*	column k of "solutions" gets the unknowns of copy k, in the order of getUnknownName.
+	*	batches run in parallel on "pool", returns false if any copy is singular.
+	*/
+	bool solve(const Eigen::MatrixXd& values, Eigen::MatrixXd& solutions, ThreadPool* pool);
+
+	// the copies of the last solve that had to be solved alone
+	long getNumFallbacks();
+
+	// reads a CSV of parameter values, a header of element names then one line per copy
+	static bool readValues(string path, vector<string>& names, Eigen::MatrixXd& values);
+
+	// writes one CSV line per copy with its unknowns
+	bool writeSolutions(string path, const Eigen::MatrixXd& solutions);
+};
+
+#endif
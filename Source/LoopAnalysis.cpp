@@ -0,0 +1,240 @@
+#include "LoopAnalysis.h"
+#include "Circuit.h"
+#include "NodeMerge.h"
+#include "RefinedSolver.h"
+#include "Ordering.h"
+
+static const char* formulationNames[LoopAnalysis::NUM_FORMULATIONS] = {
+	"auto", "nodal", "loop"
+};
+
+LoopAnalysis::LoopAnalysis(Circuit* c, long maxEntries) {
+	circuit = c;
+	ready = false;
+	unknowns = 0;
+	solver = NULL;
+	factorized = false;
+	orderingName = "none";
+	// the loops only depend on the connections, the sources that superposition turns off are read per solve.
+	// the reduced port models of the instances are admittances, they have no branches to close loops through,
+	// and the loops of a switched circuit would change with its switches, whose states the nodal factors cache
+	if (!c->instances->empty() || !c->switches->empty())
+		return;
+
+	// a voltage source drives its current from its negative node to its positive one, and so does a current source
+	Branch branch;
+	for (vector<Element*>::iterator it = c->voltageSources->begin(); it != c->voltageSources->end(); it++) {
+		branch.element = *it;
+		branch.p = NodeMerge::slotOf((*it)->getNegNode());
+		branch.q = NodeMerge::slotOf((*it)->getPosNode());
+		branches.push_back(branch);
+	}
+	for (vector<Element*>::iterator it = c->elements->begin(); it != c->elements->end(); it++) {
+		if ((*it)->getType() != Element::ElementType::RESISTOR)
+			continue;
+		branch.element = *it;
+		branch.p = NodeMerge::slotOf((*it)->getPosNode());
+		branch.q = NodeMerge::slotOf((*it)->getNegNode());
+		branches.push_back(branch);
+	}
+	size_t firstCurrentSource = branches.size();
+	for (vector<Element*>::iterator it = c->elements->begin(); it != c->elements->end(); it++) {
+		if ((*it)->getType() != Element::ElementType::CURRENT_SOURCE)
+			continue;
+		branch.element = *it;
+		branch.p = NodeMerge::slotOf((*it)->getNegNode());
+		branch.q = NodeMerge::slotOf((*it)->getPosNode());
+		branches.push_back(branch);
+	}
+
+	// the spanning tree, breadth first from the ground through the voltage sources and the resistors:
+	// a fundamental loop is no longer than twice the depth of the tree, a tree following a long chain
+	// would close every cross link around the whole chain
+	int slots = c->nodes->size() + c->voltageSources->size();
+	vector<vector<int> > branchesAt(slots);
+	for (size_t b = 0; b < firstCurrentSource; b++) {
+		branchesAt[branches[b].p].push_back((int)b);
+		branchesAt[branches[b].q].push_back((int)b);
+	}
+	vector<bool> inTree(branches.size(), false);
+	vector<int> depth(slots, -1), parentBranch(slots, -1);
+	parentOf.assign(slots, -1);
+	depth[0] = 0;
+	vector<int> queue(1, 0);
+	for (size_t head = 0; head < queue.size(); head++) {
+		int u = queue[head];
+		for (size_t k = 0; k < branchesAt[u].size(); k++) {
+			int b = branchesAt[u][k];
+			int w = branches[b].p == u ? branches[b].q : branches[b].p;
+			if (depth[w] >= 0)
+				continue;
+			depth[w] = depth[u] + 1;
+			parentOf[w] = u;
+			parentBranch[w] = b;
+			inTree[b] = true;
+			treeNodes.push_back(w);
+			treeBranches.push_back(b);
+			queue.push_back(w);
+		}
+	}
+	// a node reached only through current sources has no voltage the loops could give
+	for (vector<Node*>::iterator it = c->nodes->begin(); it != c->nodes->end(); it++)
+		if (depth[NodeMerge::slotOf(*it)] < 0)
+			return;
+
+	vector<Eigen::Triplet<double> > unknownTriplets, knownTriplets;
+	long budget = maxEntries;
+	for (size_t b = 0; b < branches.size(); b++) {
+		if (inTree[b])
+			continue;
+		bool fits;
+		if (b >= firstCurrentSource) {
+			fits = addLoop((int)b, (int)currentSources.size(), depth, parentBranch, knownTriplets, budget);
+			currentSources.push_back(branches[b].element);
+		}
+		else
+			fits = addLoop((int)b, (int)unknowns++, depth, parentBranch, unknownTriplets, budget);
+		if (!fits)
+			return;
+	}
+	B.resize(unknowns, branches.size());
+	B.setFromTriplets(unknownTriplets.begin(), unknownTriplets.end());
+	K.resize(currentSources.size(), branches.size());
+	K.setFromTriplets(knownTriplets.begin(), knownTriplets.end());
+	ready = true;
+}
+
+LoopAnalysis::~LoopAnalysis() {
+	delete solver;
+}
+
+bool LoopAnalysis::addLoop(int chord, int loop, const vector<int>& depth, const vector<int>& parentBranch,
+	vector<Eigen::Triplet<double> >& triplets, long& budget) {
+	// along the chord from p to q, then back from q to p through the tree, both ends climbing to their common ancestor
+	triplets.push_back(Eigen::Triplet<double>(loop, chord, 1));
+	int u = branches[chord].q, w = branches[chord].p;
+	while (u != w) {
+		if (depth[u] >= depth[w]) {
+			int b = parentBranch[u];
+			triplets.push_back(Eigen::Triplet<double>(loop, b, branches[b].p == u ? 1 : -1));
+			u = parentOf[u];
+		}
+		else {
+			int b = parentBranch[w];
+			triplets.push_back(Eigen::Triplet<double>(loop, b, branches[b].q == w ? 1 : -1));
+			w = parentOf[w];
+		}
+		if (--budget < 0)
+			return false;
+	}
+	return --budget >= 0;
+}
+
+bool LoopAnalysis::isReady() {
+	return ready;
+}
+
+long LoopAnalysis::getNumUnknowns() {
+	return unknowns;
+}
+
+long LoopAnalysis::countUnknowns(Circuit* c) {
+	long resistors = 0;
+	for (vector<Element*>::iterator it = c->elements->begin(); it != c->elements->end(); it++)
+		if ((*it)->getType() == Element::ElementType::RESISTOR)
+			resistors++;
+	return max(0L, resistors + (long)c->voltageSources->size() - (long)c->nodes->size() + 1);
+}
+
+bool LoopAnalysis::solve(Eigen::VectorXd& x) {
+	if (!ready)
+		return false;
+	SolveStats* stats = circuit->stats;
+	long n = branches.size();
+	// the drop of a branch from p to q is R i + s
+	Eigen::VectorXd R = Eigen::VectorXd::Zero(n), s = Eigen::VectorXd::Zero(n), J(currentSources.size());
+	for (long b = 0; b < n; b++) {
+		Element* e = branches[b].element;
+		if (e->getType() == Element::ElementType::RESISTOR)
+			R[b] = e->getResistance();
+		else if (e->getType() == Element::ElementType::VOLTAGE_SOURCE && e->isEnabled())
+			s[b] = -e->getVoltage();
+	}
+	for (size_t k = 0; k < currentSources.size(); k++)
+		J[k] = currentSources[k]->isEnabled() ? currentSources[k]->getCurrent() : 0;
+	Eigen::VectorXd current = K.transpose() * J;
+
+	if (unknowns > 0) {
+		Eigen::VectorXd rhs, I;
+		{
+			ScopedPhase phase(stats, SolveStats::ASSEMBLE);
+			SparseMatrix BR = B * R.asDiagonal(), Bt = B.transpose();
+			M = BR * Bt;
+			M.makeCompressed();
+			rhs = -(B * (s + R.cwiseProduct(current)));
+			stats->setSystemSize(unknowns, M.nonZeros());
+		}
+		LinearSolver::Type type = circuit->solverType == LinearSolver::AUTO ? LinearSolver::select(M) : circuit->solverType;
+		if (solver == NULL || solver->getType() != type) {
+			delete solver;
+			solver = new RefinedSolver(LinearSolver::create(type), stats);
+			factorized = false;
+			orderingName = type == LinearSolver::BANDED ? Ordering::getTypeName(Ordering::REVERSE_CUTHILL_MCKEE) : "none";
+			if (LinearSolver::usesOrdering(type)) {
+				ScopedPhase phase(stats, SolveStats::ORDER);
+				Ordering::Permutation perm;
+				orderingName = Ordering::getTypeName(Ordering::compute(M, circuit->orderingType, perm));
+				solver->setOrdering(perm);
+			}
+		}
+		{
+			ScopedPhase phase(stats, SolveStats::FACTORIZE);
+			factorized = factorized ? solver->refactorize(M) : solver->factorize(M);
+		}
+		// a loop of voltage sources alone has no resistance, the nodal equations report it
+		if (!factorized || !solver->solve(rhs, I) || solver->getBackwardError() > BACKWARD_ERROR_TOLERANCE)
+			return false;
+		if (stats->isEnabled()) {
+			stats->setSolverName(LinearSolver::getTypeName(type));
+			stats->setOrderingName(orderingName);
+			stats->addFlops(solver->getFactorFlops() + solver->getSolveFlops());
+			long factorNonzeros = solver->getFactorNonzeros();
+			// the symmetric backends keep one triangle, which may hold fewer entries than M
+			stats->setFillIn(max(0L, factorNonzeros - M.nonZeros()));
+			stats->setAccuracy(solver->getBackwardError(), solver->getConditionEstimate(), solver->getRefinementSteps());
+		}
+		current += B.transpose() * I;
+	}
+
+	// the node voltages from the drops along the tree, and the voltage source currents, at their nodal unknowns
+	vector<double> voltage(parentOf.size(), 0);
+	for (size_t k = 0; k < treeNodes.size(); k++) {
+		int w = treeNodes[k], b = treeBranches[k], u = parentOf[w];
+		double drop = R[b] * current[b] + s[b];
+		voltage[w] = branches[b].p == u ? voltage[u] - drop : voltage[u] + drop;
+	}
+	x = Eigen::VectorXd::Zero(circuit->nodes->size() + circuit->voltageSources->size() - 1);
+	for (vector<Node*>::iterator it = circuit->nodes->begin(); it != circuit->nodes->end(); it++)
+		if (!(*it)->isGround())
+			x[(*it)->getId()] = voltage[NodeMerge::slotOf(*it)];
+	for (long b = 0; b < n; b++)
+		if (branches[b].element->getType() == Element::ElementType::VOLTAGE_SOURCE)
+			x[branches[b].element->getId()] = current[b];
+	return true;
+}
+
+bool LoopAnalysis::parseFormulation(string name, Formulation& formulation) {
+	for (int i = 0; i < NUM_FORMULATIONS; i++) {
+		if (name == formulationNames[i]) {
+			formulation = (Formulation)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* LoopAnalysis::getFormulationName(Formulation formulation) {
+	if (formulation < 0 || formulation >= NUM_FORMULATIONS)
+		return "?";
+	return formulationNames[formulation];
+}
@@ -0,0 +1,90 @@
+#ifndef LOOPANALYSIS_H
+#define LOOPANALYSIS_H
+
+#include <string>
+#include <vector>
+#include "Eigen/Dense"
+#include "LinearSolver.h"
+
+using namespace std;
+
+class Circuit;
+class Element;
+class RefinedSolver;
+
+/*
+*	loop (mesh) analysis: the unknowns are the currents of the fundamental loops of a spanning tree instead of
+*	the node voltages, b - n + 1 of them for b branches and n nodes, far fewer than the nodal unknowns in a
+*	circuit with many nodes and few independent loops (long chains, trees of resistors, sparse grids).
+*		the tree is grown breadth first from the ground through the voltage sources and the resistors, the
+*		current sources are always left out so that each of them closes a loop of its own whose current it fixes.
+*		every other branch left out of the tree (a chord) closes an unknown loop through the tree, and B is their
+*		loop-branch incidence, +1 where the loop runs along the branch. with R the resistances and s the
+*		source voltages of the branches, Kirchhoff's voltage law around the unknown loops reads
+*			B R B^T I = -B (s + R i_known)
+*		where i_known are the branch currents of the current source loops, a symmetric positive definite system.
+*	the branch currents follow as B^T I + i_known, the node voltages from the drops along the tree from the ground,
+*	so the results come out in the layout of the nodal unknowns and are deployed like them.
+*	the loops are built once per topology, every solve reads the present element values.
+*/
+
+class LoopAnalysis {
+
+public: enum Formulation {
+	AUTO, NODAL, LOOP, NUM_FORMULATIONS
+};
+
+private:
+	Circuit* circuit;
+	bool ready;
+
+	// a branch carries its current from node p to node q, by slot (node id + 1, 0 for the ground)
+	struct Branch {
+		Element* element;
+		int p, q;
+	};
+	vector<Branch> branches;
+	// the tree in breadth first order from the ground: the branch to every node but the ground from its parent
+	vector<int> treeNodes, treeBranches;
+	vector<int> parentOf;
+	// the incidence of the unknown loops and of the current source loops, one row per loop
+	SparseMatrix B, K;
+	vector<Element*> currentSources;
+	long unknowns;
+	SparseMatrix M;
+	RefinedSolver* solver;
+	bool factorized;
+	const char* orderingName;
+
+	// appends the fundamental loop of "chord" to "triplets" as row "loop", false once more than "budget" entries were added
+	bool addLoop(int chord, int loop, const vector<int>& depth, const vector<int>& parentBranch,
+		vector<Eigen::Triplet<double> >& triplets, long& budget);
+
+public:
+	/*
+	*	builds the spanning tree and the loops of "c", see isReady
+	*	@param maxEntries : the loops are given up (not ready) when their incidence would hold more entries,
+	*	long fundamental loops make the loop matrix denser than the nodal one
+	*/
+	LoopAnalysis(Circuit* c, long maxEntries);
+	~LoopAnalysis();
+
+	// false if the circuit has no loop formulation (an instance, a switch, a node reached only through current sources)
+	bool isReady();
+
+	// gets the number of unknown loop currents
+	long getNumUnknowns();
+
+	// the number of unknown loop currents of "c" once its tree spans all of its nodes, without building it
+	static long countUnknowns(Circuit* c);
+
+	// solves with the present element values, "x" gets the node voltages and voltage source currents
+	// indexed by their ids, as the nodal equations would give them. false if the loop system is singular.
+	bool solve(Eigen::VectorXd& x);
+
+	// parses a formulation name as printed by getFormulationName
+	static bool parseFormulation(string name, Formulation& formulation);
+	static const char* getFormulationName(Formulation formulation);
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {
+	data = NULL;
+	size = 0;
+	writable = false;
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mapHandle = NULL;
+#else
+	fd = -1;
+#endif
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::openRead(string path) {
+	close();
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fsize;
+	if (!GetFileSizeEx(fileHandle, &fsize) || fsize.QuadPart == 0) {
+		close();
+		return false;
+	}
+	mapHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapHandle == NULL) {
+		close();
+		return false;
+	}
+	data = MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL) {
+		close();
+		return false;
+	}
+	size = (size_t)fsize.QuadPart;
+	writable = false;
+	return true;
+}
+
+bool MappedFile::create(string path, size_t size) {
+	close();
+	if (size == 0)
+		return false;
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+	unsigned long long s = size;
+	mapHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READWRITE, (DWORD)(s >> 32), (DWORD)(s & 0xFFFFFFFF), NULL);
+	if (mapHandle == NULL) {
+		close();
+		return false;
+	}
+	data = MapViewOfFile(mapHandle, FILE_MAP_WRITE, 0, 0, size);
+	if (data == NULL) {
+		close();
+		return false;
+	}
+	this->size = size;
+	writable = true;
+	return true;
+}
+
+bool MappedFile::flush() {
+	if (data == NULL || !writable)
+		return false;
+	return FlushViewOfFile(data, size) != 0;
+}
+
+void MappedFile::close() {
+	if (data != NULL)
+		UnmapViewOfFile(data);
+	if (mapHandle != NULL)
+		CloseHandle(mapHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+	data = NULL;
+	mapHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+	size = 0;
+	writable = false;
+}
+
+#else
+
+bool MappedFile::openRead(string path) {
+	close();
+	fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close();
+		return false;
+	}
+	// MAP_SHARED so that every process reading the same file shares its page cache copy
+	data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		data = NULL;
+		close();
+		return false;
+	}
+	size = (size_t)st.st_size;
+	writable = false;
+	return true;
+}
+
+bool MappedFile::create(string path, size_t size) {
+	close();
+	if (size == 0)
+		return false;
+	fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+	if (ftruncate(fd, (off_t)size) != 0) {
+		close();
+		return false;
+	}
+	data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		data = NULL;
+		close();
+		return false;
+	}
+	this->size = size;
+	writable = true;
+	return true;
+}
+
+bool MappedFile::flush() {
+	if (data == NULL || !writable)
+		return false;
+	return msync(data, size, MS_SYNC) == 0;
+}
+
+void MappedFile::close() {
+	if (data != NULL)
+		munmap(data, size);
+	if (fd >= 0)
+		::close(fd);
+	data = NULL;
+	fd = -1;
+	size = 0;
+	writable = false;
+}
+
+#endif
+
+bool MappedFile::isOpen() {
+	return data != NULL;
+}
+
+void* MappedFile::getData() {
+	return data;
+}
+
+size_t MappedFile::getSize() {
+	return size;
+}
@@ -0,0 +1,52 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+/*
+*	a file mapped into memory, either read-only (shared between every process that maps it)
+*	or read-write with a fixed size chosen when the file is created.
+*	the mapping is released when the object is destroyed.
+*/
+
+class MappedFile {
+
+private:
+	void* data;
+	size_t size;
+	bool writable;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mapHandle;
+#else
+	int fd;
+#endif
+
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	// maps an existing file read-only
+	bool openRead(string path);
+
+	// creates (or truncates) a file of "size" bytes and maps it read-write
+	bool create(string path, size_t size);
+
+	// flushes the dirty pages of a writable mapping to disk
+	bool flush();
+
+	// unmaps the file and closes it
+	void close();
+
+	bool isOpen();
+	void* getData();
+	size_t getSize();
+};
+
+#endif
@@ -0,0 +1,286 @@
+#include "ModelReduction.h"
+#include "Circuit.h"
+#include "NodeMerge.h"
+#include "RefinedSolver.h"
+#include "Ordering.h"
+#include "ResultExport.h"
+#include "Eigen/Eigenvalues"
+#include <cmath>
+
+// a column is dropped from a Krylov block when orthogonalization leaves less than this fraction of its norm
+#define DEFLATION_TOLERANCE 1e-10
+
+ModelReduction::ModelReduction(Circuit* c) {
+	circuit = c;
+	ready = false;
+	n = 0;
+	solver = NULL;
+	shift = -1;
+	if (!c->iscleaned)
+		c->cleanUpSP();
+	if (!c->instances->empty()) {
+		cout << "ERROR: Model order reduction is not supported across subcircuit instances.\n";
+		return;
+	}
+
+	// the rows of G and C, the nodes shorted together by a source or a closed switch share one
+	Node* floating;
+	long merged = NodeMerge::merge(c, rowOf, floating);
+	if (merged < 0) {
+		cout << "ERROR: Node [" << floating->getName() << "] has no resistive path to the ground, the network has no DC model to reduce.\n";
+		return;
+	}
+	n = merged;
+
+	// a resistor stamps its conductance into G and a capacitor its capacitance into C, the same way
+	vector<Eigen::Triplet<double> > conductances, capacitances;
+	for (vector<Element*>::iterator it = c->elements->begin(); it != c->elements->end(); it++) {
+		double x;
+		vector<Eigen::Triplet<double> >* triplets;
+		if ((*it)->getType() == Element::ElementType::RESISTOR) {
+			x = 1 / (*it)->getResistance();
+			triplets = &conductances;
+		}
+		else if ((*it)->getType() == Element::ElementType::CAPACITOR) {
+			x = (*it)->getCapacitance();
+			triplets = &capacitances;
+		}
+		else
+			continue;
+		int a = rowOf[NodeMerge::slotOf((*it)->getPosNode())];
+		int b = rowOf[NodeMerge::slotOf((*it)->getNegNode())];
+		if (a == b)
+			continue;
+		if (a >= 0)
+			triplets->push_back(Eigen::Triplet<double>(a, a, x));
+		if (b >= 0)
+			triplets->push_back(Eigen::Triplet<double>(b, b, x));
+		if (a >= 0 && b >= 0) {
+			triplets->push_back(Eigen::Triplet<double>(a, b, -x));
+			triplets->push_back(Eigen::Triplet<double>(b, a, -x));
+		}
+	}
+	G.resize(n, n);
+	G.setFromTriplets(conductances.begin(), conductances.end());
+	G.makeCompressed();
+	C.resize(n, n);
+	C.setFromTriplets(capacitances.begin(), capacitances.end());
+	C.makeCompressed();
+	ready = true;
+}
+
+ModelReduction::~ModelReduction() {
+	delete solver;
+}
+
+bool ModelReduction::isReady() {
+	return ready;
+}
+
+long ModelReduction::getNumNodes() {
+	return n;
+}
+
+bool ModelReduction::findRow(string name, int& row) {
+	Node* node = circuit->getNode(name);
+	if (node == NULL) {
+		cout << "ERROR: Node [" << name << "] does not exist.\n";
+		return false;
+	}
+	row = rowOf[NodeMerge::slotOf(node)];
+	return true;
+}
+
+int ModelReduction::appendBlock(Eigen::MatrixXd& V, long& order, Eigen::MatrixXd& block) {
+	int appended = 0;
+	for (long j = 0; j < block.cols(); j++) {
+		Eigen::VectorXd w = block.col(j);
+		double norm = w.norm();
+		if (norm == 0)
+			continue;
+		// classical Gram-Schmidt twice is as accurate as the modified one and works a block of columns at a time
+		for (int pass = 0; pass < 2 && order > 0; pass++)
+			w -= V.leftCols(order) * (V.leftCols(order).transpose() * w);
+		double left = w.norm();
+		if (left <= DEFLATION_TOLERANCE * norm)
+			continue;
+		V.col(order++) = w / left;
+		appended++;
+	}
+	return appended;
+}
+
+bool ModelReduction::reduce(const vector<string>& posNodes, const vector<string>& negNodes, int moments, double frequency) {
+	if (!ready)
+		return false;
+	if (posNodes.size() != negNodes.size() || posNodes.empty() || moments < 1) {
+		cout << "ERROR: A reduction needs at least one port, with a positive and a negative node each, and one moment.\n";
+		return false;
+	}
+	if (n == 0 || frequency < 0) {
+		cout << "ERROR: There is no network to reduce, or the expansion frequency is negative.\n";
+		return false;
+	}
+	long p = posNodes.size();
+	Eigen::MatrixXd B = Eigen::MatrixXd::Zero(n, p);
+	for (long k = 0; k < p; k++) {
+		int a, b;
+		if (!findRow(posNodes[k], a) || !findRow(negNodes[k], b))
+			return false;
+		if (a == b) {
+			cout << "ERROR: Port " << posNodes[k] << " " << negNodes[k] << " is shorted by a voltage source.\n";
+			return false;
+		}
+		if (a >= 0)
+			B(a, k) += 1;
+		if (b >= 0)
+			B(b, k) -= 1;
+	}
+	posNames = posNodes;
+	negNames = negNodes;
+
+	// G + s0 C is symmetric positive definite, the backend is picked as for a circuit without voltage sources.
+	// the pattern is that of G and C together whatever s0 is, the ordering is computed once
+	double s0 = 2 * acos(-1.0) * frequency;
+	if (s0 != shift) {
+		SparseMatrix A = G + s0 * C;
+		if (solver == NULL) {
+			LinearSolver::Type type = circuit->solverType == LinearSolver::AUTO ? LinearSolver::select(A) : circuit->solverType;
+			solver = new RefinedSolver(LinearSolver::create(type), NULL);
+			if (LinearSolver::usesOrdering(type)) {
+				Ordering::Permutation perm;
+				Ordering::compute(A, circuit->orderingType, perm);
+				solver->setOrdering(perm);
+			}
+		}
+		if (!solver->factorize(A)) {
+			cout << "ERROR: The conductance matrix could not be factorized.\n";
+			return false;
+		}
+		shift = s0;
+	}
+	// block Arnoldi on (G + s0 C)^-1 C from (G + s0 C)^-1 B, one block of solves per moment
+	long maxOrder = min((long)moments * p, n);
+	Eigen::MatrixXd V(n, maxOrder), R, X;
+	long order = 0;
+	R = B;
+	for (int moment = 0; moment < moments && order < maxOrder; moment++) {
+		if (!solver->solveMany(R, X) || solver->getBackwardError() > BACKWARD_ERROR_TOLERANCE) {
+			cout << "ERROR: The Krylov block of moment " << moment << " could not be solved accurately.\n";
+			return false;
+		}
+		X.conservativeResize(Eigen::NoChange, min(X.cols(), maxOrder - order));
+		long first = order;
+		if (appendBlock(V, order, X) == 0)
+			break;
+		R = C * V.middleCols(first, order - first);
+	}
+
+	// the congruence, symmetrized against rounding
+	Eigen::MatrixXd basis = V.leftCols(order);
+	Eigen::MatrixXd GV = G * basis, CV = C * basis;
+	Gr = basis.transpose() * GV;
+	Cr = basis.transpose() * CV;
+	Gr = 0.5 * (Gr + Gr.transpose()).eval();
+	Cr = 0.5 * (Cr + Cr.transpose()).eval();
+	Br = basis.transpose() * B;
+	return true;
+}
+
+int ModelReduction::getOrder() {
+	return (int)Gr.rows();
+}
+
+int ModelReduction::getNumPorts() {
+	return (int)Br.cols();
+}
+
+const Eigen::MatrixXd& ModelReduction::getConductances() {
+	return Gr;
+}
+
+const Eigen::MatrixXd& ModelReduction::getCapacitances() {
+	return Cr;
+}
+
+const Eigen::MatrixXd& ModelReduction::getIncidence() {
+	return Br;
+}
+
+bool ModelReduction::getImpedance(double frequency, Eigen::MatrixXcd& Z) {
+	if (Gr.rows() == 0)
+		return false;
+	complex<double> s(0, 2 * acos(-1.0) * frequency);
+	Eigen::MatrixXcd A = Gr.cast<complex<double> >() + s * Cr.cast<complex<double> >();
+	Eigen::MatrixXcd Bc = Br.cast<complex<double> >();
+	Z = Bc.transpose() * A.partialPivLu().solve(Bc);
+	return Z.allFinite();
+}
+
+bool ModelReduction::getTimeConstants(Eigen::VectorXd& tau) {
+	if (Gr.rows() == 0)
+		return false;
+	// Gr is positive definite, the symmetric definite generalized problem has real eigenvalues
+	Eigen::GeneralizedSelfAdjointEigenSolver<Eigen::MatrixXd> eigen(Cr, Gr, Eigen::EigenvaluesOnly);
+	if (eigen.info() != Eigen::Success) {
+		cout << "ERROR: The time constants of the reduced model did not converge.\n";
+		return false;
+	}
+	tau = eigen.eigenvalues();
+	return true;
+}
+
+bool ModelReduction::simulate(const Eigen::MatrixXd& currents, double step, Eigen::MatrixXd& voltages) {
+	if (Gr.rows() == 0 || currents.rows() != Br.cols() || step <= 0)
+		return false;
+	// (Cr / h + Gr) x' = Cr / h x + Br i', positive definite like Gr
+	Eigen::MatrixXd M = Cr / step + Gr;
+	Eigen::LLT<Eigen::MatrixXd> llt(M);
+	if (llt.info() != Eigen::Success)
+		return false;
+	Eigen::MatrixXd Cstep = Cr / step;
+	Eigen::VectorXd x = Eigen::VectorXd::Zero(Gr.rows());
+	voltages.resize(currents.rows(), currents.cols());
+	for (long t = 0; t < currents.cols(); t++) {
+		x = llt.solve(Cstep * x + Br * currents.col(t));
+		voltages.col(t) = Br.transpose() * x;
+	}
+	return voltages.allFinite();
+}
+
+bool ModelReduction::write(string path) {
+	if (Gr.rows() == 0)
+		return false;
+	BufferedWriter out;
+	if (!out.open(path)) {
+		cout << "ERROR: Can not write " << path << ".\n";
+		return false;
+	}
+	// Z(s) = B^T (G + s C)^-1 B, one line per port, then the rows of G, C and B
+	out.putString("* reduced model of order " + to_string(Gr.rows()) + ", Z(s) = B^T (G + s C)^-1 B\n");
+	for (size_t k = 0; k < posNames.size(); k++)
+		out.putString("port " + posNames[k] + " " + negNames[k] + "\n");
+	const Eigen::MatrixXd* matrices[3] = { &Gr, &Cr, &Br };
+	const char* names[3] = { "G", "C", "B" };
+	for (int m = 0; m < 3; m++) {
+		out.putString(names[m]);
+		out.put('\n');
+		for (long i = 0; i < matrices[m]->rows(); i++) {
+			for (long j = 0; j < matrices[m]->cols(); j++) {
+				if (j > 0)
+					out.put(' ');
+				out.putDouble((*matrices[m])(i, j));
+			}
+			out.put('\n');
+		}
+	}
+	return out.close();
+}
+
+void ModelReduction::print(ostream& out) {
+	out << "Reduced " << n << " nodes to order " << Gr.rows() << " at " << Br.cols() << " ports";
+	Eigen::VectorXd tau;
+	if (Gr.rows() > 0 && getTimeConstants(tau))
+		out << ", slowest time constant " << tau[tau.size() - 1] << " seconds";
+	out << ".\n";
+}
@@ -0,0 +1,110 @@
+#ifndef MODELREDUCTION_H
+#define MODELREDUCTION_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <complex>
+#include "Eigen/Dense"
+#include "LinearSolver.h"
+
+using namespace std;
+
+class Circuit;
+class Node;
+class RefinedSolver;
+
+/*
+*	model order reduction of an RC network seen from a few ports (PRIMA, Odabasioglu, Celik and Pileggi).
+*	with every source turned off (the voltage sources short their nodes, the current sources are left open)
+*	the network is G v + C dv/dt = B i, where G holds the conductances and C the capacitances of the nodes
+*	left once the shorted ones are merged and the ground removed, and column k of B injects the current of
+*	port k into its positive node and draws it from its negative one. the port voltages are B^T v, so the
+*	port impedance is Z(s) = B^T (G + s C)^-1 B.
+*		G + s0 C is factorized once per expansion point s0 (0 unless a frequency band far above DC matters),
+*		and block Arnoldi builds an orthonormal basis V of the Krylov subspace, with A = (G + s0 C)^-1,
+*			span { A B, (A C) A B, ..., (A C)^(q-1) A B }
+*		one block of solves per moment, each block orthogonalized twice against the basis (Gram-Schmidt),
+*		columns that vanish in it are dropped (deflation) and the basis may stop short of q blocks.
+*		the reduced model is the congruence Gr = V^T G V, Cr = V^T C V, Br = V^T B, of order at most q ports,
+*		and its impedance matches the first q block moments of Z(s) about s = s0.
+*	a congruence keeps Gr positive definite and Cr positive semidefinite, so the reduced model is passive
+*	as the network is, whatever q is. its dense matrices are then cheap to evaluate per frequency (AC),
+*	to step in time (transient) and to write out for other simulators.
+*	the values are the ones at construction, a new engine is needed when the circuit changes.
+*/
+
+class ModelReduction {
+
+private:
+	Circuit* circuit;
+	bool ready;
+
+	// the row of G every node is reduced to, -1 for the ground and the nodes shorted to it, by node id + 1
+	vector<int> rowOf;
+	long n;
+	SparseMatrix G, C;
+	// the factors of G + s0 C for the expansion point of the last reduction
+	RefinedSolver* solver;
+	double shift;
+
+	// the ports of the last reduction and the reduced model
+	vector<string> posNames, negNames;
+	Eigen::MatrixXd Gr, Cr, Br;
+
+	// the row of G of node "name", false with an error if there is no such node
+	bool findRow(string name, int& row);
+
+	// orthonormalizes the columns of "block" against the first "order" columns of "V" and appends the ones
+	// that do not vanish, returns how many were appended
+	static int appendBlock(Eigen::MatrixXd& V, long& order, Eigen::MatrixXd& block);
+
+public:
+	// builds the conductance and the capacitance matrices of "c", see isReady
+	ModelReduction(Circuit* c);
+	~ModelReduction();
+
+	// false if the network has no DC model (a node with no resistive path to the ground)
+	bool isReady();
+
+	// gets the number of nodes left once the shorted ones are merged and the ground removed
+	long getNumNodes();
+
+	/*
+	*	reduces the network seen from the ports (posNodes[k], negNodes[k])
+	*	@param moments : the block moments matched, the order of the model is at most moments * ports
+	*	@param frequency : the moments are taken about s0 = 2 pi frequency, real so that the model stays passive
+	*/
+	bool reduce(const vector<string>& posNodes, const vector<string>& negNodes, int moments, double frequency = 0);
+
+	// the order of the reduced model, 0 before reduce
+	int getOrder();
+	int getNumPorts();
+
+	// the reduced conductance, capacitance and port incidence matrices
+	const Eigen::MatrixXd& getConductances();
+	const Eigen::MatrixXd& getCapacitances();
+	const Eigen::MatrixXd& getIncidence();
+
+	// the port impedance matrix Z(j 2 pi frequency) of the reduced model (AC analysis)
+	bool getImpedance(double frequency, Eigen::MatrixXcd& Z);
+
+	// the time constants of the reduced model, Cr v = tau Gr v, in increasing order. its poles are -1 / tau
+	bool getTimeConstants(Eigen::VectorXd& tau);
+
+	/*
+	*	steps the reduced model in time by backward Euler from rest (transient analysis)
+	*	@param currents : the current into every port (rows) at every step (columns)
+	*	@param step : the time step in seconds
+	*	@param voltages : the port voltages at every step
+	*/
+	bool simulate(const Eigen::MatrixXd& currents, double step, Eigen::MatrixXd& voltages);
+
+	// writes the ports and the matrices of the reduced model as text
+	bool write(string path);
+
+	// prints the size of the network and of the reduced model with its slowest time constant
+	void print(ostream& out);
+};
+
+#endif
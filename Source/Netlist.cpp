@@ -0,0 +1,391 @@
+#include "Netlist.h"
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+struct Token {
+	const char* begin;
+	const char* end;
+
+	string str() const { return string(begin, end); }
+};
+
+// case-insensitive comparison of a token with a lower case word
+static bool tokenIs(const Token& t, const char* word) {
+	size_t len = strlen(word);
+	if ((size_t)(t.end - t.begin) != len)
+		return false;
+	for (size_t i = 0; i < len; i++)
+		if (tolower(t.begin[i]) != word[i])
+			return false;
+	return true;
+}
+
+static bool startsWithNoCase(const char* begin, const char* end, const char* word) {
+	size_t len = strlen(word);
+	if ((size_t)(end - begin) < len)
+		return false;
+	for (size_t i = 0; i < len; i++)
+		if (tolower(begin[i]) != word[i])
+			return false;
+	return true;
+}
+
+bool parseValue(const char* begin, const char* end, double& value) {
+	if (begin < end && *begin == '+')
+		begin++;
+	from_chars_result r = from_chars(begin, end, value);
+	if (r.ec != errc() || r.ptr == begin)
+		return false;
+	const char* s = r.ptr;
+	if (s == end)
+		return true;
+	// SPICE scale factors, anything that follows them is a unit name and is ignored
+	if (startsWithNoCase(s, end, "meg"))
+		value *= 1e6;
+	else if (startsWithNoCase(s, end, "mil"))
+		value *= 25.4e-6;
+	else {
+		switch (tolower(*s)) {
+		case 't': value *= 1e12; break;
+		case 'g': value *= 1e9; break;
+		case 'k': value *= 1e3; break;
+		case 'm': value *= 1e-3; break;
+		case 'u': value *= 1e-6; break;
+		case 'n': value *= 1e-9; break;
+		case 'p': value *= 1e-12; break;
+		case 'f': value *= 1e-15; break;
+		default:
+			if (!isalpha((unsigned char)*s))
+				return false;
+			break;
+		}
+	}
+	return true;
+}
+
+static string nodeName(const Token& t) {
+	if (tokenIs(t, "gnd"))
+		return "0";
+	return t.str();
+}
+
+// reads the element described by one logical line, with the circuit's conventions for its nodes and value
+static bool readElement(const vector<Token>& tokens, NetlistElement& element, string& error) {
+	char kind = toupper(*tokens[0].begin);
+	Element::ElementType et;
+	switch (kind) {
+	case 'R':
+		et = Element::ElementType::RESISTOR;
+		break;
+	case 'V':
+		et = Element::ElementType::VOLTAGE_SOURCE;
+		break;
+	case 'E':
+		// read as a source, its control nodes would be taken for its value
+		error = "voltage-controlled source " + tokens[0].str() + " is not supported";
+		return false;
+	case 'I':
+	case 'J':
+		et = Element::ElementType::CURRENT_SOURCE;
+		break;
+	case 'S':
+		et = Element::ElementType::SWITCH;
+		break;
+	case 'C':
+		et = Element::ElementType::CAPACITOR;
+		break;
+	default:
+		error = "unsupported element " + tokens[0].str();
+		return false;
+	}
+
+	size_t valueToken = 3;
+	if ((et == Element::ElementType::VOLTAGE_SOURCE || et == Element::ElementType::CURRENT_SOURCE) && tokens.size() > 4 && tokenIs(tokens[3], "dc"))
+		valueToken = 4;
+	if (tokens.size() <= valueToken) {
+		error = "element " + tokens[0].str() + " needs two nodes and a value";
+		return false;
+	}
+	double value;
+	if (et == Element::ElementType::SWITCH && (tokenIs(tokens[valueToken], "on") || tokenIs(tokens[valueToken], "off")))
+		value = tokenIs(tokens[valueToken], "on") ? 1 : 0;
+	else if (!parseValue(tokens[valueToken].begin, tokens[valueToken].end, value) || !isfinite(value)) {
+		error = "invalid value " + tokens[valueToken].str();
+		return false;
+	}
+
+	string name = tokens[0].str();
+	string posNode = nodeName(tokens[1]);
+	string negNode = nodeName(tokens[2]);
+	if (posNode == negNode) {
+		error = "element " + name + " is connected twice to node " + posNode;
+		return false;
+	}
+	if (et == Element::ElementType::RESISTOR) {
+		if (value < 0) {
+			error = "negative resistance " + tokens[valueToken].str();
+			return false;
+		}
+		// a zero resistance is a short, modelled as a zero volt source like the interactive input does
+		if (value == 0)
+			et = Element::ElementType::VOLTAGE_SOURCE;
+	}
+	else if (et == Element::ElementType::CAPACITOR && value < 0) {
+		error = "negative capacitance " + tokens[valueToken].str();
+		return false;
+	}
+	else if (et == Element::ElementType::CURRENT_SOURCE) {
+		// SPICE current flows from n+ to n- inside the source, the circuit's convention is the opposite
+		swap(posNode, negNode);
+	}
+	element.name = name;
+	element.posNode = posNode;
+	element.negNode = negNode;
+	element.value = value;
+	element.type = et;
+	return true;
+}
+
+// adds the element described by one logical line to the circuit, or to the definition "def" when one is open
+static bool parseElement(const vector<Token>& tokens, Circuit* c, Subcircuit* def, string& error) {
+	NetlistElement e;
+	if (!readElement(tokens, e, error))
+		return false;
+	if (def != NULL && e.type == Element::ElementType::SWITCH) {
+		error = "switch " + e.name + " can not be part of a subcircuit, its instances would switch together";
+		return false;
+	}
+	// readElement has checked the nodes and the value, a name taken before is what is left
+	if (def != NULL ? def->getEntry(e.name) >= 0 : c->getElementType(e.name) != Element::ElementType::ERROR) {
+		error = "element " + e.name + " already exists";
+		return false;
+	}
+	bool added = def != NULL ? def->addElement(e.name, e.value, e.posNode, e.negNode, e.type)
+		: c->addElement(e.name, e.value, e.posNode, e.negNode, e.type);
+	if (!added) {
+		error = "element " + e.name + " could not be added";
+		return false;
+	}
+	return true;
+}
+
+// X<name> <node1> ... <nodeN> <subcircuit>, instantiated in the circuit or copied into the open definition "def"
+static bool parseInstance(const vector<Token>& tokens, Circuit* c, Subcircuit* def, string& error) {
+	string name = tokens[0].str();
+	if (tokens.size() < 3) {
+		error = "instance " + name + " needs its nodes and a subcircuit";
+		return false;
+	}
+	string subName = tokens.back().str();
+	Subcircuit* sub = c->getSubcircuit(subName);
+	if (sub == NULL) {
+		error = "unknown subcircuit " + subName;
+		return false;
+	}
+	vector<string> nodes;
+	for (size_t i = 1; i + 1 < tokens.size(); i++)
+		nodes.push_back(nodeName(tokens[i]));
+	if ((int)nodes.size() != sub->getNumPorts()) {
+		error = "instance " + name + " connects " + to_string(nodes.size()) + " nodes to the "
+			+ to_string(sub->getNumPorts()) + " ports of " + subName;
+		return false;
+	}
+	bool added = def != NULL ? def->addInstance(name, sub, nodes) : c->addInstance(name, subName, nodes);
+	if (!added) {
+		error = "instance " + name + " already exists or is connected twice to a node";
+		return false;
+	}
+	return true;
+}
+
+// .subckt <name> <port1> ... <portN>
+static Subcircuit* parseDefinition(const vector<Token>& tokens, string& error) {
+	if (tokens.size() < 3) {
+		error = "a subcircuit needs a name and at least one port";
+		return NULL;
+	}
+	vector<string> ports;
+	for (size_t i = 2; i < tokens.size(); i++) {
+		string port = nodeName(tokens[i]);
+		if (port == "0") {
+			error = "the ground can not be a port of subcircuit " + tokens[1].str();
+			return NULL;
+		}
+		for (size_t j = 0; j < ports.size(); j++) {
+			if (ports[j] == port) {
+				error = "port " + port + " is listed twice";
+				return NULL;
+			}
+		}
+		ports.push_back(port);
+	}
+	return new Subcircuit(tokens[1].str(), ports);
+}
+
+/*
+*	splits the text between "p" and "end" into logical lines and hands the tokens of each one to "line"
+*	with the number of its first physical line. reading stops when "line" returns false or sets "done".
+*	line 1 is the title, as in SPICE, and is never handed over.
+*/
+static bool readLines(const char* p, const char* end, const function<bool(const vector<Token>&, int, bool&)>& line) {
+	vector<Token> tokens;
+	int lineNo = 0, logicalLine = 0;
+	bool done = false;
+
+	while (!done) {
+		// one physical line
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		if (eol == NULL)
+			eol = end;
+		lineNo++;
+		const char* s = p;
+		while (s < eol && isspace((unsigned char)*s))
+			s++;
+		bool continuation = s < eol && *s == '+';
+		bool atEnd = p >= end;
+
+		// a new logical line starts, so the previous one is complete
+		if (!continuation && !tokens.empty()) {
+			if (logicalLine != 1 && !line(tokens, logicalLine, done))
+				return false;
+			tokens.clear();
+		}
+		if (done || atEnd)
+			break;
+
+		if (continuation)
+			s++;
+		else if (s < eol && *s == '*')
+			s = eol;
+		if (!continuation)
+			logicalLine = lineNo;
+		while (s < eol) {
+			if (*s == ';' || *s == '$')
+				break;
+			if (isspace((unsigned char)*s) || *s == ',' || *s == '(' || *s == ')' || *s == '=') {
+				s++;
+				continue;
+			}
+			Token t;
+			t.begin = s;
+			while (s < eol && !isspace((unsigned char)*s) && *s != ',' && *s != ';' && *s != '(' && *s != ')' && *s != '=')
+				s++;
+			t.end = s;
+			tokens.push_back(t);
+		}
+		p = eol + (eol < end ? 1 : 0);
+	}
+	return true;
+}
+
+bool parseNetlist(const string& text, Circuit* c, string source) {
+	if (!c->addNode("0")) {
+		cout << "ERROR: A netlist can only be read into an empty circuit.\n";
+		return false;
+	}
+
+	// the definition being read, and the instances of the top level, which may use definitions that follow them
+	Subcircuit* def = NULL;
+	vector<vector<Token> > instances;
+	vector<int> instanceLines;
+
+	bool read = readLines(text.data(), text.data() + text.size(), [&](const vector<Token>& tokens, int logicalLine, bool& done) {
+		string error;
+		bool failed = false;
+		if (tokenIs(tokens[0], ".subckt")) {
+			if (def != NULL) {
+				error = "subcircuit definitions can not be nested";
+				failed = true;
+			}
+			else
+				failed = (def = parseDefinition(tokens, error)) == NULL;
+		}
+		else if (tokenIs(tokens[0], ".ends")) {
+			if (def == NULL) {
+				error = ".ends without .subckt";
+				failed = true;
+			}
+			else if (!c->addSubcircuit(def)) {
+				error = "subcircuit " + def->getName() + " is defined twice";
+				delete def;
+				failed = true;
+			}
+			def = NULL;
+		}
+		else if (*tokens[0].begin == '.') {
+			if (tokenIs(tokens[0], ".end"))
+				done = true;
+		}
+		else if (toupper(*tokens[0].begin) == 'X') {
+			if (def != NULL)
+				failed = !parseInstance(tokens, c, def, error);
+			else {
+				instances.push_back(tokens);
+				instanceLines.push_back(logicalLine);
+			}
+		}
+		else
+			failed = !parseElement(tokens, c, def, error);
+		if (failed) {
+			cout << "ERROR: " << source << ":" << logicalLine << ": " << error << ".\n";
+			delete def;
+			def = NULL;
+			return false;
+		}
+		return true;
+	});
+	if (!read)
+		return false;
+	if (def != NULL) {
+		cout << "ERROR: " << source << ": subcircuit " << def->getName() << " is missing its .ends.\n";
+		delete def;
+		return false;
+	}
+
+	for (size_t i = 0; i < instances.size(); i++) {
+		string error;
+		if (!parseInstance(instances[i], c, NULL, error)) {
+			cout << "ERROR: " << source << ":" << instanceLines[i] << ": " << error << ".\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool scanNetlist(const char* text, size_t size, const function<bool(const NetlistElement&)>& sink, string source) {
+	return readLines(text, text + size, [&](const vector<Token>& tokens, int logicalLine, bool& done) {
+		string error;
+		NetlistElement element;
+		if (tokenIs(tokens[0], ".subckt") || tokenIs(tokens[0], ".ends") || toupper(*tokens[0].begin) == 'X')
+			error = "subcircuits can not be streamed, flatten the netlist first";
+		else if (*tokens[0].begin == '.') {
+			done = tokenIs(tokens[0], ".end");
+			return true;
+		}
+		else if (readElement(tokens, element, error))
+			return sink(element);
+		cout << "ERROR: " << source << ":" << logicalLine << ": " << error << ".\n";
+		return false;
+	});
+}
+
+bool readNetlist(string path, Circuit* c) {
+	ifstream in(path.c_str(), ios::in | ios::binary);
+	if (!in) {
+		cout << "ERROR: Can not open netlist " << path << ".\n";
+		return false;
+	}
+	ScopedPhase phase(c->getStats(), SolveStats::PARSE);
+	stringstream buffer;
+	buffer << in.rdbuf();
+	return parseNetlist(buffer.str(), c, path);
+}
@@ -0,0 +1,51 @@
+#ifndef NETLIST_H
+#define NETLIST_H
+
+#include <string>
+#include <functional>
+#include "Circuit.h"
+
+using namespace std;
+
+/*
+*	reader for SPICE-like edge-list netlists, one element per line:
+*		R<name> <node1> <node2> <resistance>
+*		V<name> <n+> <n-> [DC] <voltage>		V(n+) - V(n-) = voltage
+*		I<name> <n+> <n-> [DC] <current>		current flows from n+ through the source to n-
+*		S<name> <n+> <n-> <on|off>			an ideal switch, closed or open (1 or 0), see Circuit::setSwitch
+*		C<name> <node1> <node2> <capacitance>	open in the DC solution, see ModelReduction
+*	J is accepted as an alias of I, E (a voltage-controlled source in SPICE) is rejected. node "0" (or "gnd") is the ground.
+*	values take engineering suffixes (f p n u m k meg g t, mil) followed by an optional unit.
+*	lines starting with '*' and anything after ';' or '$' are comments, lines starting with '+'
+*	continue the previous line, ".end" stops reading and other dot directives are ignored.
+*	the first line is always the title, as in SPICE.
+*	subcircuits are defined between ".subckt <name> <port1> ... <portN>" and ".ends" and instantiated with
+*		X<name> <node1> ... <nodeN> <subcircuit>
+*	definitions may instantiate the definitions before them, node "0" inside a definition is the global ground.
+*/
+
+// one element line of a netlist, its nodes and value already in the circuit's conventions
+struct NetlistElement {
+	string name;
+	string posNode, negNode;
+	double value;
+	Element::ElementType type;
+};
+
+// reads the netlist in file "path" into the empty circuit "c"
+bool readNetlist(string path, Circuit* c);
+
+// parses the netlist held in "text" into the empty circuit "c", "source" names it in error messages
+bool parseNetlist(const string& text, Circuit* c, string source);
+
+/*
+*	hands every element of the netlist held in "text" to "sink" as it is read, without building a circuit,
+*	for netlists too large to keep their elements in memory. stops when "sink" returns false.
+*	subcircuits are rejected and repeated element names are not detected.
+*/
+bool scanNetlist(const char* text, size_t size, const function<bool(const NetlistElement&)>& sink, string source);
+
+// parses a number with an optional engineering suffix, "10k" -> 10000, "4.7u" -> 4.7e-6
+bool parseValue(const char* begin, const char* end, double& value);
+
+#endif
@@ -11,6 +11,12 @@ Node::Node(string name, int id){
 	this->id = id;				// a sequential ID number, might be useful when making the equation
 	this->voltage = 0;
 	this->elements = new vector<Element*>(0);
+	this->ports = 0;
+}
+
+// the elements belong to the circuit, only the list is freed
+Node::~Node() {
+	delete elements;
 }
 
 // connects an element to the node
@@ -18,6 +24,11 @@ void Node::addElement(Element* element) {
 	elements->push_back(element);
 }
 
+// connects a port of a subcircuit instance to the node
+void Node::addPort() {
+	ports++;
+}
+
 // getters and setters
 double Node::getVoltage()
 {
@@ -34,6 +45,10 @@ int Node::getNumOfElements()
 {
 	return elements->size();
 }
+int Node::getNumOfPorts()
+{
+	return ports;
+}
 string Node::getName()
 {
 	return this->name;
@@ -17,17 +17,22 @@ private:
 	double voltage;
 	vector<Element*>* elements; // too lazy to implement a linked list
 								// each node is connected to one or more element, an element is a resistor or voltage/current source
+	int ports;			// subcircuit instance ports connected to the node
 
 public:
 	// A constructor, same functionality as "init" functions
 	Node(string name, int id);
+	~Node();
 
 	// connects an element to the node
 	void addElement(Element* element);
+	// connects a port of a subcircuit instance to the node
+	void addPort();
 	// getters and setters
 	double getVoltage();
 	void setVoltage(double voltage);
 	int getNumOfElements();
+	int getNumOfPorts();
 	string getName();
 	bool isGround();
 	void setGround(bool isground);
@@ -0,0 +1,48 @@
+#include "NodeMerge.h"
+#include "Circuit.h"
+#include <numeric>
+
+static int findRoot(vector<int>& parent, int i) {
+	while (parent[i] != i)
+		i = parent[i] = parent[parent[i]];
+	return i;
+}
+
+static void unite(vector<int>& parent, int a, int b) {
+	parent[findRoot(parent, a)] = findRoot(parent, b);
+}
+
+int NodeMerge::slotOf(Node* node) {
+	return node->isGround() ? 0 : node->getId() + 1;
+}
+
+long NodeMerge::merge(Circuit* c, vector<int>& rowOf, Node*& floating) {
+	// the voltage sources and the closed switches merge their nodes, the resistors then connect the merged nodes to the ground
+	int slots = c->nodes->size() + c->voltageSources->size();
+	vector<int> shorted(slots), connected;
+	iota(shorted.begin(), shorted.end(), 0);
+	for (vector<Element*>::iterator it = c->voltageSources->begin(); it != c->voltageSources->end(); it++)
+		if ((*it)->getType() != Element::ElementType::SWITCH || (*it)->isClosed())
+			unite(shorted, slotOf((*it)->getPosNode()), slotOf((*it)->getNegNode()));
+	connected = shorted;
+	for (vector<Element*>::iterator it = c->elements->begin(); it != c->elements->end(); it++)
+		if ((*it)->getType() == Element::ElementType::RESISTOR)
+			unite(connected, slotOf((*it)->getPosNode()), slotOf((*it)->getNegNode()));
+
+	long n = 0;
+	vector<int> rowOfRoot(slots, -2);
+	rowOfRoot[findRoot(shorted, 0)] = -1;
+	rowOf.assign(slots, -1);
+	for (vector<Node*>::iterator it = c->nodes->begin(); it != c->nodes->end(); it++) {
+		int slot = slotOf(*it);
+		if (findRoot(connected, slot) != findRoot(connected, 0)) {
+			floating = *it;
+			return -1;
+		}
+		int& row = rowOfRoot[findRoot(shorted, slot)];
+		if (row == -2)
+			row = n++;
+		rowOf[slot] = row;
+	}
+	return n;
+}
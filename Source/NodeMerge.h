@@ -0,0 +1,32 @@
+#ifndef NODEMERGE_H
+#define NODEMERGE_H
+
+#include <vector>
+
+using namespace std;
+
+class Circuit;
+class Node;
+
+/*
+*	the nodes of a circuit as the resistive engines see them with every source turned off: the voltage sources
+*	and the closed switches short their nodes together into one merged node, numbered from 0, and the ground
+*	and the nodes shorted to it are -1. the tables are indexed by node slot, see slotOf.
+*/
+
+class NodeMerge {
+
+public:
+	// the slot of a node in the tables indexed by id + 1, 0 for the ground
+	static int slotOf(Node* node);
+
+	/*
+	*	merges the nodes of "c" and numbers the merged nodes
+	*	@param rowOf : the number of the merged node of every slot
+	*	@param floating : a node with no resistive path to the ground, when there is one
+	*	@return the number of merged nodes besides the ground, -1 if "floating" was set
+	*/
+	static long merge(Circuit* c, vector<int>& rowOf, Node*& floating);
+};
+
+#endif
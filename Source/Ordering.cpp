@@ -0,0 +1,399 @@
+#include "Ordering.h"
+#include <vector>
+#include <algorithm>
+#include "Eigen/OrderingMethods"
+
+// subgraphs up to this size are not dissected further but ordered by minimum degree
+#define ND_LEAF_SIZE 128
+// breadth first searches spent looking for a pseudo-peripheral start vertex
+#define ND_PERIPHERAL_SEARCHES 4
+
+static const char* typeNames[Ordering::NUM_TYPES] = {
+	"auto", "natural", "amd", "colamd", "nd", "rcm"
+};
+
+// adjacency of the pattern of A + A^T without the diagonal, in compressed form
+struct Graph {
+	vector<int> start;
+	vector<int> adjacent;
+	int size() const { return (int)start.size() - 1; }
+	int degree(int v) const { return start[v + 1] - start[v]; }
+};
+
+// the pattern of A + A^T with a full diagonal. the absolute values can not cancel.
+// Eigen's minimum degree ordering needs the diagonal, without it the voltage source rows
+// (whose diagonal is zero) can leave the factor nearly dense
+static SparseMatrix symmetricPattern(const SparseMatrix& A) {
+	SparseMatrix At = A.transpose();
+	// built from triplets, setIdentity divides by zero on a 1 x 1 matrix
+	vector<Eigen::Triplet<double> > diagonal;
+	for (int i = 0; i < A.cols(); i++)
+		diagonal.push_back(Eigen::Triplet<double>(i, i, 1));
+	SparseMatrix I(A.rows(), A.cols());
+	I.setFromTriplets(diagonal.begin(), diagonal.end());
+	return SparseMatrix(A.cwiseAbs()) + SparseMatrix(At.cwiseAbs()) + I;
+}
+
+static void buildGraph(const SparseMatrix& A, Graph& g) {
+	SparseMatrix S = symmetricPattern(A);
+	int n = (int)S.cols();
+	g.start.assign(n + 1, 0);
+	g.adjacent.clear();
+	g.adjacent.reserve(S.nonZeros());
+	for (int j = 0; j < n; j++) {
+		for (SparseMatrix::InnerIterator it(S, j); it; ++it)
+			if (it.row() != j)
+				g.adjacent.push_back((int)it.row());
+		g.start[j + 1] = (int)g.adjacent.size();
+	}
+}
+
+// orders "vertices" by approximate minimum degree on the subgraph they induce
+static void orderLeaf(const Graph& g, const vector<int>& vertices, vector<int>& local, vector<int>& order) {
+	int m = (int)vertices.size();
+	for (int i = 0; i < m; i++)
+		local[vertices[i]] = i;
+	vector<Eigen::Triplet<double> > triplets;
+	for (int i = 0; i < m; i++) {
+		int v = vertices[i];
+		triplets.push_back(Eigen::Triplet<double>(i, i, 1));
+		for (int k = g.start[v]; k < g.start[v + 1]; k++) {
+			int u = g.adjacent[k];
+			if (local[u] >= 0)
+				triplets.push_back(Eigen::Triplet<double>(local[u], i, 1));
+		}
+	}
+	SparseMatrix sub(m, m);
+	sub.setFromTriplets(triplets.begin(), triplets.end());
+	Ordering::Permutation amd;
+	Eigen::AMDOrdering<int>()(sub, amd);
+	// the minimum degree ordering lists the vertices in elimination order
+	for (int i = 0; i < m; i++)
+		order.push_back(vertices[amd.indices()[i]]);
+	for (int i = 0; i < m; i++)
+		local[vertices[i]] = -1;
+}
+
+// breadth first search from "root" through the vertices labeled "label", returns the number of levels
+static int levelize(const Graph& g, int root, const vector<int>& label, int current, vector<int>& level, vector<int>& queue) {
+	queue.clear();
+	queue.push_back(root);
+	level[root] = 0;
+	int depth = 0;
+	for (size_t head = 0; head < queue.size(); head++) {
+		int v = queue[head];
+		depth = level[v] + 1;
+		for (int k = g.start[v]; k < g.start[v + 1]; k++) {
+			int u = g.adjacent[k];
+			if (label[u] == current && level[u] < 0) {
+				level[u] = level[v] + 1;
+				queue.push_back(u);
+			}
+		}
+	}
+	return depth;
+}
+
+// a pseudo-peripheral vertex of the component of "root" among the vertices labeled "current":
+// the search restarts from the thinnest vertex of the last level while the level structure deepens
+static int peripheralVertex(const Graph& g, int root, const vector<int>& label, int current, vector<int>& level, vector<int>& queue) {
+	queue.clear();
+	int depth = 0;
+	for (int search = 0; search < ND_PERIPHERAL_SEARCHES; search++) {
+		for (size_t i = 0; i < queue.size(); i++)
+			level[queue[i]] = -1;
+		int d = levelize(g, root, label, current, level, queue);
+		if (d <= depth)
+			break;
+		depth = d;
+		// restart from the vertex of least degree in the last level
+		int best = queue.back();
+		for (size_t i = queue.size(); i-- > 0 && level[queue[i]] == depth - 1;)
+			if (g.degree(queue[i]) < g.degree(best))
+				best = queue[i];
+		if (search + 1 < ND_PERIPHERAL_SEARCHES)
+			root = best;
+	}
+	for (size_t i = 0; i < queue.size(); i++)
+		level[queue[i]] = -1;
+	return root;
+}
+
+/*
+*	splits a subgraph in two halves and the separator between them, from the middle level of a level structure
+*	rooted at a pseudo-peripheral vertex. a disconnected subgraph is split into a component and the rest.
+*	@param vertices : the subgraph, all of its vertices carry "label[v] == current"
+*	@return false if one of the halves would be empty
+*/
+static bool bisect(const Graph& g, const vector<int>& vertices, const vector<int>& label, int current, vector<int>& level,
+	vector<int>& first, vector<int>& second, vector<int>& separator) {
+	vector<int> queue;
+	int root = peripheralVertex(g, vertices[0], label, current, level, queue);
+	levelize(g, root, label, current, level, queue);
+
+	if (queue.size() < vertices.size()) {
+		// disconnected: the component reached and the rest are independent, no separator needed
+		for (size_t i = 0; i < queue.size(); i++)
+			first.push_back(queue[i]);
+		for (size_t i = 0; i < vertices.size(); i++)
+			if (level[vertices[i]] < 0)
+				second.push_back(vertices[i]);
+	}
+	else {
+		// the level where half of the vertices have been reached
+		int middle = level[queue[queue.size() / 2]];
+		for (size_t i = 0; i < queue.size(); i++) {
+			int v = queue[i];
+			if (level[v] < middle)
+				first.push_back(v);
+			else if (level[v] > middle)
+				second.push_back(v);
+			else {
+				// a middle vertex without neighbors in the next level does not separate anything
+				bool needed = false;
+				for (int k = g.start[v]; k < g.start[v + 1] && !needed; k++) {
+					int u = g.adjacent[k];
+					needed = label[u] == current && level[u] == middle + 1;
+				}
+				(needed ? separator : first).push_back(v);
+			}
+		}
+	}
+	for (size_t i = 0; i < queue.size(); i++)
+		level[queue[i]] = -1;
+	return !first.empty() && !second.empty();
+}
+
+// gives the halves of a bisection their own labels, the separator belongs to neither
+static void relabel(vector<int>& label, const vector<int>& first, const vector<int>& second, const vector<int>& separator,
+	int firstLabel, int secondLabel) {
+	for (size_t i = 0; i < first.size(); i++)
+		label[first[i]] = firstLabel;
+	for (size_t i = 0; i < second.size(); i++)
+		label[second[i]] = secondLabel;
+	for (size_t i = 0; i < separator.size(); i++)
+		label[separator[i]] = -1;
+}
+
+/*
+*	nested dissection: both halves of a bisection are ordered recursively and the separator is eliminated last.
+*	@param vertices : the subgraph, all of its vertices carry "label[v] == current"
+*	@param order : the elimination order, appended to
+*/
+static void dissect(const Graph& g, vector<int>& vertices, vector<int>& label, int current, int& nextLabel,
+	vector<int>& level, vector<int>& local, vector<int>& order) {
+	vector<int> first, second, separator;
+	if (vertices.size() <= ND_LEAF_SIZE || !bisect(g, vertices, label, current, level, first, second, separator)) {
+		// small enough, or nothing to split (a clique or a path too short to cut): minimum degree
+		orderLeaf(g, vertices, local, order);
+		return;
+	}
+	vector<int>().swap(vertices);
+	int firstLabel = nextLabel++, secondLabel = nextLabel++;
+	relabel(label, first, second, separator, firstLabel, secondLabel);
+	dissect(g, first, label, firstLabel, nextLabel, level, local, order);
+	dissect(g, second, label, secondLabel, nextLabel, level, local, order);
+	order.insert(order.end(), separator.begin(), separator.end());
+}
+
+static void nestedDissection(const SparseMatrix& A, Ordering::Permutation& perm) {
+	Graph g;
+	buildGraph(A, g);
+	int n = g.size();
+	vector<int> vertices(n), label(n, 0), level(n, -1), local(n, -1), order;
+	for (int i = 0; i < n; i++)
+		vertices[i] = i;
+	order.reserve(n);
+	int nextLabel = 1;
+	dissect(g, vertices, label, 0, nextLabel, level, local, order);
+	perm.resize(n);
+	for (int k = 0; k < n; k++)
+		perm.indices()[order[k]] = k;
+}
+
+/*
+*	reverse Cuthill-McKee: every component is numbered breadth first from a pseudo-peripheral vertex, the
+*	neighbors of a vertex thinnest first, so that a vertex and its neighbors get nearby numbers. reversing
+*	the numbering keeps the bandwidth and can only shrink the envelope.
+*/
+static void reverseCuthillMcKee(const SparseMatrix& A, Ordering::Permutation& perm) {
+	Graph g;
+	buildGraph(A, g);
+	int n = g.size();
+	vector<int> label(n, 0), level(n, -1), position(n, -1), queue, order, neighbors;
+	order.reserve(n);
+	for (int start = 0; start < n; start++) {
+		if (position[start] >= 0)
+			continue;
+		int root = peripheralVertex(g, start, label, 0, level, queue);
+		position[root] = (int)order.size();
+		order.push_back(root);
+		for (size_t head = position[root]; head < order.size(); head++) {
+			int v = order[head];
+			neighbors.clear();
+			for (int k = g.start[v]; k < g.start[v + 1]; k++)
+				if (position[g.adjacent[k]] < 0)
+					neighbors.push_back(g.adjacent[k]);
+			stable_sort(neighbors.begin(), neighbors.end(), [&](int a, int b) { return g.degree(a) < g.degree(b); });
+			for (size_t k = 0; k < neighbors.size(); k++) {
+				position[neighbors[k]] = (int)order.size();
+				order.push_back(neighbors[k]);
+			}
+		}
+	}
+	perm.resize(n);
+	for (int k = 0; k < n; k++)
+		perm.indices()[order[k]] = n - 1 - k;
+}
+
+// splits "vertices" into up to 2^"depth" domains, numbered from "nextDomain", separators get -1
+static void split(const Graph& g, vector<int>& vertices, vector<int>& label, int current, int depth, int& nextLabel,
+	vector<int>& level, vector<int>& domain, int& nextDomain) {
+	vector<int> first, second, separator;
+	if (depth == 0 || !bisect(g, vertices, label, current, level, first, second, separator)) {
+		int d = nextDomain++;
+		for (size_t i = 0; i < vertices.size(); i++)
+			domain[vertices[i]] = d;
+		return;
+	}
+	vector<int>().swap(vertices);
+	int firstLabel = nextLabel++, secondLabel = nextLabel++;
+	relabel(label, first, second, separator, firstLabel, secondLabel);
+	for (size_t i = 0; i < separator.size(); i++)
+		domain[separator[i]] = -1;
+	split(g, first, label, firstLabel, depth - 1, nextLabel, level, domain, nextDomain);
+	split(g, second, label, secondLabel, depth - 1, nextLabel, level, domain, nextDomain);
+}
+
+int Ordering::partition(const SparseMatrix& A, int parts, vector<int>& domain) {
+	Graph g;
+	buildGraph(A, g);
+	int n = g.size();
+	int depth = 0;
+	while ((1 << depth) < parts)
+		depth++;
+	vector<int> vertices(n), label(n, 0), level(n, -1);
+	for (int i = 0; i < n; i++)
+		vertices[i] = i;
+	domain.assign(n, -1);
+	if (n == 0)
+		return 0;
+	int nextLabel = 1, nextDomain = 0;
+	split(g, vertices, label, 0, depth, nextLabel, level, domain, nextDomain);
+
+	// an unknown coupled to nothing inside its own domain would leave an empty row in the domain's matrix
+	// (a voltage source between two separator nodes), it joins the separator
+	for (int v = 0; v < n; v++) {
+		if (domain[v] < 0)
+			continue;
+		bool inside = false;
+		for (int k = g.start[v]; k < g.start[v + 1] && !inside; k++)
+			inside = domain[g.adjacent[k]] == domain[v];
+		if (!inside && g.degree(v) > 0)
+			domain[v] = -1;
+	}
+	return nextDomain;
+}
+
+Ordering::Type Ordering::compute(const SparseMatrix& A, Type type, Permutation& perm) {
+	int n = (int)A.rows();
+	switch (type) {
+	case NATURAL:
+		perm.setIdentity(n);
+		return NATURAL;
+	case AMD: {
+		// Eigen lists the unknowns in elimination order, the inverse maps them to their positions
+		Permutation elimination;
+		Eigen::AMDOrdering<int>()(symmetricPattern(A), elimination);
+		perm = elimination.inverse();
+		return AMD;
+	}
+	case COLAMD:
+		Eigen::COLAMDOrdering<int>()(A, perm);
+		return COLAMD;
+	case NESTED_DISSECTION:
+		nestedDissection(A, perm);
+		return NESTED_DISSECTION;
+	case REVERSE_CUTHILL_MCKEE:
+		reverseCuthillMcKee(A, perm);
+		return REVERSE_CUTHILL_MCKEE;
+	default:
+		break;
+	}
+
+	// AUTO: minimum degree wins on small and irregular circuits, dissection on large meshes,
+	// computing both is cheap next to a factorization with the wrong one
+	compute(A, AMD, perm);
+	if (n <= 2 * ND_LEAF_SIZE)
+		return AMD;
+	Permutation nd;
+	compute(A, NESTED_DISSECTION, nd);
+	if (countFactorNonzeros(A, nd) < countFactorNonzeros(A, perm)) {
+		perm = nd;
+		return NESTED_DISSECTION;
+	}
+	return AMD;
+}
+
+long Ordering::countFactorNonzeros(const SparseMatrix& A, const Permutation& perm) {
+	Graph g;
+	buildGraph(A, g);
+	int n = g.size();
+	vector<int> unknown(n), parent(n, -1), ancestor(n, -1), mark(n, -1);
+	for (int i = 0; i < n; i++)
+		unknown[perm.indices()[i]] = i;
+
+	// elimination tree, with path compression through "ancestor"
+	for (int k = 0; k < n; k++) {
+		int v = unknown[k];
+		for (int e = g.start[v]; e < g.start[v + 1]; e++) {
+			int i = perm.indices()[g.adjacent[e]];
+			while (i >= 0 && i < k) {
+				int next = ancestor[i];
+				ancestor[i] = k;
+				if (next < 0)
+					parent[i] = k;
+				i = next;
+			}
+		}
+	}
+
+	// row k of the factor is the subtree of the tree reaching from the entries of row k of A up to k
+	long count = n;
+	for (int k = 0; k < n; k++) {
+		mark[k] = k;
+		int v = unknown[k];
+		for (int e = g.start[v]; e < g.start[v + 1]; e++) {
+			int i = perm.indices()[g.adjacent[e]];
+			for (; i < k && mark[i] != k; i = parent[i]) {
+				mark[i] = k;
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
+int Ordering::bandwidth(const SparseMatrix& A, const Permutation& perm) {
+	int width = 0;
+	for (int j = 0; j < A.outerSize(); j++)
+		for (SparseMatrix::InnerIterator it(A, j); it; ++it)
+			width = max(width, std::abs(perm.indices()[it.row()] - perm.indices()[j]));
+	return width;
+}
+
+bool Ordering::parseType(string name, Type& type) {
+	for (int i = 0; i < NUM_TYPES; i++) {
+		if (name == typeNames[i]) {
+			type = (Type)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* Ordering::getTypeName(Type type) {
+	if (type < 0 || type >= NUM_TYPES)
+		return "?";
+	return typeNames[type];
+}
@@ -0,0 +1,53 @@
+#ifndef ORDERING_H
+#define ORDERING_H
+
+#include <string>
+#include <vector>
+#include "LinearSolver.h"
+
+using namespace std;
+
+/*
+*	fill-reducing orderings of the unknowns for the sparse factorizations.
+*	a permutation P is applied symmetrically, the backends factorize P A P^T, so every node keeps its
+*	equation on the diagonal. the orderings work on the pattern of A + A^T.
+*	reverse Cuthill-McKee does not reduce the fill but the bandwidth, for the banded backend.
+*/
+
+class Ordering {
+
+public: enum Type {
+	AUTO, NATURAL, AMD, COLAMD, NESTED_DISSECTION, REVERSE_CUTHILL_MCKEE, NUM_TYPES
+};
+
+// P maps an unknown i to position P(i), (P A P^T)(P(i), P(j)) = A(i, j)
+typedef Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> Permutation;
+
+public:
+	/*
+	*	computes the ordering "type" of "A" into "perm"
+	*	AUTO computes the candidate orderings and keeps the one whose factor has the fewest nonzeros
+	*	@return the ordering that was computed
+	*/
+	static Type compute(const SparseMatrix& A, Type type, Permutation& perm);
+
+	/*
+	*	splits the unknowns of "A" into about "parts" domains by recursive bisection, so that domains are
+	*	coupled only through the separator unknowns
+	*	@param domain : the domain of every unknown, -1 for the separators
+	*	@return the number of domains
+	*/
+	static int partition(const SparseMatrix& A, int parts, vector<int>& domain);
+
+	// nonzeros of the Cholesky factor of P (A + A^T) P^T, a measure of the fill an ordering leaves
+	static long countFactorNonzeros(const SparseMatrix& A, const Permutation& perm);
+
+	// the largest distance of a nonzero of P A P^T from the diagonal
+	static int bandwidth(const SparseMatrix& A, const Permutation& perm);
+
+	// parses an ordering name as printed by getTypeName
+	static bool parseType(string name, Type& type);
+	static const char* getTypeName(Type type);
+};
+
+#endif
@@ -0,0 +1,699 @@
+#include "OutOfCoreSolver.h"
+#include "Netlist.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// doubles of L per panel, 8 MB, a row longer than that gets a panel of its own
+#define PANEL_ENTRIES (1 << 20)
+// a pivot below this fraction of its diagonal entry leaves the nodal matrix singular
+#define SINGULAR_PIVOT_TOLERANCE 1e-12
+// two paths of voltage sources between the same nodes must agree to this fraction of the voltage
+#define LOOP_VOLTAGE_TOLERANCE 1e-9
+
+enum RecordKind { RESISTOR_RECORD, CURRENT_SOURCE_RECORD };
+
+// the CSR file: magic, unknowns, nonzeros and capacity, then the row starts, the values and the columns
+static const char matrixMagic[8] = { 'C', 'S', 'R', 'M', 'A', 'T', 'R', 'X' };
+#define MATRIX_HEADER 4
+
+OutOfCoreSolver::OutOfCoreSolver(string directory, size_t memoryLimit) {
+	this->directory = directory;
+	this->memoryLimit = memoryLimit;
+	numRecords = 0;
+	m = 0;
+	nonzeros = 0;
+	cachedBytes = 0;
+	panelReads = 0;
+	bytesRead = 0;
+}
+
+OutOfCoreSolver::~OutOfCoreSolver() {
+	matrix.close();
+	if (factors.is_open())
+		factors.close();
+	remove(pathOf("records.bin").c_str());
+	remove(pathOf("matrix.csr").c_str());
+	remove(pathOf("factors.bin").c_str());
+}
+
+string OutOfCoreSolver::pathOf(const char* file) {
+	if (directory.empty())
+		return file;
+	char last = directory[directory.size() - 1];
+	return (last == '/' || last == '\\') ? directory + file : directory + "/" + file;
+}
+
+int OutOfCoreSolver::getNode(const string& name) {
+	unordered_map<string, int>::iterator it = nodeIds.find(name);
+	if (it != nodeIds.end())
+		return it->second;
+	int id = nodeNames.size();
+	nodeIds[name] = id;
+	nodeNames.push_back(name);
+	parent.push_back(id);
+	offset.push_back(0);
+	return id;
+}
+
+int OutOfCoreSolver::findRoot(int i, double& total) {
+	int root = i;
+	total = 0;
+	while (parent[root] != root) {
+		total += offset[root];
+		root = parent[root];
+	}
+	// every node on the path is hung from the root directly
+	double remaining = total;
+	while (parent[i] != root && parent[i] != i) {
+		int next = parent[i];
+		double step = offset[i];
+		parent[i] = root;
+		offset[i] = remaining;
+		remaining -= step;
+		i = next;
+	}
+	return root;
+}
+
+bool OutOfCoreSolver::addSource(int pos, int neg, double voltage, string name) {
+	VoltageSource source;
+	source.pos = pos;
+	source.neg = neg;
+	source.voltage = voltage;
+	double posOffset, negOffset;
+	int posRoot = findRoot(pos, posOffset), negRoot = findRoot(neg, negOffset);
+	source.tree = posRoot != negRoot;
+	if (!source.tree) {
+		// V(pos) - V(neg) is already fixed by other sources
+		double fixed = posOffset - negOffset;
+		if (std::abs(fixed - voltage) > LOOP_VOLTAGE_TOLERANCE * max(1.0, std::abs(voltage))) {
+			cout << "ERROR: Voltage source " << name << " closes a loop of voltage sources that sets " << fixed << " volts across it.\n";
+			return false;
+		}
+	}
+	// the ground stays the root of its group
+	else if (posRoot == 0) {
+		parent[negRoot] = posRoot;
+		offset[negRoot] = posOffset - voltage - negOffset;
+	}
+	else {
+		parent[posRoot] = negRoot;
+		offset[posRoot] = negOffset + voltage - posOffset;
+	}
+	sources.push_back(source);
+	return true;
+}
+
+bool OutOfCoreSolver::read() {
+	MappedFile text;
+	if (!text.openRead(netlistPath)) {
+		cout << "ERROR: Can not open netlist " << netlistPath << ".\n";
+		return false;
+	}
+	BufferedWriter records;
+	if (!records.open(pathOf("records.bin"))) {
+		cout << "ERROR: Can not write to " << directory << ".\n";
+		return false;
+	}
+	getNode("0");
+	bool read = scanNetlist((const char*)text.getData(), text.getSize(), [&](const NetlistElement& element) {
+		if (element.type == Element::ElementType::SWITCH) {
+			cout << "ERROR: Switch " << element.name << " can not be solved out of core.\n";
+			return false;
+		}
+		int pos = getNode(element.posNode), neg = getNode(element.negNode);
+		// open in the DC solution, its nodes are kept for the export
+		if (element.type == Element::ElementType::CAPACITOR)
+			return true;
+		if (element.type == Element::ElementType::VOLTAGE_SOURCE)
+			return addSource(pos, neg, element.value, element.name);
+		Record record;
+		record.kind = element.type == Element::ElementType::RESISTOR ? RESISTOR_RECORD : CURRENT_SOURCE_RECORD;
+		record.a = pos;
+		record.b = neg;
+		record.pad = 0;
+		record.value = element.type == Element::ElementType::RESISTOR ? 1 / element.value : element.value;
+		records.write(&record, sizeof(record));
+		numRecords++;
+		return true;
+	}, netlistPath);
+	if (!records.close()) {
+		cout << "ERROR: Can not write to " << directory << ".\n";
+		return false;
+	}
+	return read;
+}
+
+const long long* OutOfCoreSolver::getRowStarts() {
+	return (const long long*)((char*)matrix.getData() + MATRIX_HEADER * sizeof(uint64_t));
+}
+
+const double* OutOfCoreSolver::getValues() {
+	return (const double*)(getRowStarts() + m + 1);
+}
+
+const int* OutOfCoreSolver::getColumns() {
+	uint64_t capacity = ((const uint64_t*)matrix.getData())[3];
+	return (const int*)(getValues() + capacity);
+}
+
+bool OutOfCoreSolver::assemble() {
+	// every group of nodes tied by voltage sources is one unknown, but the group of the ground
+	vector<int> unknownOfRoot(nodeNames.size(), -1);
+	unknownOf.assign(nodeNames.size(), -1);
+	m = 0;
+	for (size_t i = 0; i < nodeNames.size(); i++) {
+		double total;
+		int root = findRoot(i, total);
+		if (root == 0)
+			continue;
+		if (unknownOfRoot[root] < 0)
+			unknownOfRoot[root] = m++;
+		unknownOf[i] = unknownOfRoot[root];
+	}
+	if (m == 0)
+		return true;
+
+	MappedFile recordFile;
+	const Record* records = NULL;
+	if (numRecords > 0) {
+		if (!recordFile.openRead(pathOf("records.bin"))) {
+			cout << "ERROR: Can not read back " << pathOf("records.bin") << ".\n";
+			return false;
+		}
+		records = (const Record*)recordFile.getData();
+	}
+
+	// counting the entries of every row first sizes the file, the diagonal is one of them
+	vector<long long> next(m + 1, 1);
+	for (long r = 0; r < numRecords; r++) {
+		int a = unknownOf[records[r].a], b = unknownOf[records[r].b];
+		if (records[r].kind == RESISTOR_RECORD && a >= 0 && b >= 0 && a != b) {
+			next[a]++;
+			next[b]++;
+		}
+	}
+	long long capacity = 0;
+	for (long i = 0; i < m; i++) {
+		long long count = next[i];
+		next[i] = capacity;
+		capacity += count;
+	}
+	next[m] = capacity;
+	size_t bytes = MATRIX_HEADER * sizeof(uint64_t) + (m + 1) * sizeof(long long) + capacity * (sizeof(double) + sizeof(int));
+	if (!matrix.create(pathOf("matrix.csr"), bytes)) {
+		cout << "ERROR: Can not create " << pathOf("matrix.csr") << ".\n";
+		return false;
+	}
+	uint64_t* header = (uint64_t*)matrix.getData();
+	memcpy(header, matrixMagic, sizeof(matrixMagic));
+	header[1] = m;
+	header[2] = 0;
+	header[3] = capacity;
+	long long* rowStarts = (long long*)getRowStarts();
+	double* values = (double*)getValues();
+	int* columns = (int*)getColumns();
+	memcpy(rowStarts, next.data(), (m + 1) * sizeof(long long));
+
+	// a conductance g between a = u_a + offset_a and b = u_b + offset_b adds g (u_a - u_b) + g (offset_a - offset_b)
+	// to the current leaving a, the voltage of a node in the group of the ground is its offset
+	vector<double> diagonal(m, 0);
+	rhs.assign(m, 0);
+	for (long r = 0; r < numRecords; r++) {
+		const Record& record = records[r];
+		int a = unknownOf[record.a], b = unknownOf[record.b];
+		if (record.kind == CURRENT_SOURCE_RECORD) {
+			if (a >= 0)
+				rhs[a] += record.value;
+			if (b >= 0)
+				rhs[b] -= record.value;
+			continue;
+		}
+		if (a == b && a >= 0)
+			continue;
+		double g = record.value, across = offset[record.a] - offset[record.b];
+		if (a >= 0) {
+			diagonal[a] += g;
+			rhs[a] -= g * across;
+		}
+		if (b >= 0) {
+			diagonal[b] += g;
+			rhs[b] += g * across;
+		}
+		if (a >= 0 && b >= 0) {
+			values[next[a]] = -g;
+			columns[next[a]++] = b;
+			values[next[b]] = -g;
+			columns[next[b]++] = a;
+		}
+	}
+	for (long i = 0; i < m; i++) {
+		values[next[i]] = diagonal[i];
+		columns[next[i]] = i;
+	}
+
+	// parallel resistors are merged and the rows sorted, each row moves down over the space the merging freed
+	long long used = 0;
+	vector<pair<int, double> > row;
+	for (long i = 0; i < m; i++) {
+		row.clear();
+		for (long long e = rowStarts[i]; e < rowStarts[i + 1]; e++)
+			row.push_back(make_pair(columns[e], values[e]));
+		sort(row.begin(), row.end(), [](const pair<int, double>& x, const pair<int, double>& y) { return x.first < y.first; });
+		rowStarts[i] = used;
+		for (size_t k = 0; k < row.size(); k++) {
+			if (k > 0 && row[k].first == row[k - 1].first)
+				values[used - 1] += row[k].second;
+			else {
+				columns[used] = row[k].first;
+				values[used++] = row[k].second;
+			}
+		}
+	}
+	rowStarts[m] = used;
+	header[2] = used;
+	nonzeros = used;
+	return true;
+}
+
+void OutOfCoreSolver::order() {
+	const long long* rowStarts = getRowStarts();
+	const int* columns = getColumns();
+	vector<int> degree(m), depth(m, -1), queue;
+	for (long i = 0; i < m; i++)
+		degree[i] = rowStarts[i + 1] - rowStarts[i] - 1;
+	perm.clear();
+	perm.reserve(m);
+	inv.assign(m, -1);
+	vector<int> neighbors;
+
+	for (long start = 0; start < m; start++) {
+		if (inv[start] >= 0)
+			continue;
+		// a pseudo-peripheral root: restart from the thinnest node of the last level while the levels deepen
+		int root = start, height = -1;
+		while (true) {
+			queue.assign(1, root);
+			depth[root] = 0;
+			for (size_t h = 0; h < queue.size(); h++) {
+				int u = queue[h];
+				for (long long e = rowStarts[u]; e < rowStarts[u + 1]; e++) {
+					int v = columns[e];
+					if (depth[v] < 0) {
+						depth[v] = depth[u] + 1;
+						queue.push_back(v);
+					}
+				}
+			}
+			int last = depth[queue.back()], candidate = queue.back();
+			for (size_t h = queue.size(); h-- > 0 && depth[queue[h]] == last; )
+				if (degree[queue[h]] < degree[candidate])
+					candidate = queue[h];
+			for (size_t h = 0; h < queue.size(); h++)
+				depth[queue[h]] = -1;
+			if (last <= height)
+				break;
+			height = last;
+			root = candidate;
+		}
+
+		// Cuthill-McKee from the root, the neighbors of every node taken thinnest first
+		size_t head = perm.size();
+		inv[root] = perm.size();
+		perm.push_back(root);
+		for (; head < perm.size(); head++) {
+			int u = perm[head];
+			neighbors.clear();
+			for (long long e = rowStarts[u]; e < rowStarts[u + 1]; e++)
+				if (inv[columns[e]] < 0)
+					neighbors.push_back(columns[e]);
+			sort(neighbors.begin(), neighbors.end(), [&](int x, int y) { return degree[x] < degree[y]; });
+			for (size_t k = 0; k < neighbors.size(); k++) {
+				inv[neighbors[k]] = perm.size();
+				perm.push_back(neighbors[k]);
+			}
+		}
+	}
+	// reversed, the envelope can only shrink
+	reverse(perm.begin(), perm.end());
+	for (long i = 0; i < m; i++)
+		inv[perm[i]] = i;
+}
+
+bool OutOfCoreSolver::writePanel(Panel& panel) {
+	factors.seekp(panel.firstEntry * sizeof(double));
+	factors.write((const char*)panel.data.data(), panel.entries * sizeof(double));
+	if (!factors) {
+		cout << "ERROR: Can not write the factors to " << pathOf("factors.bin") << ".\n";
+		return false;
+	}
+	return true;
+}
+
+void OutOfCoreSolver::evict(size_t incoming) {
+	// every cached panel is in the file, the cache may empty completely
+	while (!lru.empty() && cachedBytes + incoming > memoryLimit) {
+		Panel& victim = panels[lru.back()];
+		cachedBytes -= victim.data.size() * sizeof(double);
+		vector<double>().swap(victim.data);
+		victim.resident = false;
+		lru.pop_back();
+	}
+}
+
+const double* OutOfCoreSolver::loadPanel(int p) {
+	Panel& panel = panels[p];
+	if (panel.resident) {
+		if (panel.used != lru.end() && panel.used != lru.begin())
+			lru.splice(lru.begin(), lru, panel.used);
+		return panel.data.data();
+	}
+	size_t bytes = panel.entries * sizeof(double);
+	evict(bytes);
+	panel.data.resize(panel.entries);
+	factors.seekg(panel.firstEntry * sizeof(double));
+	factors.read((char*)panel.data.data(), bytes);
+	if (!factors)
+		return NULL;
+	panelReads++;
+	bytesRead += bytes;
+	panel.resident = true;
+	lru.push_front(p);
+	panel.used = lru.begin();
+	cachedBytes += bytes;
+	return panel.data.data();
+}
+
+const double* OutOfCoreSolver::getRow(long i) {
+	int p = panelOf[i];
+	const double* data = loadPanel(p);
+	return data == NULL ? NULL : data + (rowStart[i] - panels[p].firstEntry);
+}
+
+bool OutOfCoreSolver::factorize() {
+	const long long* rowStarts = getRowStarts();
+	const int* columns = getColumns();
+	const double* values = getValues();
+	factors.open(pathOf("factors.bin").c_str(), ios::in | ios::out | ios::binary | ios::trunc);
+	if (!factors.is_open()) {
+		cout << "ERROR: Can not create " << pathOf("factors.bin") << ".\n";
+		return false;
+	}
+	first.resize(m);
+	rowStart.resize(m + 1);
+	d.resize(m);
+	panelOf.resize(m);
+	panels.clear();
+	lru.clear();
+	cachedBytes = 0;
+	// the last panel is the one being filled, it stays in memory and out of the cache until it is full
+	panels.push_back(Panel());
+	panels.back().firstRow = 0;
+	panels.back().firstEntry = 0;
+	panels.back().entries = 0;
+	panels.back().resident = true;
+	panels.back().used = lru.end();
+	panels.back().data.reserve(PANEL_ENTRIES);
+	vector<double> row;
+	long long entries = 0;
+
+	for (long i = 0; i < m; i++) {
+		long old = perm[i];
+		int f = i;
+		for (long long e = rowStarts[old]; e < rowStarts[old + 1]; e++)
+			f = min(f, inv[columns[e]]);
+		long width = i - f;
+		row.assign(width + 1, 0);
+		for (long long e = rowStarts[old]; e < rowStarts[old + 1]; e++) {
+			int j = inv[columns[e]];
+			if (j <= i)
+				row[j - f] += values[e];
+		}
+
+		// with g_j = l_ij d_j: g_j = a_ij - sum over k < j of g_k l_jk, then d_i = a_ii - sum of g_j l_ij
+		double* g = row.data();
+		for (long j = f; j < i; j++) {
+			const double* lj = getRow(j);
+			if (lj == NULL) {
+				cout << "ERROR: Can not read the factors back from " << pathOf("factors.bin") << ".\n";
+				return false;
+			}
+			int lo = max(f, first[j]);
+			double s = g[j - f];
+			for (long k = lo; k < j; k++)
+				s -= g[k - f] * lj[k - first[j]];
+			g[j - f] = s;
+		}
+		double diagonal = g[width], pivot = diagonal;
+		for (long j = f; j < i; j++) {
+			double l = g[j - f] / d[j];
+			pivot -= g[j - f] * l;
+			g[j - f] = l;
+		}
+		if (!(pivot > SINGULAR_PIVOT_TOLERANCE * diagonal)) {
+			for (size_t n = 0; n < unknownOf.size(); n++) {
+				if (unknownOf[n] == old) {
+					cout << "ERROR: Node [" << nodeNames[n] << "] has no resistive path to the ground or to a voltage source.\n";
+					break;
+				}
+			}
+			return false;
+		}
+		d[i] = pivot;
+		first[i] = f;
+
+		Panel* open = &panels.back();
+		if (open->data.size() > 0 && open->data.size() + width > PANEL_ENTRIES) {
+			// the full panel goes to the file and joins the cache as its most recent member
+			open->entries = open->data.size();
+			if (!writePanel(*open))
+				return false;
+			lru.push_front(panels.size() - 1);
+			open->used = lru.begin();
+			cachedBytes += open->entries * sizeof(double);
+			Panel next;
+			next.firstRow = i;
+			next.firstEntry = entries;
+			next.entries = 0;
+			next.resident = true;
+			next.used = lru.end();
+			next.data.reserve(PANEL_ENTRIES);
+			panels.push_back(next);
+			open = &panels.back();
+			evict(0);
+		}
+		rowStart[i] = entries;
+		panelOf[i] = panels.size() - 1;
+		open->data.insert(open->data.end(), row.begin(), row.begin() + width);
+		entries += width;
+	}
+	rowStart[m] = entries;
+
+	// the last panel is written and cached like the others
+	Panel& last = panels.back();
+	last.entries = last.data.size();
+	if (!writePanel(last))
+		return false;
+	lru.push_front(panels.size() - 1);
+	last.used = lru.begin();
+	cachedBytes += last.entries * sizeof(double);
+	evict(0);
+	factors.flush();
+	return true;
+}
+
+bool OutOfCoreSolver::substitute() {
+	vector<double> y(m);
+	for (long i = 0; i < m; i++)
+		y[i] = rhs[perm[i]];
+	// L z = b and D w = z, the panels in file order
+	for (long i = 0; i < m; i++) {
+		const double* li = getRow(i);
+		if (li == NULL)
+			return false;
+		double s = y[i];
+		for (long j = first[i]; j < i; j++)
+			s -= li[j - first[i]] * y[j];
+		y[i] = s;
+	}
+	for (long i = 0; i < m; i++)
+		y[i] /= d[i];
+	// L^T x = w by the rows of L, the panels in reverse
+	for (long i = m; i-- > 0; ) {
+		const double* li = getRow(i);
+		if (li == NULL)
+			return false;
+		double xi = y[i];
+		for (long j = first[i]; j < i; j++)
+			y[j] -= li[j - first[i]] * xi;
+	}
+
+	voltages.resize(nodeNames.size());
+	bool finite = true;
+	for (size_t n = 0; n < nodeNames.size(); n++) {
+		voltages[n] = offset[n] + (unknownOf[n] >= 0 ? y[inv[unknownOf[n]]] : 0);
+		finite = finite && std::isfinite(voltages[n]);
+	}
+	return finite;
+}
+
+void OutOfCoreSolver::computeSourceCurrents() {
+	sourceCurrents.assign(sources.size(), 0);
+	if (sources.empty())
+		return;
+	// the current every node needs from its voltage sources to satisfy KCL
+	vector<double> need(nodeNames.size(), 0);
+	MappedFile recordFile;
+	if (numRecords > 0 && recordFile.openRead(pathOf("records.bin"))) {
+		const Record* records = (const Record*)recordFile.getData();
+		for (long r = 0; r < numRecords; r++) {
+			double i = records[r].value;
+			if (records[r].kind == RESISTOR_RECORD)
+				i *= voltages[records[r].a] - voltages[records[r].b];
+			else
+				i = -i;
+			need[records[r].a] += i;
+			need[records[r].b] -= i;
+		}
+	}
+
+	// the sources that merged groups form a forest, each one carries what the nodes beyond it need
+	vector<int> start(nodeNames.size() + 1, 0), adjacent;
+	for (size_t k = 0; k < sources.size(); k++) {
+		if (sources[k].tree) {
+			start[sources[k].pos + 1]++;
+			start[sources[k].neg + 1]++;
+		}
+	}
+	for (size_t n = 0; n < nodeNames.size(); n++)
+		start[n + 1] += start[n];
+	adjacent.resize(start.back());
+	vector<int> fill(start.begin(), start.end() - 1);
+	for (size_t k = 0; k < sources.size(); k++) {
+		if (sources[k].tree) {
+			adjacent[fill[sources[k].pos]++] = k;
+			adjacent[fill[sources[k].neg]++] = k;
+		}
+	}
+	vector<int> via(nodeNames.size(), -2), queue;
+	for (size_t root = 0; root < nodeNames.size(); root++) {
+		if (via[root] != -2 || start[root] == start[root + 1])
+			continue;
+		// the ground is visited first, so it is the root of its tree
+		size_t head = queue.size();
+		via[root] = -1;
+		queue.push_back(root);
+		for (; head < queue.size(); head++) {
+			int u = queue[head];
+			for (int e = start[u]; e < start[u + 1]; e++) {
+				const VoltageSource& s = sources[adjacent[e]];
+				int v = s.pos == u ? s.neg : s.pos;
+				if (via[v] == -2) {
+					via[v] = adjacent[e];
+					queue.push_back(v);
+				}
+			}
+		}
+	}
+	for (size_t h = queue.size(); h-- > 0; ) {
+		int u = queue[h];
+		if (via[u] < 0)
+			continue;
+		const VoltageSource& s = sources[via[u]];
+		sourceCurrents[via[u]] = s.pos == u ? need[u] : -need[u];
+		need[s.pos == u ? s.neg : s.pos] += need[u];
+	}
+}
+
+bool OutOfCoreSolver::solve(string path) {
+	netlistPath = path;
+	if (!read() || !assemble())
+		return false;
+	if (m > 0) {
+		order();
+		if (!factorize())
+			return false;
+	}
+	voltages.clear();
+	if (!substitute()) {
+		cout << "ERROR: The out of core solution is not finite.\n";
+		return false;
+	}
+	computeSourceCurrents();
+	return true;
+}
+
+bool OutOfCoreSolver::exportResults(ResultExporter* exporter) {
+	if (exporter == NULL || !exporter->isOpen() || voltages.size() != nodeNames.size())
+		return false;
+	for (size_t n = 0; n < nodeNames.size(); n++)
+		exporter->writeNode(nodeNames[n], voltages[n]);
+	MappedFile text;
+	if (!text.openRead(netlistPath)) {
+		cout << "ERROR: Can not open netlist " << netlistPath << ".\n";
+		return false;
+	}
+	size_t source = 0;
+	return scanNetlist((const char*)text.getData(), text.getSize(), [&](const NetlistElement& element) {
+		double voltage = voltages[nodeIds[element.posNode]] - voltages[nodeIds[element.negNode]];
+		double current;
+		char type;
+		switch (element.type) {
+		case Element::ElementType::RESISTOR:
+			type = 'R';
+			current = -voltage / element.value;
+			break;
+		case Element::ElementType::CURRENT_SOURCE:
+			type = 'J';
+			current = element.value;
+			break;
+		case Element::ElementType::CAPACITOR:
+			type = 'C';
+			current = 0;
+			break;
+		default:
+			type = 'E';
+			voltage = element.value;
+			current = sourceCurrents[source++];
+			break;
+		}
+		exporter->writeElement(element.name, type, voltage, current, -current * voltage);
+		return true;
+	}, netlistPath);
+}
+
+long OutOfCoreSolver::getNumNodes() {
+	return nodeNames.size();
+}
+
+long OutOfCoreSolver::getNumUnknowns() {
+	return m;
+}
+
+long long OutOfCoreSolver::getMatrixNonzeros() {
+	return nonzeros;
+}
+
+long long OutOfCoreSolver::getFactorEntries() {
+	return m == 0 ? 0 : rowStart[m];
+}
+
+long OutOfCoreSolver::getNumPanels() {
+	return m == 0 ? 0 : panels.size();
+}
+
+long OutOfCoreSolver::getPanelReads() {
+	return panelReads;
+}
+
+long long OutOfCoreSolver::getBytesRead() {
+	return bytesRead;
+}
+
+void OutOfCoreSolver::print(ostream& out) {
+	out << getNumNodes() << " nodes, " << m << " unknowns, " << nonzeros << " nonzeros.\n";
+	out << "Factors: " << getFactorEntries() << " entries in " << getNumPanels() << " panels, "
+		<< panelReads << " panels read back (" << bytesRead / (1 << 20) << " MB).\n";
+}
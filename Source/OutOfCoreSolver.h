@@ -0,0 +1,145 @@
+#ifndef OUTOFCORESOLVER_H
+#define OUTOFCORESOLVER_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <iostream>
+#include <fstream>
+#include <unordered_map>
+#include <stdint.h>
+#include "MappedFile.h"
+#include "ResultExport.h"
+
+using namespace std;
+
+/*
+*	solves a netlist whose system does not fit in memory, without building a Circuit (its node and element
+*	objects would not fit either). only vectors of one value per node are kept in memory:
+*		1.	the netlist is mapped and streamed element by element, the resistors and current sources go
+*			to a record file and the voltage sources merge their nodes (a union-find that keeps the voltage
+*			of every node above the root of its group). the group of the ground is known, every other group
+*			is one unknown of the nodal system, which is then symmetric positive definite.
+*		2.	the nodal matrix is assembled from the records into a memory-mapped CSR file.
+*		3.	the unknowns are ordered by reverse Cuthill-McKee, which keeps the nonzeros of L D L^T within
+*			a narrow envelope, and the envelope is factorized row by row. the rows of L are written to a
+*			factor file in panels of consecutive rows, the panels a row needs are read back through a cache
+*			that evicts the least recently used one when it outgrows the memory limit.
+*		4.	the forward substitution reads the panels first to last and the backward one last to first.
+*	the voltage sources get their currents from the currents the rest of the circuit draws from their
+*	nodes, a source closing a loop of sources gets none.
+*	the working files live in a directory given by the caller and are removed by the destructor.
+*/
+
+class OutOfCoreSolver {
+
+private:
+	// a resistor (conductance) or a current source (injected at a, drawn from b) of the record file
+	struct Record {
+		int32_t kind;
+		int32_t a, b;
+		int32_t pad;
+		double value;
+	};
+
+	struct VoltageSource {
+		int pos, neg;
+		double voltage;
+		bool tree;		// merged two groups, false when it closes a loop of sources
+	};
+
+	// consecutive rows of L, resident when "data" holds them
+	struct Panel {
+		long firstRow;
+		long long firstEntry;
+		long long entries;
+		vector<double> data;
+		bool resident;
+		list<int>::iterator used;
+	};
+
+	string directory;
+	string netlistPath;
+	size_t memoryLimit;
+
+	// nodes by name, node 0 is the ground
+	unordered_map<string, int> nodeIds;
+	vector<string> nodeNames;
+	vector<VoltageSource> sources;
+	// the union-find of the voltage sources, V(i) = V(parent[i]) + offset[i]
+	vector<int> parent;
+	vector<double> offset;
+	// the unknown of every node's group, -1 in the group of the ground
+	vector<int> unknownOf;
+	long numRecords;
+
+	// the system, its ordering (perm[new] = old, inv[old] = new) and its solution by node
+	long m;
+	long long nonzeros;
+	MappedFile matrix;
+	vector<double> rhs;
+	vector<int> perm, inv;
+	vector<double> voltages, sourceCurrents;
+
+	// L D L^T, row i of L spans the columns first[i] to i - 1 and starts at entry rowStart[i]
+	vector<int> first;
+	vector<long long> rowStart;
+	vector<double> d;
+	vector<Panel> panels;
+	vector<int> panelOf;
+	list<int> lru;
+	size_t cachedBytes;
+	fstream factors;
+	long panelReads;
+	long long bytesRead;
+
+	int getNode(const string& name);
+	// the root of node i's group, "total" receives V(i) - V(root)
+	int findRoot(int i, double& total);
+	bool addSource(int pos, int neg, double voltage, string name);
+
+	bool read();
+	bool assemble();
+	void order();
+	bool factorize();
+	bool substitute();
+	void computeSourceCurrents();
+
+	// the rows of the CSR file
+	const long long* getRowStarts();
+	const int* getColumns();
+	const double* getValues();
+
+	// drops the least recently used panels until "incoming" more bytes fit in the memory limit, all of them if need be
+	void evict(size_t incoming);
+	// makes panel p resident, evicting the least recently used ones beyond the memory limit
+	const double* loadPanel(int p);
+	bool writePanel(Panel& panel);
+	const double* getRow(long i);
+
+	string pathOf(const char* file);
+
+public:
+	// "directory" holds the working files, "memoryLimit" bounds the bytes of cached factor panels
+	OutOfCoreSolver(string directory, size_t memoryLimit);
+	~OutOfCoreSolver();
+
+	// reads, factorizes and solves the netlist in file "path"
+	bool solve(string path);
+
+	// writes the node voltages, then streams the netlist again to write every element
+	bool exportResults(ResultExporter* exporter);
+
+	long getNumNodes();
+	long getNumUnknowns();
+	long long getMatrixNonzeros();
+	long long getFactorEntries();
+	long getNumPanels();
+	// panels read back from the factor file, and their bytes
+	long getPanelReads();
+	long long getBytesRead();
+
+	void print(ostream& out);
+};
+
+#endif
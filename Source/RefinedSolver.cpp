@@ -0,0 +1,288 @@
+#include "RefinedSolver.h"
+#include <cfloat>
+#include <cmath>
+
+#define MAX_SCALING_SWEEPS 8
+#define MAX_REFINEMENT_STEPS 10
+#define HAGER_ITERATIONS 5
+
+// nearest power of two to 1 / sqrt(norm), so that scaling never rounds
+static double scaleFactor(double norm) {
+	if (norm == 0 || !std::isfinite(norm))
+		return 1;
+	return std::ldexp(1.0, (int)-std::lround(std::log2(norm) / 2));
+}
+
+RefinedSolver::RefinedSolver(LinearSolver* inner, SolveStats* stats) {
+	this->inner = inner;
+	this->stats = stats;
+	Type t = inner->getType();
+	// the iterative backends would only repeat their iteration on the residual
+	refine = t != CONJUGATE_GRADIENT && t != BICGSTAB && t != ALGEBRAIC_MULTIGRID;
+	normA = 0;
+	backwardError = -1;
+	conditionEstimate = -1;
+	refinementSteps = 0;
+}
+
+RefinedSolver::~RefinedSolver() {
+	delete inner;
+}
+
+void RefinedSolver::setOrdering(const Ordering::Permutation& perm) {
+	this->perm = perm;
+}
+
+bool RefinedSolver::factorize(const SparseMatrix& A) {
+	return factorize(A, false);
+}
+
+bool RefinedSolver::refactorize(const SparseMatrix& A) {
+	// the pattern is only trusted to be the same while its size is
+	return factorize(A, A.rows() == this->A.rows() && A.nonZeros() == this->A.nonZeros());
+}
+
+bool RefinedSolver::factorize(const SparseMatrix& A, bool reuse) {
+	this->A = A;
+	long n = A.rows();
+	rowScale = Eigen::VectorXd::Ones(n);
+	colScale = Eigen::VectorXd::Ones(n);
+
+	// Ruiz equilibration: repeatedly divide every row and column by the square root of its largest entry
+	SparseMatrix S = A;
+	Eigen::VectorXd rowMax(n), colMax(n);
+	for (int sweep = 0; sweep < MAX_SCALING_SWEEPS; sweep++) {
+		rowMax.setZero();
+		colMax.setZero();
+		for (int j = 0; j < S.outerSize(); j++) {
+			for (SparseMatrix::InnerIterator it(S, j); it; ++it) {
+				double v = std::fabs(it.value());
+				if (v > rowMax[it.row()]) rowMax[it.row()] = v;
+				if (v > colMax[j]) colMax[j] = v;
+			}
+		}
+		bool changed = false;
+		for (long i = 0; i < n; i++) {
+			rowMax[i] = scaleFactor(rowMax[i]);
+			colMax[i] = scaleFactor(colMax[i]);
+			changed = changed || rowMax[i] != 1 || colMax[i] != 1;
+		}
+		if (!changed)
+			break;
+		rowScale = rowScale.cwiseProduct(rowMax);
+		colScale = colScale.cwiseProduct(colMax);
+		S = rowMax.asDiagonal() * S * colMax.asDiagonal();
+	}
+
+	normA = 0;
+	Eigen::VectorXd rowSum = Eigen::VectorXd::Zero(n);
+	for (int j = 0; j < A.outerSize(); j++)
+		for (SparseMatrix::InnerIterator it(A, j); it; ++it)
+			rowSum[it.row()] += std::fabs(it.value());
+	if (n > 0)
+		normA = rowSum.maxCoeff();
+
+	if (perm.size() == n)
+		S = S.twistedBy(perm);
+	if (!(reuse ? inner->refactorize(S) : inner->factorize(S)))
+		return false;
+	conditionEstimate = -1;
+	if (refine) {
+		// ||A||_1 ||A^-1||_1
+		double norm1 = 0;
+		for (int j = 0; j < A.outerSize(); j++) {
+			double colSum = 0;
+			for (SparseMatrix::InnerIterator it(A, j); it; ++it)
+				colSum += std::fabs(it.value());
+			if (colSum > norm1) norm1 = colSum;
+		}
+		conditionEstimate = norm1 * estimateInverseNorm();
+	}
+	return true;
+}
+
+// A^-1 b = Dc P^T (P Dr A Dc P^T)^-1 P Dr b
+bool RefinedSolver::solveScaled(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+	Eigen::VectorXd y, c = rowScale.cwiseProduct(b);
+	if (perm.size() == c.size())
+		c = perm * c;
+	if (!inner->solve(c, y))
+		return false;
+	if (perm.size() == y.size())
+		y = perm.transpose() * y;
+	x = colScale.cwiseProduct(y);
+	return true;
+}
+
+// A^-T b = Dr P^T (P Dr A Dc P^T)^-T P Dc b
+bool RefinedSolver::solveScaledTransposed(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+	Eigen::VectorXd y, c = colScale.cwiseProduct(b);
+	if (perm.size() == c.size())
+		c = perm * c;
+	if (!inner->solveTransposed(c, y))
+		return false;
+	if (perm.size() == y.size())
+		y = perm.transpose() * y;
+	x = rowScale.cwiseProduct(y);
+	return true;
+}
+
+double RefinedSolver::computeBackwardError(const Eigen::VectorXd& b, const Eigen::VectorXd& x, Eigen::VectorXd& r) {
+	r = b - A * x;
+	double denominator = normA * x.lpNorm<Eigen::Infinity>() + b.lpNorm<Eigen::Infinity>();
+	double numerator = r.lpNorm<Eigen::Infinity>();
+	if (!std::isfinite(numerator) || !std::isfinite(denominator))
+		return DBL_MAX;
+	if (denominator == 0)
+		return numerator == 0 ? 0 : DBL_MAX;
+	return numerator / denominator;
+}
+
+// refines "x" against the unscaled system, returns its backward error and adds the steps taken to "steps"
+double RefinedSolver::refineSolution(const Eigen::VectorXd& b, Eigen::VectorXd& x, int& steps) {
+	ScopedPhase phase(stats, SolveStats::REFINE);
+	Eigen::VectorXd r, dx, best = x;
+	double error = computeBackwardError(b, x, r);
+	double bestError = error;
+	int taken = 0;
+	while (refine && taken < MAX_REFINEMENT_STEPS && error > DBL_EPSILON) {
+		if (!solveScaled(r, dx))
+			break;
+		x += dx;
+		taken++;
+		error = computeBackwardError(b, x, r);
+		if (error < bestError) {
+			// keep going only while each step at least halves the error
+			bool stalled = error > bestError / 2;
+			bestError = error;
+			best = x;
+			if (stalled)
+				break;
+		}
+		else
+			break;
+	}
+	x = best;
+	steps += taken;
+	return bestError;
+}
+
+bool RefinedSolver::solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+	refinementSteps = 0;
+	backwardError = DBL_MAX;
+	{
+		ScopedPhase phase(stats, SolveStats::SOLVE);
+		if (!solveScaled(b, x))
+			return false;
+	}
+	backwardError = refineSolution(b, x, refinementSteps);
+	return backwardError != DBL_MAX;
+}
+
+/*
+*	all the columns go through the backend in one blocked solve, then each one is refined on its own.
+*	the backward error is the worst of the columns, the refinement steps are added up.
+*/
+bool RefinedSolver::solveMany(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) {
+	refinementSteps = 0;
+	backwardError = DBL_MAX;
+	{
+		ScopedPhase phase(stats, SolveStats::SOLVE);
+		Eigen::MatrixXd Y, C = rowScale.asDiagonal() * B;
+		if (perm.size() == C.rows())
+			C = perm * C;
+		if (!inner->solveMany(C, Y))
+			return false;
+		if (perm.size() == Y.rows())
+			Y = perm.transpose() * Y;
+		X = colScale.asDiagonal() * Y;
+	}
+	double worst = 0;
+	Eigen::VectorXd b, x;
+	for (long j = 0; j < B.cols(); j++) {
+		b = B.col(j);
+		x = X.col(j);
+		worst = std::max(worst, refineSolution(b, x, refinementSteps));
+		X.col(j) = x;
+	}
+	backwardError = worst;
+	return worst != DBL_MAX;
+}
+
+bool RefinedSolver::solveTransposed(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+	return solveScaledTransposed(b, x);
+}
+
+/*
+*	Hager's estimate of ||A^-1||_1 as refined by Higham (the LAPACK xLACON scheme), which needs
+*	solves with A and A^T. without transposed solves only A^-1 is probed with two vectors,
+*	which gives a lower bound.
+*/
+double RefinedSolver::estimateInverseNorm() {
+	long n = A.rows();
+	if (n == 0)
+		return 0;
+	Eigen::VectorXd x = Eigen::VectorXd::Constant(n, 1.0 / n), y, z, xi;
+	double estimate = 0;
+
+	// alternating vector that catches cancellations the other probes miss
+	Eigen::VectorXd alt(n);
+	for (long i = 0; i < n; i++)
+		alt[i] = (i % 2 == 0 ? 1 : -1) * (1 + (n > 1 ? (double)i / (n - 1) : 0));
+	if (solveScaled(alt, y))
+		estimate = 2 * y.lpNorm<1>() / (3.0 * n);
+
+	Eigen::VectorXd probe;
+	if (!solveScaledTransposed(x, probe)) {
+		if (solveScaled(x, y))
+			estimate = std::max(estimate, y.lpNorm<1>());
+		return estimate;
+	}
+
+	long last = -1;
+	for (int k = 0; k < HAGER_ITERATIONS; k++) {
+		if (!solveScaled(x, y))
+			break;
+		estimate = std::max(estimate, y.lpNorm<1>());
+		xi = y.unaryExpr([](double v) { return v >= 0 ? 1.0 : -1.0; });
+		if (!solveScaledTransposed(xi, z))
+			break;
+		long j;
+		z.cwiseAbs().maxCoeff(&j);
+		if (z.lpNorm<Eigen::Infinity>() <= z.dot(x) || j == last)
+			break;
+		x.setZero();
+		x[j] = 1;
+		last = j;
+	}
+	return estimate;
+}
+
+LinearSolver::Type RefinedSolver::getType() {
+	return inner->getType();
+}
+
+long RefinedSolver::getFactorNonzeros() {
+	return inner->getFactorNonzeros();
+}
+
+double RefinedSolver::getFactorFlops() {
+	return inner->getFactorFlops();
+}
+
+double RefinedSolver::getSolveFlops() {
+	// every refinement step is one more solve and a product with A
+	return (1 + refinementSteps) * inner->getSolveFlops() + 2.0 * refinementSteps * A.nonZeros();
+}
+
+double RefinedSolver::getBackwardError() {
+	return backwardError;
+}
+
+double RefinedSolver::getConditionEstimate() {
+	return conditionEstimate;
+}
+
+int RefinedSolver::getRefinementSteps() {
+	return refinementSteps;
+}
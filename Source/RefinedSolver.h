@@ -0,0 +1,70 @@
+#ifndef REFINEDSOLVER_H
+#define REFINEDSOLVER_H
+
+#include "LinearSolver.h"
+#include "Ordering.h"
+#include "SolveStats.h"
+
+// a solve is accepted when |b - A x| <= tolerance * (|A| |x| + |b|), by Circuit::solve and every engine built on the solvers
+#define BACKWARD_ERROR_TOLERANCE 1e-9
+
+/*
+*	wraps a backend with row/column equilibration and iterative refinement.
+*	the backend factorizes Dr A Dc, where Dr and Dc are powers of two chosen so that every row and column
+*	of the scaled matrix has a largest entry near one (Ruiz scaling), which tames circuits mixing
+*	milliohms with gigaohms. solutions are then refined against the unscaled system until the
+*	normwise backward error |b - A x| / (|A| |x| + |b|) reaches machine precision or stops improving.
+*	a 1-norm condition estimate (Hager/Higham) is taken after each factorization of a direct backend.
+*	when an ordering is set the backend factorizes P Dr A Dc P^T instead.
+*/
+
+class RefinedSolver : public LinearSolver {
+
+private:
+	LinearSolver* inner;
+	SolveStats* stats;
+	SparseMatrix A;
+	Eigen::VectorXd rowScale, colScale;
+	Ordering::Permutation perm;	// empty for the given order
+	double normA;			// infinity norm of A
+	double backwardError;
+	double conditionEstimate;
+	int refinementSteps;
+	bool refine;
+
+	bool factorize(const SparseMatrix& A, bool reuse);
+	bool solveScaled(const Eigen::VectorXd& b, Eigen::VectorXd& x);
+	bool solveScaledTransposed(const Eigen::VectorXd& b, Eigen::VectorXd& x);
+	double computeBackwardError(const Eigen::VectorXd& b, const Eigen::VectorXd& x, Eigen::VectorXd& r);
+	double refineSolution(const Eigen::VectorXd& b, Eigen::VectorXd& x, int& steps);
+	double estimateInverseNorm();
+
+public:
+	// takes ownership of "inner", "stats" may be NULL
+	RefinedSolver(LinearSolver* inner, SolveStats* stats);
+	~RefinedSolver();
+
+	// applies the fill-reducing permutation "perm" to every following factorization
+	void setOrdering(const Ordering::Permutation& perm);
+
+	bool factorize(const SparseMatrix& A);
+	bool refactorize(const SparseMatrix& A);
+	bool solve(const Eigen::VectorXd& b, Eigen::VectorXd& x);
+	bool solveMany(const Eigen::MatrixXd& B, Eigen::MatrixXd& X);
+	bool solveTransposed(const Eigen::VectorXd& b, Eigen::VectorXd& x);
+	Type getType();
+	long getFactorNonzeros();
+	double getFactorFlops();
+	double getSolveFlops();
+
+	// normwise backward error of the last solution
+	double getBackwardError();
+
+	// estimate of the 1-norm condition number of A, -1 when the backend has no factorization to estimate it with
+	double getConditionEstimate();
+
+	// number of refinement steps the last solve took
+	int getRefinementSteps();
+};
+
+#endif
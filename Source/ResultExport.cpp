@@ -0,0 +1,289 @@
+#include "ResultExport.h"
+#include <cctype>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <charconv>
+
+using namespace std;
+
+BufferedWriter::BufferedWriter(size_t capacity) {
+	file = NULL;
+	this->capacity = capacity < 4096 ? 4096 : capacity;
+	buffer = new char[this->capacity];
+	used = 0;
+	failed = false;
+}
+
+BufferedWriter::~BufferedWriter() {
+	close();
+	delete[] buffer;
+}
+
+bool BufferedWriter::open(string path) {
+	close();
+	file = fopen(path.c_str(), "wb");
+	failed = false;
+	used = 0;
+	if (file != NULL)
+		setvbuf(file, NULL, _IONBF, 0);	// we already buffer, stdio would only copy twice
+	return file != NULL;
+}
+
+bool BufferedWriter::isOpen() {
+	return file != NULL;
+}
+
+bool BufferedWriter::flush() {
+	// without a file the buffered bytes are dropped, the buffer must not keep filling up
+	if (file == NULL) {
+		used = 0;
+		return false;
+	}
+	if (used > 0 && fwrite(buffer, 1, used, file) != used)
+		failed = true;
+	used = 0;
+	return !failed;
+}
+
+bool BufferedWriter::close() {
+	if (file == NULL)
+		return !failed;
+	flush();
+	if (fclose(file) != 0)
+		failed = true;
+	file = NULL;
+	return !failed;
+}
+
+void BufferedWriter::write(const void* data, size_t bytes) {
+	if (used + bytes > capacity) {
+		flush();
+		// blocks larger than the buffer go straight to the file
+		if (bytes > capacity) {
+			if (file != NULL && fwrite(data, 1, bytes, file) != bytes)
+				failed = true;
+			return;
+		}
+	}
+	memcpy(buffer + used, data, bytes);
+	used += bytes;
+}
+
+void BufferedWriter::put(char ch) {
+	if (used == capacity)
+		flush();
+	buffer[used++] = ch;
+}
+
+void BufferedWriter::putString(const string& s) {
+	write(s.data(), s.size());
+}
+
+void BufferedWriter::putDouble(double value) {
+	// 32 bytes hold any shortest round-trip double
+	if (used + 32 > capacity)
+		flush();
+	char* first = buffer + used;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+	to_chars_result r = to_chars(first, first + 32, value);
+	used += r.ptr - first;
+#else
+	used += snprintf(first, 32, "%.17g", value);
+#endif
+}
+
+ResultExporter::ResultExporter() {
+	format = CSV;
+	solve = -1;
+}
+
+bool ResultExporter::parseFormat(string name, Format& format) {
+	for (size_t i = 0; i < name.size(); i++)
+		name[i] = tolower(name[i]);
+	if (name == "csv")
+		format = CSV;
+	else if (name == "jsonl" || name == "json")
+		format = JSONL;
+	else if (name == "bin" || name == "binary")
+		format = BINARY;
+	else
+		return false;
+	return true;
+}
+
+bool ResultExporter::open(string path, Format format, bool indexed) {
+	if (indexed && format == BINARY) {
+		cout << "ERROR: Binary results hold a single solve.\n";
+		return false;
+	}
+	this->format = format;
+	solve = indexed ? 0 : -1;
+	nodeVoltage.clear();
+	elemVoltage.clear();
+	elemCurrent.clear();
+	elemPower.clear();
+	elemType.clear();
+	nameOffsets.assign(1, 0);
+	names.clear();
+	if (!out.open(path)) {
+		cout << "ERROR: Can not open " << path << " for writing.\n";
+		return false;
+	}
+	if (format == CSV)
+		out.putString(indexed ? "solve,kind,name,type,voltage,current,power\n" : "kind,name,type,voltage,current,power\n");
+	return true;
+}
+
+bool ResultExporter::isOpen() {
+	return out.isOpen();
+}
+
+ResultExporter::Format ResultExporter::getFormat() {
+	return format;
+}
+
+bool ResultExporter::isIndexed() {
+	return solve >= 0;
+}
+
+void ResultExporter::beginSolve(long index) {
+	if (solve >= 0)
+		solve = index;
+}
+
+void ResultExporter::putSolve() {
+	if (solve < 0)
+		return;
+	if (format == JSONL)
+		out.putString("\"solve\":");
+	out.putString(to_string(solve));
+	out.put(',');
+}
+
+void ResultExporter::putQuoted(const string& s) {
+	out.put('"');
+	for (size_t i = 0; i < s.size(); i++) {
+		// CSV doubles the quote, JSON escapes it
+		if (s[i] == '"')
+			out.put(format == CSV ? '"' : '\\');
+		else if (s[i] == '\\' && format == JSONL)
+			out.put('\\');
+		else if ((unsigned char)s[i] < 0x20 && format == JSONL) {
+			// JSON allows no raw control characters in a string
+			static const char digits[] = "0123456789abcdef";
+			out.putString("\\u00");
+			out.put(digits[(unsigned char)s[i] >> 4]);
+			out.put(digits[s[i] & 15]);
+			continue;
+		}
+		out.put(s[i]);
+	}
+	out.put('"');
+}
+
+void ResultExporter::putNumber(double value) {
+	// JSON has no infinities or NaN
+	if (format == JSONL && !std::isfinite(value))
+		out.putString("null");
+	else
+		out.putDouble(value);
+}
+
+void ResultExporter::writeNode(const string& name, double voltage) {
+	switch (format) {
+	case CSV:
+		putSolve();
+		out.putString("node,");
+		putQuoted(name);
+		out.put(',');
+		out.put(',');
+		out.putDouble(voltage);
+		out.putString(",,\n");
+		break;
+	case JSONL:
+		out.put('{');
+		putSolve();
+		out.putString("\"node\":");
+		putQuoted(name);
+		out.putString(",\"voltage\":");
+		putNumber(voltage);
+		out.putString("}\n");
+		break;
+	case BINARY:
+		// nodes precede elements in the name table, so they must all be written first
+		if (!elemType.empty()) {
+			cout << "ERROR: Binary results need every node before the first element.\n";
+			return;
+		}
+		nodeVoltage.push_back(voltage);
+		names += name;
+		nameOffsets.push_back(names.size());
+		break;
+	}
+}
+
+void ResultExporter::writeElement(const string& name, char type, double voltage, double current, double power) {
+	switch (format) {
+	case CSV:
+		putSolve();
+		out.putString("element,");
+		putQuoted(name);
+		out.put(',');
+		out.put(type);
+		out.put(',');
+		out.putDouble(voltage);
+		out.put(',');
+		out.putDouble(current);
+		out.put(',');
+		out.putDouble(power);
+		out.put('\n');
+		break;
+	case JSONL:
+		out.put('{');
+		putSolve();
+		out.putString("\"element\":");
+		putQuoted(name);
+		out.putString(",\"type\":\"");
+		out.put(type);
+		out.putString("\",\"voltage\":");
+		putNumber(voltage);
+		out.putString(",\"current\":");
+		putNumber(current);
+		out.putString(",\"power\":");
+		putNumber(power);
+		out.putString("}\n");
+		break;
+	case BINARY:
+		elemType.push_back((uint8_t)type);
+		elemVoltage.push_back(voltage);
+		elemCurrent.push_back(current);
+		elemPower.push_back(power);
+		names += name;
+		nameOffsets.push_back(names.size());
+		break;
+	}
+}
+
+bool ResultExporter::close() {
+	if (!out.isOpen())
+		return false;
+	if (format == BINARY) {
+		uint64_t counts[2] = { nodeVoltage.size(), elemType.size() };
+		out.write("CSRESULT", 8);
+		out.write(counts, sizeof(counts));
+		out.write(nodeVoltage.data(), nodeVoltage.size() * sizeof(double));
+		out.write(elemType.data(), elemType.size());
+		static const char zeros[8] = { 0 };
+		out.write(zeros, (8 - elemType.size() % 8) % 8);
+		out.write(elemVoltage.data(), elemVoltage.size() * sizeof(double));
+		out.write(elemCurrent.data(), elemCurrent.size() * sizeof(double));
+		out.write(elemPower.data(), elemPower.size() * sizeof(double));
+		out.write(nameOffsets.data(), nameOffsets.size() * sizeof(uint64_t));
+		out.write(names.data(), names.size());
+	}
+	bool ok = out.close();
+	if (!ok)
+		cout << "ERROR: Writing the results failed.\n";
+	return ok;
+}
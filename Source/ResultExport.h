@@ -0,0 +1,103 @@
+#ifndef RESULTEXPORT_H
+#define RESULTEXPORT_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+/*
+*	a write-only file with a large user-space buffer, so that millions of small records
+*	cost a handful of write calls. doubles are formatted with the shortest round-trip representation.
+*/
+
+class BufferedWriter {
+
+private:
+	FILE* file;
+	char* buffer;
+	size_t capacity;
+	size_t used;
+	bool failed;
+
+	BufferedWriter(const BufferedWriter&);
+	BufferedWriter& operator=(const BufferedWriter&);
+
+public:
+	BufferedWriter(size_t capacity = 1 << 20);
+	~BufferedWriter();
+
+	bool open(string path);
+	// flushes the buffer and closes the file, returns false if any write failed
+	bool close();
+	bool flush();
+	bool isOpen();
+
+	void write(const void* data, size_t bytes);
+	void put(char ch);
+	void putString(const string& s);
+	void putDouble(double value);
+};
+
+/*
+*	writes node voltages and element currents/voltages/powers in one of three layouts:
+*	CSV		one row per node or element: kind,name,type,voltage,current,power
+*	JSONL	one JSON object per line
+*	an indexed exporter holds the results of a sequence of solves, every record starts with the index of its
+*	solve: a leading "solve" column in CSV, a "solve" member in JSON lines. binary results are never indexed.
+*	BINARY	a header followed by one column per quantity (see the layout below), the columns are
+*			kept in memory until close() since their lengths are only known then
+*
+*	binary layout:
+*		char magic[8] "CSRESULT", uint64 numNodes, uint64 numElements
+*		double nodeVoltage[numNodes]
+*		uint8 elemType[numElements], padded to 8 bytes
+*		double elemVoltage[numElements], elemCurrent[numElements], elemPower[numElements]
+*		uint64 nameOffsets[numNodes + numElements + 1], char names[] (nodes first, then elements)
+*/
+
+class ResultExporter {
+
+public: enum Format {
+	CSV, JSONL, BINARY
+};
+
+private:
+	BufferedWriter out;
+	Format format;
+	vector<double> nodeVoltage, elemVoltage, elemCurrent, elemPower;
+	vector<uint8_t> elemType;
+	vector<uint64_t> nameOffsets;
+	string names;
+	long solve;		// the index of the solve the records belong to, -1 when the exporter is not indexed
+
+	void putQuoted(const string& s);
+	// a double, null for the infinities and NaN in JSON
+	void putNumber(double value);
+	// the solve index that starts a record of an indexed exporter
+	void putSolve();
+
+public:
+	ResultExporter();
+
+	// parses "csv", "jsonl"/"json" or "bin"/"binary", returns false if the name is unknown
+	static bool parseFormat(string name, Format& format);
+
+	// opens "path" for one solve, or for a sequence of them when "indexed" is set (CSV and JSON lines only)
+	bool open(string path, Format format, bool indexed = false);
+	bool close();
+	bool isOpen();
+	Format getFormat();
+	bool isIndexed();
+
+	// the records that follow belong to solve "index" of an indexed exporter
+	void beginSolve(long index);
+
+	void writeNode(const string& name, double voltage);
+	// type is the element code letter: R, J, E, S or C
+	void writeElement(const string& name, char type, double voltage, double current, double power);
+};
+
+#endif
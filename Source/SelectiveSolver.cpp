@@ -0,0 +1,211 @@
+#include "SelectiveSolver.h"
+#include <cmath>
+
+// a pivot on the unknown's own row is kept while it is at least this fraction of the largest candidate
+#define PIVOT_THRESHOLD 0.1
+
+SelectiveSolver::SelectiveSolver() {
+	n = 0;
+	stamp = 0;
+	visited = 0;
+}
+
+void SelectiveSolver::newSearch() {
+	order.clear();
+	if (++stamp == 0) {
+		// the stamps wrapped around, forget every old mark
+		marks.assign(n, 0);
+		stamp = 1;
+	}
+}
+
+void SelectiveSolver::search(int root, const vector<int>& start, const vector<int>& indices, const int* columnOf) {
+	if (marks[root] == stamp)
+		return;
+	int top = 0;
+	stack[0] = root;
+	marks[root] = stamp;
+	int column = columnOf == NULL ? root : columnOf[root];
+	next[root] = column < 0 ? 0 : start[column];
+	while (top >= 0) {
+		int node = stack[top];
+		column = columnOf == NULL ? node : columnOf[node];
+		int end = column < 0 ? 0 : start[column + 1];
+		bool descended = false;
+		while (next[node] < end) {
+			int child = indices[next[node]++];
+			if (marks[child] == stamp)
+				continue;
+			marks[child] = stamp;
+			int childColumn = columnOf == NULL ? child : columnOf[child];
+			next[child] = childColumn < 0 ? 0 : start[childColumn];
+			stack[++top] = child;
+			descended = true;
+			break;
+		}
+		if (!descended) {
+			order.push_back(node);
+			top--;
+		}
+	}
+}
+
+bool SelectiveSolver::factorize(const SparseMatrix& A, const Ordering::Permutation& perm) {
+	n = A.rows();
+	qinv.resize(n);
+	vector<int> q(n);
+	for (long i = 0; i < n; i++) {
+		qinv[i] = perm.size() == n ? perm.indices()[i] : i;
+		q[qinv[i]] = i;
+	}
+	pinv.assign(n, -1);
+	lStart.assign(1, 0);
+	lRows.clear();
+	lValues.clear();
+	uDiagonal.assign(n, 0);
+	// U is built by columns and turned into rows at the end
+	vector<int> columnStart(1, 0), columnRows;
+	vector<double> columnValues;
+	work.assign(n, 0);
+	x.assign(n, 0);
+	marks.assign(n, 0);
+	stack.resize(n);
+	next.resize(n);
+	stamp = 0;
+
+	for (long k = 0; k < n; k++) {
+		int j = q[k];
+		// the rows column j fills, through the columns of L of the rows already pivoted
+		newSearch();
+		for (SparseMatrix::InnerIterator it(A, j); it; ++it)
+			search(it.row(), lStart, lRows, pinv.data());
+		for (SparseMatrix::InnerIterator it(A, j); it; ++it)
+			work[it.row()] += it.value();
+
+		// in topological order every row is final before it updates the rows below it
+		int pivot = -1;
+		double largest = 0;
+		for (size_t t = order.size(); t-- > 0; ) {
+			int r = order[t];
+			int p = pinv[r];
+			if (p < 0) {
+				if (std::abs(work[r]) > largest) {
+					largest = std::abs(work[r]);
+					pivot = r;
+				}
+				continue;
+			}
+			double v = work[r];
+			for (int e = lStart[p]; e < lStart[p + 1]; e++)
+				work[lRows[e]] -= lValues[e] * v;
+		}
+		if (pivot < 0 || !(largest > 0) || !std::isfinite(largest)) {
+			for (size_t t = 0; t < order.size(); t++)
+				work[order[t]] = 0;
+			return false;
+		}
+		// the unknown's own row keeps the structure the symmetric ordering planned for
+		if (pinv[j] < 0 && std::abs(work[j]) >= PIVOT_THRESHOLD * largest)
+			pivot = j;
+
+		double d = work[pivot];
+		uDiagonal[k] = d;
+		for (size_t t = 0; t < order.size(); t++) {
+			int r = order[t];
+			if (r != pivot && pinv[r] >= 0) {
+				columnRows.push_back(pinv[r]);
+				columnValues.push_back(work[r]);
+			}
+			else if (r != pivot) {
+				lRows.push_back(r);
+				lValues.push_back(work[r] / d);
+			}
+			work[r] = 0;
+		}
+		pinv[pivot] = k;
+		columnStart.push_back(columnRows.size());
+		lStart.push_back(lRows.size());
+	}
+
+	// the rows of L were the rows of A, they become pivot positions
+	for (size_t e = 0; e < lRows.size(); e++)
+		lRows[e] = pinv[lRows[e]];
+
+	uStart.assign(n + 1, 0);
+	for (size_t e = 0; e < columnRows.size(); e++)
+		uStart[columnRows[e] + 1]++;
+	for (long i = 0; i < n; i++)
+		uStart[i + 1] += uStart[i];
+	uColumns.resize(columnRows.size());
+	uValues.resize(columnRows.size());
+	vector<int> fill(uStart.begin(), uStart.end() - 1);
+	for (long k = 0; k < n; k++) {
+		for (int e = columnStart[k]; e < columnStart[k + 1]; e++) {
+			int slot = fill[columnRows[e]]++;
+			uColumns[slot] = k;
+			uValues[slot] = columnValues[e];
+		}
+	}
+	return true;
+}
+
+long SelectiveSolver::getNumUnknowns() {
+	return n;
+}
+
+long SelectiveSolver::getFactorNonzeros() {
+	return lRows.size() + uColumns.size() + n;
+}
+
+bool SelectiveSolver::solve(const vector<int>& rows, const vector<double>& values, const vector<int>& outputs, vector<double>& solution) {
+	visited = 0;
+	solution.assign(outputs.size(), 0);
+	for (size_t k = 0; k < rows.size(); k++)
+		if (rows[k] < 0 || rows[k] >= n)
+			return false;
+	for (size_t i = 0; i < outputs.size(); i++)
+		if (outputs[i] < 0 || outputs[i] >= n)
+			return false;
+
+	// forward, y = L^-1 P b over the columns of L the nonzeros of b reach
+	newSearch();
+	for (size_t k = 0; k < rows.size(); k++)
+		search(pinv[rows[k]], lStart, lRows, NULL);
+	vector<int> reached(order);
+	for (size_t k = 0; k < rows.size(); k++)
+		work[pinv[rows[k]]] += values[k];
+	for (size_t t = reached.size(); t-- > 0; ) {
+		int p = reached[t];
+		double v = work[p];
+		for (int e = lStart[p]; e < lStart[p + 1]; e++)
+			work[lRows[e]] -= lValues[e] * v;
+		visited += lStart[p + 1] - lStart[p];
+	}
+
+	// backward, z = U^-1 y over the rows of U the outputs depend on, each after the rows it refers to
+	newSearch();
+	for (size_t i = 0; i < outputs.size(); i++)
+		search(qinv[outputs[i]], uStart, uColumns, NULL);
+	bool finite = true;
+	for (size_t t = 0; t < order.size(); t++) {
+		int p = order[t];
+		double s = work[p];
+		for (int e = uStart[p]; e < uStart[p + 1]; e++)
+			s -= uValues[e] * x[uColumns[e]];
+		x[p] = s / uDiagonal[p];
+		finite = finite && std::isfinite(x[p]);
+		visited += uStart[p + 1] - uStart[p] + 1;
+	}
+	for (size_t i = 0; i < outputs.size(); i++)
+		solution[i] = x[qinv[outputs[i]]];
+
+	for (size_t t = 0; t < reached.size(); t++)
+		work[reached[t]] = 0;
+	for (size_t t = 0; t < order.size(); t++)
+		x[order[t]] = 0;
+	return finite;
+}
+
+long SelectiveSolver::getVisited() {
+	return visited;
+}
@@ -0,0 +1,73 @@
+#ifndef SELECTIVESOLVER_H
+#define SELECTIVESOLVER_H
+
+#include <vector>
+#include "LinearSolver.h"
+#include "Ordering.h"
+
+using namespace std;
+
+/*
+*	a sparse LU for right hand sides with a few nonzeros of which only a few unknowns are wanted
+*	(one source of a superposition, the port of a Thevenin query).
+*	A Q = P^T L U is factorized column by column with the left-looking algorithm of Gilbert and Peierls,
+*	threshold partial pivoting preferring the unknown's own row, and L and U are kept as plain columns.
+*	a solve then only visits:
+*		forward, the columns of L reachable from the nonzeros of b (a depth-first search of the graph of L)
+*		backward, the rows of U the wanted unknowns depend on (a depth-first search of the graph of U by rows)
+*	so a point query costs the size of those two closures rather than the nonzeros of the factors.
+*	the work arrays are kept between solves, one solve at a time.
+*/
+
+class SelectiveSolver {
+
+private:
+	long n;
+
+	// position of every row in the pivot order, position of every column in the column order
+	vector<int> pinv, qinv;
+
+	// L by columns in pivot order, its unit diagonal not stored
+	vector<int> lStart, lRows;
+	vector<double> lValues;
+
+	// U by rows in pivot order, its diagonal apart
+	vector<int> uStart, uColumns;
+	vector<double> uValues;
+	vector<double> uDiagonal;
+
+	// dense work vectors, zero between solves, and the marks of the searches
+	vector<double> work, x;
+	vector<int> marks, stack, next, order;
+	int stamp;
+	long visited;
+
+	// starts a new search, every mark older than the stamp counts as unvisited
+	void newSearch();
+
+	// appends to "order" in postorder the nodes reachable from "root" in the graph given by columns (start, indices),
+	// node i having column columnOf[i] (none when negative), or column i when "columnOf" is NULL
+	void search(int root, const vector<int>& start, const vector<int>& indices, const int* columnOf);
+
+public:
+	SelectiveSolver();
+
+	// factorizes "A" with its columns in the order "perm" (the one of Ordering, empty for the given order),
+	// false if A is singular
+	bool factorize(const SparseMatrix& A, const Ordering::Permutation& perm);
+
+	long getNumUnknowns();
+	long getFactorNonzeros();
+
+	/*
+	*	solves A x = b for the unknowns "outputs" only.
+	*	b is zero but for rows[k], which holds values[k], repeated rows are added up.
+	*	"solution" receives the unknowns in the order of "outputs".
+	*/
+	bool solve(const vector<int>& rows, const vector<double>& values, const vector<int>& outputs, vector<double>& solution);
+
+	// gets the entries of the factors the last solve visited, getFactorNonzeros for a full substitution
+	long getVisited();
+};
+
+#endif
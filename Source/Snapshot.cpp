@@ -0,0 +1,397 @@
+#include "Snapshot.h"
+#include "Circuit.h"
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// rounds a section offset up to the next 8-byte boundary
+static uint64_t align8(uint64_t off) {
+	return (off + 7) & ~(uint64_t)7;
+}
+
+Snapshot::Snapshot() {
+	header = NULL;
+}
+
+const char* Snapshot::base() {
+	return (const char*)file.getData();
+}
+
+bool Snapshot::open(string path) {
+	close();
+	if (!file.openRead(path)) {
+		cout << "ERROR: Can not open snapshot " << path << ".\n";
+		return false;
+	}
+	if (file.getSize() < sizeof(SnapshotHeader)) {
+		cout << "ERROR: " << path << " is too small to be a snapshot.\n";
+		close();
+		return false;
+	}
+	SnapshotHeader* h = (SnapshotHeader*)file.getData();
+	if (memcmp(h->magic, SNAPSHOT_MAGIC, 8) != 0 || h->version != SNAPSHOT_VERSION) {
+		cout << "ERROR: " << path << " is not a version " << SNAPSHOT_VERSION << " circuit snapshot.\n";
+		close();
+		return false;
+	}
+
+	// every section must lie inside the file, otherwise a truncated file would be read past its end
+	uint64_t n = h->numNodes, m = h->numElements;
+	struct { uint64_t off, bytes; } sections[] = {
+		{ h->offNodeId, n * sizeof(int32_t) },
+		{ h->offAdjPtr, (n + 1) * sizeof(uint64_t) },
+		{ h->offAdjIdx, h->numAdjacency * sizeof(uint32_t) },
+		{ h->offElemType, m * sizeof(uint8_t) },
+		{ h->offElemPos, m * sizeof(int32_t) },
+		{ h->offElemNeg, m * sizeof(int32_t) },
+		{ h->offElemId, m * sizeof(int32_t) },
+		{ h->offElemValue, m * sizeof(double) },
+		{ h->offNameOffsets, (n + m + 1) * sizeof(uint64_t) },
+		{ h->offNames, h->nameBytes },
+		{ h->offSolution, (h->flags & SNAPSHOT_HAS_SOLUTION) ? h->numUnknowns * sizeof(double) : 0 }
+	};
+	for (size_t i = 0; i < sizeof(sections) / sizeof(sections[0]); i++) {
+		if (sections[i].off % 8 != 0 || sections[i].off > h->fileSize || sections[i].bytes > h->fileSize - sections[i].off
+			|| h->fileSize > file.getSize()) {
+			cout << "ERROR: Snapshot " << path << " is corrupted or truncated.\n";
+			close();
+			return false;
+		}
+	}
+	header = h;
+	return true;
+}
+
+void Snapshot::close() {
+	file.close();
+	header = NULL;
+}
+
+uint64_t Snapshot::getNumNodes() {
+	return header->numNodes;
+}
+uint64_t Snapshot::getNumElements() {
+	return header->numElements;
+}
+uint64_t Snapshot::getNumUnknowns() {
+	return header->numUnknowns;
+}
+bool Snapshot::hasSolution() {
+	return (header->flags & SNAPSHOT_HAS_SOLUTION) != 0;
+}
+
+const int32_t* Snapshot::getNodeIds() {
+	return (const int32_t*)(base() + header->offNodeId);
+}
+const uint64_t* Snapshot::getAdjPtr() {
+	return (const uint64_t*)(base() + header->offAdjPtr);
+}
+const uint32_t* Snapshot::getAdjIdx() {
+	return (const uint32_t*)(base() + header->offAdjIdx);
+}
+const uint8_t* Snapshot::getElemTypes() {
+	return (const uint8_t*)(base() + header->offElemType);
+}
+const int32_t* Snapshot::getElemPos() {
+	return (const int32_t*)(base() + header->offElemPos);
+}
+const int32_t* Snapshot::getElemNeg() {
+	return (const int32_t*)(base() + header->offElemNeg);
+}
+const int32_t* Snapshot::getElemIds() {
+	return (const int32_t*)(base() + header->offElemId);
+}
+const double* Snapshot::getElemValues() {
+	return (const double*)(base() + header->offElemValue);
+}
+const double* Snapshot::getSolution() {
+	if (!hasSolution())
+		return NULL;
+	return (const double*)(base() + header->offSolution);
+}
+
+string Snapshot::getName(uint64_t i) {
+	const uint64_t* offsets = (const uint64_t*)(base() + header->offNameOffsets);
+	const char* names = base() + header->offNames;
+	return string(names + offsets[i], offsets[i + 1] - offsets[i]);
+}
+
+bool Snapshot::write(Circuit* c, string path, bool withSolution) {
+	if (!c->instances->empty()) {
+		// the format has no place for the definitions, only flat circuits are written
+		cout << "ERROR: Can not write a snapshot of a circuit with subcircuit instances.\n";
+		return false;
+	}
+	if (!c->iscleaned)
+		c->cleanUpSP();
+
+	vector<Node*>& nodes = *c->nodes;
+	// elements are numbered with the ordinary elements first, then the voltage sources
+	vector<Element*> elems(c->elements->begin(), c->elements->end());
+	elems.insert(elems.end(), c->voltageSources->begin(), c->voltageSources->end());
+
+	unordered_map<Node*, int32_t> nodeIndex;
+	unordered_map<Element*, uint32_t> elemIndex;
+	nodeIndex.reserve(nodes.size());
+	elemIndex.reserve(elems.size());
+	uint64_t numAdjacency = 0, nameBytes = 0;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		nodeIndex[nodes[i]] = (int32_t)i;
+		numAdjacency += nodes[i]->getNumOfElements();
+		nameBytes += nodes[i]->getName().size();
+	}
+	for (size_t i = 0; i < elems.size(); i++) {
+		elemIndex[elems[i]] = (uint32_t)i;
+		nameBytes += elems[i]->getName().size();
+	}
+
+	bool solution = withSolution && !c->solution->empty();
+
+	SnapshotHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SNAPSHOT_MAGIC, 8);
+	h.version = SNAPSHOT_VERSION;
+	h.flags = solution ? SNAPSHOT_HAS_SOLUTION : 0;
+	h.numNodes = nodes.size();
+	h.numElements = elems.size();
+	h.numAdjacency = numAdjacency;
+	h.nameBytes = nameBytes;
+	h.numUnknowns = solution ? c->solution->size() : 0;
+
+	uint64_t n = h.numNodes, m = h.numElements;
+	uint64_t off = align8(sizeof(SnapshotHeader));
+	h.offNodeId = off;			off = align8(off + n * sizeof(int32_t));
+	h.offAdjPtr = off;			off = align8(off + (n + 1) * sizeof(uint64_t));
+	h.offAdjIdx = off;			off = align8(off + numAdjacency * sizeof(uint32_t));
+	h.offElemType = off;		off = align8(off + m * sizeof(uint8_t));
+	h.offElemPos = off;			off = align8(off + m * sizeof(int32_t));
+	h.offElemNeg = off;			off = align8(off + m * sizeof(int32_t));
+	h.offElemId = off;			off = align8(off + m * sizeof(int32_t));
+	h.offElemValue = off;		off = align8(off + m * sizeof(double));
+	h.offNameOffsets = off;		off = align8(off + (n + m + 1) * sizeof(uint64_t));
+	h.offNames = off;			off = align8(off + nameBytes);
+	h.offSolution = off;		off = align8(off + h.numUnknowns * sizeof(double));
+	h.fileSize = off;
+
+	MappedFile out;
+	if (!out.create(path, (size_t)h.fileSize)) {
+		cout << "ERROR: Can not create snapshot " << path << ".\n";
+		return false;
+	}
+	char* b = (char*)out.getData();
+	memcpy(b, &h, sizeof(h));
+
+	int32_t* nodeIds = (int32_t*)(b + h.offNodeId);
+	uint64_t* adjPtr = (uint64_t*)(b + h.offAdjPtr);
+	uint32_t* adjIdx = (uint32_t*)(b + h.offAdjIdx);
+	uint64_t* nameOffsets = (uint64_t*)(b + h.offNameOffsets);
+	char* names = b + h.offNames;
+	uint64_t a = 0, nb = 0;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		nodeIds[i] = nodes[i]->getId();
+		adjPtr[i] = a;
+		vector<Element*>* ne = nodes[i]->getElements();
+		for (vector<Element*>::iterator it = ne->begin(); it != ne->end(); it++)
+			adjIdx[a++] = elemIndex[*it];
+		string name = nodes[i]->getName();
+		nameOffsets[i] = nb;
+		memcpy(names + nb, name.data(), name.size());
+		nb += name.size();
+	}
+	adjPtr[n] = a;
+
+	uint8_t* types = (uint8_t*)(b + h.offElemType);
+	int32_t* pos = (int32_t*)(b + h.offElemPos);
+	int32_t* neg = (int32_t*)(b + h.offElemNeg);
+	int32_t* ids = (int32_t*)(b + h.offElemId);
+	double* values = (double*)(b + h.offElemValue);
+	for (size_t i = 0; i < elems.size(); i++) {
+		Element* e = elems[i];
+		types[i] = (uint8_t)e->getType();
+		pos[i] = e->getPosNode() == NULL ? -1 : nodeIndex[e->getPosNode()];
+		neg[i] = e->getNegNode() == NULL ? -1 : nodeIndex[e->getNegNode()];
+		ids[i] = e->getId();
+		switch (e->getType()) {
+		case Element::ElementType::RESISTOR:
+			values[i] = e->getResistance();
+			break;
+		case Element::ElementType::CURRENT_SOURCE:
+			values[i] = e->getCurrent();
+			break;
+		case Element::ElementType::VOLTAGE_SOURCE:
+			values[i] = e->getVoltage();
+			break;
+		case Element::ElementType::SWITCH:
+			values[i] = e->isClosed() ? 1 : 0;
+			break;
+		case Element::ElementType::CAPACITOR:
+			values[i] = e->getCapacitance();
+			break;
+		default:
+			values[i] = 0;
+			break;
+		}
+		string name = e->getName();
+		nameOffsets[n + i] = nb;
+		memcpy(names + nb, name.data(), name.size());
+		nb += name.size();
+	}
+	nameOffsets[n + m] = nb;
+
+	if (solution)
+		memcpy(b + h.offSolution, c->solution->data(), h.numUnknowns * sizeof(double));
+
+	if (!out.flush()) {
+		cout << "ERROR: Failed to write snapshot " << path << ".\n";
+		return false;
+	}
+	return true;
+}
+
+bool Snapshot::validate() {
+	uint64_t n = header->numNodes, m = header->numElements;
+	const int32_t* nodeIds = getNodeIds();
+	const uint64_t* adjPtr = getAdjPtr();
+	const uint32_t* adjIdx = getAdjIdx();
+	const uint8_t* types = getElemTypes();
+	const int32_t* pos = getElemPos();
+	const int32_t* neg = getElemNeg();
+	const int32_t* ids = getElemIds();
+	const uint64_t* nameOffsets = (const uint64_t*)(base() + header->offNameOffsets);
+
+	// the names are read straight out of the mapping, their offsets must stay within the name table
+	for (uint64_t i = 0; i < n + m; i++) {
+		if (nameOffsets[i] > nameOffsets[i + 1] || nameOffsets[i + 1] > header->nameBytes) {
+			cout << "ERROR: Snapshot name table is corrupted.\n";
+			return false;
+		}
+	}
+	uint64_t sources = 0;
+	for (uint64_t i = 0; i < m; i++) {
+		if (types[i] >= Element::ElementType::ERROR || pos[i] < -1 || pos[i] >= (int64_t)n || neg[i] < -1 || neg[i] >= (int64_t)n) {
+			cout << "ERROR: Snapshot element " << i << " is corrupted.\n";
+			return false;
+		}
+		if (types[i] == Element::ElementType::VOLTAGE_SOURCE || types[i] == Element::ElementType::SWITCH)
+			sources++;
+	}
+
+	// the ground comes first with id -1, the other nodes and the voltage sources share the ids of the unknowns,
+	// each one of them exactly once
+	if (n == 0 || nodeIds[0] != -1) {
+		cout << "ERROR: Snapshot has no ground.\n";
+		return false;
+	}
+	uint64_t unknowns = n - 1 + sources;
+	vector<bool> taken(unknowns, false);
+	for (uint64_t i = 1; i < n + m; i++) {
+		int32_t id;
+		if (i < n)
+			id = nodeIds[i];
+		else if (types[i - n] == Element::ElementType::VOLTAGE_SOURCE || types[i - n] == Element::ElementType::SWITCH)
+			id = ids[i - n];
+		else
+			continue;
+		if (id < 0 || (uint64_t)id >= unknowns || taken[id]) {
+			cout << "ERROR: Snapshot equation ids are corrupted.\n";
+			return false;
+		}
+		taken[id] = true;
+	}
+
+	// node i lists the elements connected to it, in adjIdx[adjPtr[i] .. adjPtr[i+1])
+	if (adjPtr[0] != 0 || adjPtr[n] != header->numAdjacency) {
+		cout << "ERROR: Snapshot topology is corrupted.\n";
+		return false;
+	}
+	for (uint64_t i = 0; i < n; i++) {
+		if (adjPtr[i] > adjPtr[i + 1]) {
+			cout << "ERROR: Snapshot topology is corrupted.\n";
+			return false;
+		}
+		for (uint64_t a = adjPtr[i]; a < adjPtr[i + 1]; a++) {
+			if (adjIdx[a] >= m || (pos[adjIdx[a]] != (int64_t)i && neg[adjIdx[a]] != (int64_t)i)) {
+				cout << "ERROR: Snapshot topology is corrupted.\n";
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool Snapshot::load(Circuit* c) {
+	if (header == NULL)
+		return false;
+	if (!c->nodes->empty() || !c->elements->empty() || !c->voltageSources->empty()) {
+		cout << "ERROR: A snapshot can only be loaded into an empty circuit.\n";
+		return false;
+	}
+	// nothing is created until the whole file has been checked, a corrupted one leaves the circuit empty
+	if (!validate())
+		return false;
+
+	uint64_t n = header->numNodes, m = header->numElements;
+	const int32_t* nodeIds = getNodeIds();
+	const uint64_t* adjPtr = getAdjPtr();
+	const uint32_t* adjIdx = getAdjIdx();
+	const uint8_t* types = getElemTypes();
+	const int32_t* pos = getElemPos();
+	const int32_t* neg = getElemNeg();
+	const int32_t* ids = getElemIds();
+	const double* values = getElemValues();
+
+	vector<Node*> nodes(n);
+	vector<Element*> elems(m);
+	c->nodes->reserve(n);
+	c->nodeNames->reserve(n);
+	c->elementNames->reserve(m);
+
+	// node and voltage source ids interleave in the order they were added, so both are stored
+	// explicitly and lastId continues after the largest of them. the first node is the ground.
+	int lastId = 0;
+	for (uint64_t i = 0; i < n; i++) {
+		nodes[i] = new Node(getName(i), nodeIds[i]);
+		if (i == 0)
+			nodes[i]->setGround(true);
+		if (nodeIds[i] + 1 > lastId)
+			lastId = nodeIds[i] + 1;
+		c->nodes->push_back(nodes[i]);
+		(*c->nodeNames)[nodes[i]->getName()] = nodes[i];
+	}
+	for (uint64_t i = 0; i < m; i++) {
+		Element::ElementType et = (Element::ElementType)types[i];
+		Element* e = new Element(getName(n + i), et, values[i]);
+		e->setId(ids[i]);
+		if (pos[i] >= 0)
+			e->setPosNode(nodes[pos[i]]);
+		if (neg[i] >= 0)
+			e->setNegNode(nodes[neg[i]]);
+		if (et == Element::ElementType::VOLTAGE_SOURCE || et == Element::ElementType::SWITCH) {
+			c->voltageSources->push_back(e);
+			if (et == Element::ElementType::SWITCH)
+				c->switches->push_back(e);
+			if (ids[i] + 1 > lastId)
+				lastId = ids[i] + 1;
+		}
+		else
+			c->elements->push_back(e);
+		(*c->elementNames)[e->getName()] = e;
+		elems[i] = e;
+	}
+	for (uint64_t i = 0; i < n; i++) {
+		for (uint64_t a = adjPtr[i]; a < adjPtr[i + 1]; a++)
+			nodes[i]->addElement(elems[adjIdx[a]]);
+	}
+	c->lastId = lastId;
+	c->iscleaned = true;
+
+	if (hasSolution() && header->numUnknowns == (uint64_t)(n - 1 + c->voltageSources->size())) {
+		const double* x = getSolution();
+		c->solution->assign(x, x + header->numUnknowns);
+		c->deployResults(c->solution->data());
+	}
+	return true;
+}
@@ -0,0 +1,107 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+#include <stdint.h>
+#include "MappedFile.h"
+
+using namespace std;
+
+class Circuit;
+
+/*
+*	binary snapshot of a circuit: the topology as a node -> element CSR table, the element values,
+*	the name table and optionally the last solution vector.
+*	the file is read and written through memory mapping, every section is 8-byte aligned
+*	so the arrays can be used in place straight out of the mapping.
+*
+*	layout (all integers little endian as written by the host):
+*		SnapshotHeader
+*		nodeId		int32[numNodes]			equation id of each node, -1 for the ground
+*		adjPtr		uint64[numNodes + 1]	element list of node i is adjIdx[adjPtr[i] .. adjPtr[i+1])
+*		adjIdx		uint32[numAdjacency]	indices into the element arrays
+*		elemType	uint8[numElements]		Element::ElementType
+*		elemPos		int32[numElements]		node index of the positive terminal, -1 if unconnected
+*		elemNeg		int32[numElements]		node index of the negative terminal, -1 if unconnected
+*		elemId		int32[numElements]		equation id (voltage sources, switches) or -2
+*		elemValue	double[numElements]		resistance, current or voltage depending on the type, 1 for a closed switch, capacitance
+*		nameOffsets	uint64[numNodes + numElements + 1]	nodes first, then elements
+*		names		char[nameBytes]
+*		solution	double[numUnknowns]		only when SNAPSHOT_HAS_SOLUTION is set
+*/
+
+#define SNAPSHOT_MAGIC "CSNAPSHT"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HAS_SOLUTION 1
+
+struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t numNodes;
+	uint64_t numElements;
+	uint64_t numAdjacency;
+	uint64_t nameBytes;
+	uint64_t numUnknowns;
+	uint64_t offNodeId;
+	uint64_t offAdjPtr;
+	uint64_t offAdjIdx;
+	uint64_t offElemType;
+	uint64_t offElemPos;
+	uint64_t offElemNeg;
+	uint64_t offElemId;
+	uint64_t offElemValue;
+	uint64_t offNameOffsets;
+	uint64_t offNames;
+	uint64_t offSolution;
+	uint64_t fileSize;
+};
+
+/*
+*	a read-only view of a snapshot file, the arrays point directly into the mapping,
+*	so any number of worker processes can share one copy of the data.
+*/
+
+class Snapshot {
+
+private:
+	MappedFile file;
+	SnapshotHeader* header;
+
+	const char* base();
+	// checks every index of the mapped tables against the counts of the header
+	bool validate();
+
+public:
+	Snapshot();
+
+	// maps the file and validates its header and section bounds
+	bool open(string path);
+	void close();
+
+	uint64_t getNumNodes();
+	uint64_t getNumElements();
+	uint64_t getNumUnknowns();
+	bool hasSolution();
+
+	const int32_t* getNodeIds();
+	const uint64_t* getAdjPtr();
+	const uint32_t* getAdjIdx();
+	const uint8_t* getElemTypes();
+	const int32_t* getElemPos();
+	const int32_t* getElemNeg();
+	const int32_t* getElemIds();
+	const double* getElemValues();
+	const double* getSolution();
+
+	// name i of the table: nodes are 0 .. numNodes-1, elements follow
+	string getName(uint64_t i);
+
+	// writes circuit "c" to "path", including its last solution if "withSolution" is set
+	static bool write(Circuit* c, string path, bool withSolution);
+
+	// rebuilds the mapped snapshot into the empty circuit "c", which is left empty if the snapshot is corrupted
+	bool load(Circuit* c);
+};
+
+#endif
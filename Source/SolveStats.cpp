@@ -0,0 +1,189 @@
+#include "SolveStats.h"
+#include <iomanip>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+SolveStats::SolveStats() {
+	enabled = false;
+	reset();
+}
+
+void SolveStats::setEnabled(bool enabled) {
+	this->enabled = enabled;
+}
+
+void SolveStats::reset() {
+	for (int i = 0; i < NUM_PHASES; i++) {
+		seconds[i] = 0;
+		calls[i] = 0;
+	}
+	unknowns = 0;
+	nonzeros = 0;
+	fillIn = 0;
+	flops = 0;
+	formulationName = "none";
+	solverName = "none";
+	orderingName = "none";
+	backwardError = -1;
+	conditionEstimate = -1;
+	refinementSteps = 0;
+}
+
+void SolveStats::merge(SolveStats* other) {
+	for (int i = 0; i < NUM_PHASES; i++) {
+		seconds[i] += other->seconds[i];
+		calls[i] += other->calls[i];
+	}
+	unknowns += other->unknowns;
+	nonzeros += other->nonzeros;
+	fillIn += other->fillIn;
+	flops += other->flops;
+	formulationName = other->formulationName;
+	solverName = other->solverName;
+	orderingName = other->orderingName;
+	backwardError = max(backwardError, other->backwardError);
+	conditionEstimate = max(conditionEstimate, other->conditionEstimate);
+	refinementSteps += other->refinementSteps;
+}
+
+void SolveStats::addTime(Phase phase, double seconds) {
+	this->seconds[phase] += seconds;
+	this->calls[phase]++;
+}
+
+void SolveStats::setSystemSize(long unknowns, long nonzeros) {
+	if (!enabled)
+		return;
+	this->unknowns = unknowns;
+	this->nonzeros = nonzeros;
+}
+
+void SolveStats::setFillIn(long fillIn) {
+	if (enabled)
+		this->fillIn = fillIn;
+}
+
+void SolveStats::addFlops(double flops) {
+	if (enabled)
+		this->flops += flops;
+}
+
+double SolveStats::getSeconds(Phase phase) {
+	return seconds[phase];
+}
+long SolveStats::getCalls(Phase phase) {
+	return calls[phase];
+}
+long SolveStats::getUnknowns() {
+	return unknowns;
+}
+long SolveStats::getNonzeros() {
+	return nonzeros;
+}
+long SolveStats::getFillIn() {
+	return fillIn;
+}
+double SolveStats::getFlops() {
+	return flops;
+}
+const char* SolveStats::getFormulationName() {
+	return formulationName;
+}
+const char* SolveStats::getSolverName() {
+	return solverName;
+}
+const char* SolveStats::getOrderingName() {
+	return orderingName;
+}
+
+void SolveStats::setFormulationName(const char* name) {
+	if (enabled)
+		formulationName = name;
+}
+
+void SolveStats::setSolverName(const char* name) {
+	if (enabled)
+		solverName = name;
+}
+
+void SolveStats::setOrderingName(const char* name) {
+	if (enabled)
+		orderingName = name;
+}
+
+void SolveStats::setAccuracy(double backwardError, double conditionEstimate, int refinementSteps) {
+	if (!enabled)
+		return;
+	this->backwardError = backwardError;
+	this->conditionEstimate = conditionEstimate;
+	this->refinementSteps += refinementSteps;
+}
+double SolveStats::getBackwardError() {
+	return backwardError;
+}
+double SolveStats::getConditionEstimate() {
+	return conditionEstimate;
+}
+long SolveStats::getRefinementSteps() {
+	return refinementSteps;
+}
+
+long long SolveStats::getPeakMemory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return (long long)pmc.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return (long long)usage.ru_maxrss;			// bytes on macOS
+#else
+	return (long long)usage.ru_maxrss * 1024;	// kilobytes elsewhere
+#endif
+#endif
+}
+
+const char* SolveStats::getPhaseName(Phase phase) {
+	switch (phase) {
+	case PARSE: return "parse";
+	case CHECK: return "check";
+	case ASSEMBLE: return "assemble";
+	case ORDER: return "order";
+	case FACTORIZE: return "factorize";
+	case SOLVE: return "solve";
+	case REFINE: return "refine";
+	case DEPLOY: return "deploy";
+	case EXPORT: return "export";
+	default: return "?";
+	}
+}
+
+void SolveStats::print(ostream& out) {
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << "Statistics:\n";
+	out << "  phase          calls     time (ms)\n";
+	double total = 0;
+	for (int i = 0; i < NUM_PHASES; i++) {
+		out << "  " << left << setw(12) << getPhaseName((Phase)i) << right << setw(8) << calls[i]
+			<< fixed << setprecision(3) << setw(14) << seconds[i] * 1e3 << "\n";
+		total += seconds[i];
+	}
+	out << "  " << left << setw(20) << "total" << right << setw(14) << total * 1e3 << "\n";
+	out.flags(flags);
+	out.precision(precision);
+	out << "  formulation: " << formulationName << ", solver: " << solverName << ", ordering: " << orderingName << ", unknowns: " << unknowns << ", nonzeros: " << nonzeros << ", fill-in: " << fillIn << "\n";
+	out << "  backward error: " << backwardError << ", condition estimate: " << conditionEstimate
+		<< ", refinement steps: " << refinementSteps << "\n";
+	out << "  estimated flops: " << flops << "\n";
+	out << "  peak memory: " << getPeakMemory() / (1024.0 * 1024.0) << " MiB\n";
+}
@@ -0,0 +1,95 @@
+#ifndef SOLVESTATS_H
+#define SOLVESTATS_H
+
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+/*
+*	per-phase timing and counters of the solve pipeline.
+*	everything is a no-op while the statistics are disabled, the phases only read the clock when enabled.
+*/
+
+class SolveStats {
+
+public: enum Phase {
+	PARSE, CHECK, ASSEMBLE, ORDER, FACTORIZE, SOLVE, REFINE, DEPLOY, EXPORT, NUM_PHASES
+};
+
+private:
+	bool enabled;
+	double seconds[NUM_PHASES];
+	long calls[NUM_PHASES];
+	long unknowns;			// size of the last system
+	long nonzeros;			// nonzero coefficients of the last system
+	long fillIn;			// entries of the last factorization that were zero in the system
+	double flops;			// estimated floating point operations of all factorizations and solves
+	const char* formulationName;	// nodal or loop equations of the last solve
+	const char* solverName;	// backend of the last solve
+	const char* orderingName;	// fill-reducing ordering of the last solve
+	double backwardError;	// normwise backward error of the last solve
+	double conditionEstimate;	// 1-norm condition estimate of the last factorization, -1 if unknown
+	long refinementSteps;	// iterative refinement steps of all solves
+
+public:
+	SolveStats();
+
+	void setEnabled(bool enabled);
+	bool isEnabled() { return enabled; }
+	void reset();
+	// adds the times and counters of "other", the sizes are summed and the worst accuracy is kept
+	void merge(SolveStats* other);
+
+	void addTime(Phase phase, double seconds);
+	void setSystemSize(long unknowns, long nonzeros);
+	void setFillIn(long fillIn);
+	void addFlops(double flops);
+	void setFormulationName(const char* name);
+	void setSolverName(const char* name);
+	void setOrderingName(const char* name);
+	void setAccuracy(double backwardError, double conditionEstimate, int refinementSteps);
+
+	double getSeconds(Phase phase);
+	long getCalls(Phase phase);
+	long getUnknowns();
+	long getNonzeros();
+	long getFillIn();
+	double getFlops();
+	const char* getFormulationName();
+	const char* getSolverName();
+	const char* getOrderingName();
+	double getBackwardError();
+	double getConditionEstimate();
+	long getRefinementSteps();
+
+	// peak resident memory of the whole process in bytes, 0 if the platform does not report it
+	static long long getPeakMemory();
+
+	static const char* getPhaseName(Phase phase);
+
+	void print(ostream& out);
+};
+
+// times the enclosing scope as one call of "phase"
+class ScopedPhase {
+
+private:
+	SolveStats* stats;
+	SolveStats::Phase phase;
+	chrono::steady_clock::time_point start;
+
+public:
+	ScopedPhase(SolveStats* stats, SolveStats::Phase phase) {
+		this->stats = (stats != NULL && stats->isEnabled()) ? stats : NULL;
+		this->phase = phase;
+		if (this->stats != NULL)
+			start = chrono::steady_clock::now();
+	}
+	~ScopedPhase() {
+		if (stats != NULL)
+			stats->addTime(phase, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+	}
+};
+
+#endif
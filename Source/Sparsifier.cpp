@@ -0,0 +1,220 @@
+#include "Sparsifier.h"
+#include "Circuit.h"
+#include "EffectiveResistance.h"
+#include "RefinedSolver.h"
+#include "Ordering.h"
+#include <cmath>
+#include <random>
+
+// the random projection has this many dimensions per log(n), enough for resistances within a constant factor
+#define SKETCH_DIMENSIONS_PER_LOG 4
+#define SKETCH_MIN_DIMENSIONS 8
+// the oversampling constant c of the probabilities
+#define SAMPLING_CONSTANT 4
+// refinement stops after this many steps, or once the backward error stops improving
+#define MAX_REFINEMENT_STEPS 50
+
+Sparsifier::Sparsifier(Circuit* c, double epsilon, unsigned seed) {
+	circuit = c;
+	ready = false;
+	this->epsilon = epsilon;
+	resistors = 0;
+	solver = NULL;
+	factorized = false;
+	orderingName = "none";
+	nonZeros = 0;
+	refinementSteps = 0;
+	backwardError = -1;
+	if (epsilon <= 0) {
+		cout << "ERROR: The sparsification epsilon must be positive.\n";
+		return;
+	}
+
+	// the projection is solved iteratively, factorizing the dense network is what the sparsifier avoids
+	EffectiveResistance network(c, LinearSolver::CONJUGATE_GRADIENT);
+	if (!network.isReady())
+		return;
+	double logn = log((double)max(network.getNumNodes(), 2L));
+	int dimensions = max(SKETCH_MIN_DIMENSIONS, (int)ceil(SKETCH_DIMENSIONS_PER_LOG * logn));
+	if (!network.buildSketch(dimensions, seed))
+		return;
+
+	double oversampling = SAMPLING_CONSTANT * logn / (epsilon * epsilon);
+	mt19937 random(seed);
+	uniform_real_distribution<double> uniform(0, 1);
+	for (vector<Element*>::iterator it = c->elements->begin(); it != c->elements->end(); it++) {
+		if ((*it)->getType() != Element::ElementType::RESISTOR)
+			continue;
+		resistors++;
+		// a resistor across nodes shorted by a voltage source carries the current of the source, it is kept
+		double resistance = network.estimateResistance((*it)->getPosNode()->getName(), (*it)->getNegNode()->getName());
+		double p = resistance == 0 ? 1 : min(1.0, oversampling * resistance / (*it)->getResistance());
+		if (p < 1 && uniform(random) >= p)
+			continue;
+		kept.push_back(*it);
+		probabilities.push_back(p);
+	}
+	ready = true;
+}
+
+Sparsifier::~Sparsifier() {
+	delete solver;
+}
+
+bool Sparsifier::isReady() {
+	return ready;
+}
+
+void Sparsifier::createEquations(SparseMatrix& eqn, Eigen::VectorXd& vals) {
+	ScopedPhase phase(circuit->stats, SolveStats::ASSEMBLE);
+	int n = circuit->voltageSources->size() + circuit->nodes->size() - 1;
+	vals = Eigen::VectorXd::Zero(n);
+	vector<bool> isSource(n, false);
+	for (vector<Element*>::iterator it = circuit->voltageSources->begin(); it != circuit->voltageSources->end(); it++)
+		isSource[(*it)->getId()] = true;
+
+	// the nodal equations without their resistors, which only stamp between nodes, then the sampled ones
+	vector<Eigen::Triplet<double> > triplets, row;
+	for (vector<Node*>::iterator it = circuit->nodes->begin(); it != circuit->nodes->end(); it++) {
+		if ((*it)->isGround()) continue;
+		int id = (*it)->getId();
+		row.clear();
+		circuit->createEquation(*it, id, row, vals[id]);
+		for (size_t k = 0; k < row.size(); k++)
+			if (isSource[row[k].col()])
+				triplets.push_back(row[k]);
+	}
+	for (vector<Element*>::iterator it = circuit->voltageSources->begin(); it != circuit->voltageSources->end(); it++) {
+		int id = (*it)->getId();
+		circuit->createEquation(*it, id, triplets, vals[id]);
+	}
+	for (vector<Instance*>::iterator it = circuit->instances->begin(); it != circuit->instances->end(); it++)
+		circuit->createEquation(*it, triplets, vals);
+	for (size_t k = 0; k < kept.size(); k++) {
+		double g = 1 / (kept[k]->getResistance() * probabilities[k]);
+		Node* a = kept[k]->getPosNode();
+		Node* b = kept[k]->getNegNode();
+		if (!a->isGround())
+			triplets.push_back(Eigen::Triplet<double>(a->getId(), a->getId(), g));
+		if (!b->isGround())
+			triplets.push_back(Eigen::Triplet<double>(b->getId(), b->getId(), g));
+		if (!a->isGround() && !b->isGround()) {
+			triplets.push_back(Eigen::Triplet<double>(a->getId(), b->getId(), -g));
+			triplets.push_back(Eigen::Triplet<double>(b->getId(), a->getId(), -g));
+		}
+	}
+
+	eqn.resize(n, n);
+	eqn.setFromTriplets(triplets.begin(), triplets.end());
+	eqn.makeCompressed();
+}
+
+bool Sparsifier::solve(bool refine, Eigen::VectorXd& x) {
+	if (!ready)
+		return false;
+	SolveStats* stats = circuit->stats;
+	SparseMatrix H;
+	Eigen::VectorXd vals;
+	createEquations(H, vals);
+	stats->setSystemSize(H.rows(), H.nonZeros());
+
+	// the sample is fixed per topology, so is the pattern of H: the ordering and the symbolic analysis are kept
+	LinearSolver::Type type = circuit->solverType == LinearSolver::AUTO ? LinearSolver::select(H) : circuit->solverType;
+	if (solver == NULL || solver->getType() != type) {
+		delete solver;
+		solver = new RefinedSolver(LinearSolver::create(type), stats);
+		factorized = false;
+		orderingName = type == LinearSolver::BANDED ? Ordering::getTypeName(Ordering::REVERSE_CUTHILL_MCKEE) : "none";
+		if (LinearSolver::usesOrdering(type)) {
+			ScopedPhase phase(stats, SolveStats::ORDER);
+			Ordering::Permutation perm;
+			orderingName = Ordering::getTypeName(Ordering::compute(H, circuit->orderingType, perm));
+			solver->setOrdering(perm);
+		}
+	}
+	{
+		ScopedPhase phase(stats, SolveStats::FACTORIZE);
+		factorized = factorized ? solver->refactorize(H) : solver->factorize(H);
+	}
+	nonZeros = H.nonZeros();
+	refinementSteps = 0;
+	if (!factorized || !solver->solve(vals, x) || solver->getBackwardError() > BACKWARD_ERROR_TOLERANCE) {
+		cout << "ERROR: The sparsified system could not be solved accurately.\n";
+		return false;
+	}
+	backwardError = solver->getBackwardError();
+	double flops = solver->getFactorFlops() + solver->getSolveFlops();
+
+	if (refine) {
+		// the full system is only multiplied with, H^-1 stands in for its inverse
+		SparseMatrix A;
+		Eigen::VectorXd b, r, dx;
+		circuit->createEquations(A, b);
+		Eigen::VectorXd rowSums = Eigen::VectorXd::Zero(A.rows());
+		for (int j = 0; j < A.outerSize(); j++)
+			for (SparseMatrix::InnerIterator it(A, j); it; ++it)
+				rowSums[it.row()] += fabs(it.value());
+		double normA = rowSums.size() > 0 ? rowSums.maxCoeff() : 0;
+		double last = HUGE_VAL;
+		while (true) {
+			r = b - A * x;
+			double denominator = normA * x.lpNorm<Eigen::Infinity>() + b.lpNorm<Eigen::Infinity>();
+			backwardError = denominator > 0 ? r.lpNorm<Eigen::Infinity>() / denominator : 0;
+			flops += 2.0 * A.nonZeros();
+			if (backwardError <= BACKWARD_ERROR_TOLERANCE || backwardError >= last || refinementSteps >= MAX_REFINEMENT_STEPS)
+				break;
+			last = backwardError;
+			if (!solver->solve(r, dx))
+				break;
+			flops += solver->getSolveFlops();
+			x += dx;
+			refinementSteps++;
+		}
+		stats->setSystemSize(A.rows(), A.nonZeros());
+		if (backwardError > BACKWARD_ERROR_TOLERANCE) {
+			cout << "ERROR: The sparsified solution could not be refined against the full system.\n";
+			return false;
+		}
+	}
+
+	if (stats->isEnabled()) {
+		stats->setSolverName(LinearSolver::getTypeName(type));
+		stats->setOrderingName(orderingName);
+		stats->addFlops(flops);
+		long factorNonzeros = solver->getFactorNonzeros();
+		stats->setFillIn(max(0L, factorNonzeros - H.nonZeros()));
+		stats->setAccuracy(backwardError, solver->getConditionEstimate(), solver->getRefinementSteps() + refinementSteps);
+	}
+	return true;
+}
+
+long Sparsifier::getNumKept() {
+	return kept.size();
+}
+
+long Sparsifier::getNumResistors() {
+	return resistors;
+}
+
+int Sparsifier::getRefinementSteps() {
+	return refinementSteps;
+}
+
+double Sparsifier::getBackwardError() {
+	return backwardError;
+}
+
+LinearSolver::Type Sparsifier::getType() {
+	return solver == NULL ? LinearSolver::AUTO : solver->getType();
+}
+
+double Sparsifier::getConditionEstimate() {
+	return solver == NULL ? -1 : solver->getConditionEstimate();
+}
+
+void Sparsifier::print(ostream& out) {
+	out << "Sparsified " << resistors << " resistors to " << kept.size() << " within epsilon " << epsilon;
+	if (nonZeros > 0)
+		out << ", " << nonZeros << " nonzeros factorized, " << refinementSteps << " refinement steps to a backward error of " << backwardError;
+	out << ".\n";
+}
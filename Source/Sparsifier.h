@@ -0,0 +1,86 @@
+#ifndef SPARSIFIER_H
+#define SPARSIFIER_H
+
+#include <vector>
+#include <iostream>
+#include "Eigen/Dense"
+#include "LinearSolver.h"
+
+using namespace std;
+
+class Circuit;
+class Element;
+class RefinedSolver;
+
+/*
+*	a spectral sparsifier of the resistors of a circuit (Spielman and Srivastava), for dense networks (all-to-all
+*	couplings, dense meshes) whose factorization is dominated by resistors that barely change the solution.
+*		resistor e of conductance g is kept with probability p = min(1, c log(n) g R(e) / epsilon^2) and then
+*		stamps g / p, where R(e) is the effective resistance across it. the conductances g R(e) of a network sum
+*		to its n - 1 nodes, so about c n log(n) / epsilon^2 resistors are kept however dense it is, and the
+*		sampled Laplacian H satisfies (1 - epsilon) L <= H <= (1 + epsilon) L with high probability.
+*		the resistances are read from a random projection of the network solved by conjugate gradients,
+*		which never factorizes the dense system, the sampling only needs them within a constant factor.
+*	the sources, switches and instances are stamped as they are, only the resistors are sampled. the sample
+*	is drawn once per topology and the values are read per solve.
+*	the solution of the sparsified system is within epsilon of the exact one in the energy norm of the resistors,
+*	refining it against the full system, x += H^-1 (b - A x), gains about a factor epsilon per step.
+*/
+
+class Sparsifier {
+
+private:
+	Circuit* circuit;
+	bool ready;
+	double epsilon;
+
+	// the resistors kept and the probability each was kept with
+	vector<Element*> kept;
+	vector<double> probabilities;
+	long resistors;
+
+	RefinedSolver* solver;
+	bool factorized;
+	const char* orderingName;
+	long nonZeros;
+	int refinementSteps;
+	double backwardError;
+
+	// assembles the sparsified system, "eqn", and the right hand side of the circuit, "vals"
+	void createEquations(SparseMatrix& eqn, Eigen::VectorXd& vals);
+
+public:
+	// samples the resistors of "c" within "epsilon", see isReady
+	Sparsifier(Circuit* c, double epsilon, unsigned seed);
+	~Sparsifier();
+
+	// false if the resistances could not be estimated (a node with no resistive path to the ground, an instance)
+	bool isReady();
+
+	/*
+	*	solves the circuit on the sparsified system
+	*	@param refine : refines the solution against the full system until it is as accurate as an exact solve,
+	*	which assembles the full system but never factorizes it
+	*	@param x : the unknowns, indexed as those of Circuit
+	*/
+	bool solve(bool refine, Eigen::VectorXd& x);
+
+	// gets the number of resistors kept and of resistors in the circuit
+	long getNumKept();
+	long getNumResistors();
+
+	// the refinement steps of the last solve, 0 when it was not refined
+	int getRefinementSteps();
+
+	// the normwise backward error of the last solve, against the full system when it was refined
+	double getBackwardError();
+
+	// the backend of the last solve and the condition estimate of the sparsified system, -1 if it was not estimated
+	LinearSolver::Type getType();
+	double getConditionEstimate();
+
+	// prints the resistors kept and the accuracy of the last solve
+	void print(ostream& out);
+};
+
+#endif
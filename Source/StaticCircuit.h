@@ -0,0 +1,190 @@
+#ifndef STATICCIRCUIT_H
+#define STATICCIRCUIT_H
+
+#include <utility>
+#include <tuple>
+#include "Eigen/Dense"
+
+using namespace std;
+
+/*
+*	circuits whose topology is fixed at compile time, for tiny circuits solved over and over with new values.
+*	the elements are types carrying their nodes, numbered 1 ... Nodes with 0 as the ground:
+*		typedef StaticCircuit<2, VoltageSource<1, 0>, Resistor<1, 2>, Resistor<2, 0> > Divider;
+*		Divider::Values values;
+*		values << 10, 1e3, 2e3;				// one value per element, in the order of the elements
+*		Divider::Vector x;
+*		Divider::solve(values, x);
+*		double out = Divider::voltage<2>(x);
+*	the unknowns are the node voltages followed by the currents of the voltage sources, as in Circuit.
+*	the system is a fixed-size Eigen matrix, every stamp is expanded at compile time into additions at
+*	constant positions, and nothing is allocated on the heap or looked up by name.
+*	the sign conventions are the ones of Element: a current source drives its value into its positive node,
+*	a voltage source holds V(pos) - V(neg) at its value.
+*/
+
+// the voltage of node "Node" in the unknowns "x", 0 for the ground
+template<int Node, typename Vector>
+inline double staticVoltage(const Vector& x) {
+	if constexpr (Node == 0)
+		return 0;
+	else
+		return x[Node - 1];
+}
+
+template<int Pos, int Neg>
+struct Resistor {
+	enum { POS = Pos, NEG = Neg, IS_VOLTAGE_SOURCE = 0 };
+
+	template<int Row, typename Matrix, typename Vector>
+	static void stamp(double resistance, Matrix& A, Vector&) {
+		double g = 1 / resistance;
+		if constexpr (Pos > 0)
+			A(Pos - 1, Pos - 1) += g;
+		if constexpr (Neg > 0)
+			A(Neg - 1, Neg - 1) += g;
+		if constexpr (Pos > 0 && Neg > 0) {
+			A(Pos - 1, Neg - 1) -= g;
+			A(Neg - 1, Pos - 1) -= g;
+		}
+	}
+
+	template<int Row, typename Vector>
+	static double current(double resistance, const Vector& x) {
+		return -(staticVoltage<Pos>(x) - staticVoltage<Neg>(x)) / resistance;
+	}
+};
+
+template<int Pos, int Neg>
+struct CurrentSource {
+	enum { POS = Pos, NEG = Neg, IS_VOLTAGE_SOURCE = 0 };
+
+	template<int Row, typename Matrix, typename Vector>
+	static void stamp(double value, Matrix&, Vector& b) {
+		if constexpr (Pos > 0)
+			b[Pos - 1] += value;
+		if constexpr (Neg > 0)
+			b[Neg - 1] -= value;
+	}
+
+	template<int Row, typename Vector>
+	static double current(double value, const Vector&) {
+		return value;
+	}
+};
+
+// "Row" is the unknown holding the source's current
+template<int Pos, int Neg>
+struct VoltageSource {
+	enum { POS = Pos, NEG = Neg, IS_VOLTAGE_SOURCE = 1 };
+
+	template<int Row, typename Matrix, typename Vector>
+	static void stamp(double voltage, Matrix& A, Vector& b) {
+		if constexpr (Pos > 0) {
+			A(Row, Pos - 1) += 1;
+			A(Pos - 1, Row) -= 1;
+		}
+		if constexpr (Neg > 0) {
+			A(Row, Neg - 1) -= 1;
+			A(Neg - 1, Row) += 1;
+		}
+		b[Row] = voltage;
+	}
+
+	template<int Row, typename Vector>
+	static double current(double, const Vector& x) {
+		return x[Row];
+	}
+};
+
+template<int Nodes, typename... Elements>
+class StaticCircuit {
+
+	static_assert(sizeof...(Elements) > 0, "a circuit needs at least one element");
+	static_assert(((Elements::POS >= 0 && Elements::POS <= Nodes && Elements::NEG >= 0 && Elements::NEG <= Nodes) && ...),
+		"element nodes must be between 0 (the ground) and Nodes");
+
+public:
+	enum {
+		NUM_ELEMENTS = sizeof...(Elements),
+		NUM_VOLTAGE_SOURCES = (0 + ... + (int)Elements::IS_VOLTAGE_SOURCE),
+		N = Nodes + NUM_VOLTAGE_SOURCES
+	};
+
+	typedef Eigen::Matrix<double, N, N> Matrix;
+	typedef Eigen::Matrix<double, N, 1> Vector;
+	typedef Eigen::Matrix<double, NUM_ELEMENTS, 1> Values;
+
+private:
+	// the unknown of element i's current if it is a voltage source, they follow the node voltages in order
+	static constexpr int rowOf(int i) {
+		const int isSource[] = { (int)Elements::IS_VOLTAGE_SOURCE... };
+		int row = Nodes;
+		for (int k = 0; k < i; k++)
+			row += isSource[k];
+		return row;
+	}
+
+	template<size_t... I>
+	static void stampAll(const Values& values, Matrix& A, Vector& b, index_sequence<I...>) {
+		(Elements::template stamp<rowOf(I)>(values[I], A, b), ...);
+	}
+
+public:
+	// builds the system A x = b for the element values "values"
+	static void stamp(const Values& values, Matrix& A, Vector& b) {
+		A.setZero();
+		b.setZero();
+		stampAll(values, A, b, make_index_sequence<NUM_ELEMENTS>());
+	}
+
+	// solves for the unknowns "x", false if the system is singular.
+	// gaussian elimination with partial pivoting, the loop bounds are constants the compiler unrolls
+	static bool solve(const Values& values, Vector& x) {
+		Matrix A;
+		Vector inverse;			// of the pivots, one division per column
+		stamp(values, A, x);
+		for (int k = 0; k < N; k++) {
+			int pivot = k;
+			for (int i = k + 1; i < N; i++)
+				if (abs(A(i, k)) > abs(A(pivot, k)))
+					pivot = i;
+			if (!(A(pivot, k) != 0))
+				return false;
+			if (pivot != k) {
+				A.row(k).swap(A.row(pivot));
+				swap(x[k], x[pivot]);
+			}
+			inverse[k] = 1 / A(k, k);
+			for (int i = k + 1; i < N; i++) {
+				double l = A(i, k) * inverse[k];
+				for (int j = k + 1; j < N; j++)
+					A(i, j) -= l * A(k, j);
+				x[i] -= l * x[k];
+			}
+		}
+		for (int i = N - 1; i >= 0; i--) {
+			for (int j = i + 1; j < N; j++)
+				x[i] -= A(i, j) * x[j];
+			x[i] *= inverse[i];
+		}
+		return true;
+	}
+
+	// the voltage of node "Node", 0 for the ground
+	template<int Node>
+	static double voltage(const Vector& x) {
+		static_assert(Node >= 0 && Node <= Nodes, "no such node");
+		return staticVoltage<Node>(x);
+	}
+
+	// the current through element "I", with the conventions of Circuit::getCurrent
+	template<int I>
+	static double current(const Values& values, const Vector& x) {
+		static_assert(I >= 0 && I < NUM_ELEMENTS, "no such element");
+		typedef typename tuple_element<I, tuple<Elements...> >::type Element;
+		return Element::template current<rowOf(I)>(values[I], x);
+	}
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "Subcircuit.h"
+
+Subcircuit::Subcircuit(string name, const vector<string>& ports) {
+	this->name = name;
+	this->ports = new vector<string>(ports);
+	entries = new vector<Entry>();
+	nodeIndex = new unordered_map<string, int>();
+	entryIndex = new unordered_map<string, int>();
+	sourceIndex = new vector<int>();
+	numUnknowns = 0;
+	(*nodeIndex)["0"] = -1;
+	for (size_t i = 0; i < ports.size(); i++)
+		(*nodeIndex)[ports[i]] = numUnknowns++;
+	reduced = false;
+	reducible = false;
+	admittance = new Eigen::MatrixXd();
+	nortonCurrents = new Eigen::VectorXd();
+	portCoupling = new SparseMatrix();
+	interiorSources = new Eigen::VectorXd();
+	interior = new Eigen::SparseLU<SparseMatrix, Eigen::COLAMDOrdering<int> >();
+}
+
+Subcircuit::~Subcircuit() {
+	delete ports;
+	delete entries;
+	delete nodeIndex;
+	delete entryIndex;
+	delete sourceIndex;
+	delete admittance;
+	delete nortonCurrents;
+	delete portCoupling;
+	delete interiorSources;
+	delete interior;
+}
+
+int Subcircuit::getUnknown(const string& node) {
+	unordered_map<string, int>::iterator it = nodeIndex->find(node);
+	if (it != nodeIndex->end())
+		return it->second;
+	(*nodeIndex)[node] = numUnknowns;
+	return numUnknowns++;
+}
+
+bool Subcircuit::addElement(string name, double value, string posNode, string negNode, Element::ElementType et) {
+	if (reduced || posNode == negNode || getEntry(name) >= 0 || et == Element::ElementType::ERROR
+		|| et == Element::ElementType::SWITCH || (et == Element::ElementType::RESISTOR && value <= 0))
+		return false;
+	Entry e;
+	e.name = name;
+	e.type = et;
+	e.value = value;
+	e.posNode = posNode;
+	e.negNode = negNode;
+	getUnknown(posNode);
+	getUnknown(negNode);
+	(*entryIndex)[name] = (int)entries->size();
+	entries->push_back(e);
+	sourceIndex->push_back(et == Element::ElementType::VOLTAGE_SOURCE ? numUnknowns++ : -1);
+	return true;
+}
+
+bool Subcircuit::addInstance(string instanceName, Subcircuit* child, const vector<string>& connections) {
+	if (child == this || connections.size() != child->ports->size())
+		return false;
+	// the child's ports become the nodes it is connected to, its interior gets the instance's prefix
+	unordered_map<string, string> rename;
+	for (size_t i = 0; i < connections.size(); i++)
+		rename[(*child->ports)[i]] = connections[i];
+	rename["0"] = "0";
+	for (vector<Entry>::iterator it = child->entries->begin(); it != child->entries->end(); it++) {
+		string pos = rename.count(it->posNode) ? rename[it->posNode] : instanceName + "." + it->posNode;
+		string neg = rename.count(it->negNode) ? rename[it->negNode] : instanceName + "." + it->negNode;
+		if (!addElement(instanceName + "." + it->name, it->value, pos, neg, it->type))
+			return false;
+	}
+	return true;
+}
+
+bool Subcircuit::reduce() {
+	if (reduced)
+		return reducible;
+	reduced = true;
+
+	int n = numUnknowns;
+	int p = (int)ports->size();
+	int m = n - p;
+	vector<Eigen::Triplet<double> > triplets;
+	Eigen::VectorXd f = Eigen::VectorXd::Zero(n);
+	for (size_t k = 0; k < entries->size(); k++) {
+		Entry& e = (*entries)[k];
+		int a = (*nodeIndex)[e.posNode];
+		int b = (*nodeIndex)[e.negNode];
+		switch (e.type) {
+		case Element::ElementType::RESISTOR: {
+			double g = 1 / e.value;
+			if (a >= 0) triplets.push_back(Eigen::Triplet<double>(a, a, g));
+			if (b >= 0) triplets.push_back(Eigen::Triplet<double>(b, b, g));
+			if (a >= 0 && b >= 0) {
+				triplets.push_back(Eigen::Triplet<double>(a, b, -g));
+				triplets.push_back(Eigen::Triplet<double>(b, a, -g));
+			}
+			break;
+		}
+		case Element::ElementType::CURRENT_SOURCE:
+			if (a >= 0) f[a] += e.value;
+			if (b >= 0) f[b] -= e.value;
+			break;
+		case Element::ElementType::VOLTAGE_SOURCE: {
+			// the same stamp as Circuit::createEquation
+			int s = (*sourceIndex)[k];
+			if (a >= 0) {
+				triplets.push_back(Eigen::Triplet<double>(a, s, -1));
+				triplets.push_back(Eigen::Triplet<double>(s, a, 1));
+			}
+			if (b >= 0) {
+				triplets.push_back(Eigen::Triplet<double>(b, s, 1));
+				triplets.push_back(Eigen::Triplet<double>(s, b, -1));
+			}
+			f[s] = e.value;
+			break;
+		}
+		// the port model is the DC one, the capacitors are kept by flattening the instances
+		case Element::ElementType::CAPACITOR:
+		default:
+			return false;
+		}
+	}
+	SparseMatrix K(n, n);
+	K.setFromTriplets(triplets.begin(), triplets.end());
+
+	Eigen::MatrixXd Kpp = Eigen::MatrixXd(K.block(0, 0, p, p));
+	Eigen::VectorXd fp = f.head(p);
+	if (m == 0) {
+		*admittance = Kpp;
+		*nortonCurrents = fp;
+		reducible = true;
+		return true;
+	}
+
+	SparseMatrix Kii = K.block(p, p, m, m);
+	SparseMatrix Kpi = K.block(0, p, p, m);
+	*portCoupling = K.block(p, 0, m, p);
+	*interiorSources = f.tail(m);
+	Kii.makeCompressed();
+	interior->analyzePattern(Kii);
+	interior->factorize(Kii);
+	if (interior->info() != Eigen::Success)
+		return false;
+
+	// Kii^-1 Kip and Kii^-1 fi in one multi column solve
+	Eigen::MatrixXd rhs(m, p + 1);
+	rhs.leftCols(p) = Eigen::MatrixXd(*portCoupling);
+	rhs.col(p) = *interiorSources;
+	Eigen::MatrixXd X = interior->solve(rhs);
+	if (interior->info() != Eigen::Success || !X.allFinite())
+		return false;
+	*admittance = Kpp - Kpi * X.leftCols(p);
+	*nortonCurrents = fp - Kpi * X.col(p);
+	reducible = true;
+	return true;
+}
+
+bool Subcircuit::solveInterior(const Eigen::VectorXd& portVoltages, bool enabled, Eigen::VectorXd& x) {
+	if (!reducible)
+		return false;
+	int m = numUnknowns - (int)ports->size();
+	if (m == 0) {
+		x.resize(0);
+		return true;
+	}
+	Eigen::VectorXd rhs = -(*portCoupling * portVoltages);
+	if (enabled)
+		rhs += *interiorSources;
+	x = interior->solve(rhs);
+	return interior->info() == Eigen::Success;
+}
+
+int Subcircuit::getNodeUnknown(string node) {
+	unordered_map<string, int>::iterator it = nodeIndex->find(node);
+	if (it == nodeIndex->end())
+		return -2;
+	return it->second;
+}
+
+int Subcircuit::getSourceUnknown(int entry) {
+	return (*sourceIndex)[entry];
+}
+
+int Subcircuit::getEntry(string name) {
+	unordered_map<string, int>::iterator it = entryIndex->find(name);
+	if (it == entryIndex->end())
+		return -1;
+	return it->second;
+}
+
+string Subcircuit::getName() {
+	return name;
+}
+
+int Subcircuit::getNumPorts() {
+	return (int)ports->size();
+}
+
+string Subcircuit::getPort(int port) {
+	return (*ports)[port];
+}
+
+vector<Subcircuit::Entry>* Subcircuit::getEntries() {
+	return entries;
+}
+
+Eigen::MatrixXd* Subcircuit::getAdmittance() {
+	return admittance;
+}
+
+Eigen::VectorXd* Subcircuit::getNortonCurrents() {
+	return nortonCurrents;
+}
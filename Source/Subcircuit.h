@@ -0,0 +1,93 @@
+#ifndef SUBCIRCUIT_H
+#define SUBCIRCUIT_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Element.h"
+#include "LinearSolver.h"
+#include "Eigen/Dense"
+#include "Eigen/SparseLU"
+
+using namespace std;
+
+/*
+*	a subcircuit definition (.subckt): elements between local node names, some of which are ports.
+*	node "0" inside a definition is the global ground.
+*	the interior is eliminated once per definition: with the local equations split into ports (p) and
+*	interior unknowns (i), the current the outside drives into the ports is
+*		I = (Kpp - Kpi Kii^-1 Kip) Vp - (fp - Kpi Kii^-1 fi) = Y Vp - J
+*	so every instance stamps the dense port admittance Y and the Norton currents J instead of its elements.
+*	Kii stays factorized to recover the interior of an instance on demand.
+*/
+
+class Subcircuit {
+
+public:
+	// an element of the definition, with the local names of its nodes
+	struct Entry {
+		string name;
+		Element::ElementType type;
+		double value;
+		string posNode;
+		string negNode;
+	};
+
+private:
+	string name;
+	vector<string>* ports;
+	vector<Entry>* entries;
+
+	// local node name -> unknown, the ports come first and the ground is -1
+	unordered_map<string, int>* nodeIndex;
+	// element name -> entry, and voltage source entry -> its current unknown
+	unordered_map<string, int>* entryIndex;
+	vector<int>* sourceIndex;
+	int numUnknowns;
+
+	bool reduced;
+	bool reducible;
+	Eigen::MatrixXd* admittance;		// Y
+	Eigen::VectorXd* nortonCurrents;	// J
+	SparseMatrix* portCoupling;			// Kip
+	Eigen::VectorXd* interiorSources;	// fi
+	Eigen::SparseLU<SparseMatrix, Eigen::COLAMDOrdering<int> >* interior;	// factorization of Kii
+
+	int getUnknown(const string& node);
+
+public:
+	Subcircuit(string name, const vector<string>& ports);
+	~Subcircuit();
+
+	// adds an element across the local nodes "posNode" and "negNode", with the conventions of Element
+	bool addElement(string name, double value, string posNode, string negNode, Element::ElementType et);
+
+	// copies the elements of "child", instantiated as "instanceName" on the local nodes "connections",
+	// so that definitions can use other definitions
+	bool addInstance(string instanceName, Subcircuit* child, const vector<string>& connections);
+
+	// eliminates the interior, once. false when Kii is singular (a source across two ports, a floating interior),
+	// such a definition has no port admittance and its instances have to be flattened
+	bool reduce();
+
+	// solves the interior unknowns for the port voltages "portVoltages", without the internal sources if not "enabled"
+	bool solveInterior(const Eigen::VectorXd& portVoltages, bool enabled, Eigen::VectorXd& x);
+
+	// the local unknown of node "node", -1 for the ground and -2 if there is no such node
+	int getNodeUnknown(string node);
+
+	// the unknown holding the current of voltage source entry "entry", -1 for other elements
+	int getSourceUnknown(int entry);
+
+	// the entry of element "name", -1 if there is none
+	int getEntry(string name);
+
+	string getName();
+	int getNumPorts();
+	string getPort(int port);
+	vector<Entry>* getEntries();
+	Eigen::MatrixXd* getAdmittance();
+	Eigen::VectorXd* getNortonCurrents();
+};
+
+#endif
@@ -0,0 +1,367 @@
+#include "SupernodalSolver.h"
+#include <algorithm>
+#include <thread>
+
+// neighboring supernodes of the tree are merged, accepting explicit zeros in their blocks:
+// any merge up to this many columns,
+#define RELAX_SMALL_COLUMNS 4
+// then up to 16 columns with a fifth of zeros and up to 48 with a twentieth
+#define RELAX_MEDIUM_COLUMNS 16
+#define RELAX_MEDIUM_ZEROS 0.2
+#define RELAX_LARGE_COLUMNS 48
+#define RELAX_LARGE_ZEROS 0.05
+// subtrees cheaper than this are factorized by one task, scheduling their supernodes apart would cost more
+#define TASK_MIN_FLOPS 1e6
+
+SupernodalSolver::SupernodalSolver(ThreadPool* pool) {
+	this->pool = pool;
+	n = 0;
+	nonzeros = 0;
+	factorFlops = 0;
+	pendingChildren = NULL;
+	remaining = 0;
+	failed = false;
+}
+
+SupernodalSolver::~SupernodalSolver() {
+	delete[] pendingChildren;
+}
+
+// cost of a supernode of w columns and r rows below them: LLT, TRSM and SYRK
+static double supernodeFlops(double w, double r) {
+	return w * w * w / 3 + w * w * r + w * r * r;
+}
+
+bool SupernodalSolver::analyze(const SparseMatrix& A) {
+	n = A.rows();
+	supernodes.clear();
+
+	// the elimination tree by Liu's algorithm, with path compression through "ancestor"
+	vector<int> parent(n, -1), ancestor(n, -1);
+	for (int j = 0; j < n; j++) {
+		for (SparseMatrix::InnerIterator it(A, j); it; ++it) {
+			int r = (int)it.row();
+			if (r >= j)
+				continue;
+			while (ancestor[r] != -1 && ancestor[r] != j) {
+				int next = ancestor[r];
+				ancestor[r] = j;
+				r = next;
+			}
+			if (ancestor[r] == -1) {
+				ancestor[r] = j;
+				parent[r] = j;
+			}
+		}
+	}
+
+	// its postorder, the children of a column are visited in increasing order
+	vector<int> head(n, -1), sibling(n, -1), stack;
+	for (int j = n - 1; j >= 0; j--) {
+		if (parent[j] >= 0) {
+			sibling[j] = head[parent[j]];
+			head[parent[j]] = j;
+		}
+	}
+	post.resize(n);
+	int visited = 0;
+	for (int root = 0; root < n; root++) {
+		if (parent[root] >= 0)
+			continue;
+		stack.push_back(root);
+		while (!stack.empty()) {
+			int j = stack.back();
+			if (head[j] >= 0) {
+				int child = head[j];
+				head[j] = sibling[child];
+				stack.push_back(child);
+			}
+			else {
+				post.indices()[j] = visited++;
+				stack.pop_back();
+			}
+		}
+	}
+	pattern = A.twistedBy(post);
+	vector<int> tree(n, -1), childCount(n, 0);
+	for (int j = 0; j < n; j++) {
+		if (parent[j] >= 0) {
+			tree[post.indices()[j]] = post.indices()[parent[j]];
+			childCount[post.indices()[parent[j]]]++;
+		}
+	}
+
+	// column counts of L: row i of L is the subtree of the tree spanned by the nonzeros of row i of A
+	vector<int> columnCount(n, 1), mark(n, -1);
+	for (int i = 0; i < n; i++) {
+		mark[i] = i;
+		for (SparseMatrix::InnerIterator it(pattern, i); it; ++it) {
+			for (int j = (int)it.row(); j < i && mark[j] != i; j = tree[j]) {
+				mark[j] = i;
+				columnCount[j]++;
+			}
+		}
+	}
+
+	// fundamental supernodes: a column joins the previous one when it is its only child with one row less
+	struct Candidate {
+		int first, last;
+		double entries, zeros;
+	};
+	vector<Candidate> merged;
+	for (int j = 0; j < n; ) {
+		Candidate c;
+		c.first = j;
+		while (j + 1 < n && tree[j] == j + 1 && columnCount[j] == columnCount[j + 1] + 1 && childCount[j + 1] == 1)
+			j++;
+		c.last = j++;
+		double w = c.last - c.first + 1, r = columnCount[c.last] - 1;
+		c.entries = w * (w + 1) / 2 + w * r;
+		c.zeros = 0;
+		// relaxed: the supernodes just before it that are its children are absorbed while the zeros stay few
+		while (!merged.empty()) {
+			Candidate& t = merged.back();
+			if (tree[t.last] < c.first || tree[t.last] > c.last)
+				break;
+			double width = c.last - t.first + 1;
+			double entries = width * (width + 1) / 2 + width * r;
+			double zeros = entries - (t.entries - t.zeros) - (c.entries - c.zeros);
+			bool merge = width <= RELAX_SMALL_COLUMNS || (width <= RELAX_MEDIUM_COLUMNS && zeros <= RELAX_MEDIUM_ZEROS * entries)
+				|| (width <= RELAX_LARGE_COLUMNS && zeros <= RELAX_LARGE_ZEROS * entries);
+			if (!merge)
+				break;
+			c.first = t.first;
+			c.entries = entries;
+			c.zeros = zeros;
+			merged.pop_back();
+		}
+		merged.push_back(c);
+	}
+
+	// the tree of the supernodes, and the rows below every one of them, its children's rows included
+	int count = (int)merged.size();
+	vector<int> supernodeOf(n);
+	supernodes.resize(count);
+	for (int s = 0; s < count; s++) {
+		Supernode& sn = supernodes[s];
+		sn.first = merged[s].first;
+		sn.last = merged[s].last;
+		sn.firstDescendant = s;
+		sn.sequential = false;
+		for (int j = sn.first; j <= sn.last; j++)
+			supernodeOf[j] = s;
+	}
+	vector<double> work(count);
+	nonzeros = 0;
+	factorFlops = 0;
+	mark.assign(n, -1);
+	for (int s = 0; s < count; s++) {
+		Supernode& sn = supernodes[s];
+		sn.parent = tree[sn.last] < 0 ? -1 : supernodeOf[tree[sn.last]];
+		for (int j = sn.first; j <= sn.last; j++) {
+			for (SparseMatrix::InnerIterator it(pattern, j); it; ++it) {
+				int i = (int)it.row();
+				if (i > sn.last && mark[i] != s) {
+					mark[i] = s;
+					sn.rows.push_back(i);
+				}
+			}
+		}
+		for (size_t c = 0; c < sn.children.size(); c++) {
+			const vector<int>& rows = supernodes[sn.children[c]].rows;
+			for (size_t k = 0; k < rows.size(); k++) {
+				if (rows[k] > sn.last && mark[rows[k]] != s) {
+					mark[rows[k]] = s;
+					sn.rows.push_back(rows[k]);
+				}
+			}
+		}
+		sort(sn.rows.begin(), sn.rows.end());
+		if (sn.parent >= 0) {
+			supernodes[sn.parent].children.push_back(s);
+			supernodes[sn.parent].firstDescendant = min(supernodes[sn.parent].firstDescendant, sn.firstDescendant);
+		}
+		double w = sn.last - sn.first + 1, r = sn.rows.size();
+		nonzeros += (long)(w * (w + 1) / 2 + w * r);
+		work[s] += supernodeFlops(w, r);
+		factorFlops += supernodeFlops(w, r);
+		if (sn.parent >= 0)
+			work[sn.parent] += work[s];
+	}
+	// a supernode in a cheap subtree under a cheap parent is left to the task of the subtree
+	for (int s = 0; s < count; s++) {
+		int p = supernodes[s].parent;
+		supernodes[s].sequential = p >= 0 && work[s] < TASK_MIN_FLOPS && work[p] < TASK_MIN_FLOPS;
+	}
+	delete[] pendingChildren;
+	pendingChildren = new atomic<int>[count];
+	return true;
+}
+
+bool SupernodalSolver::factorizeSupernode(int s, const SparseMatrix& A, vector<int>& position) {
+	Supernode& sn = supernodes[s];
+	int w = sn.last - sn.first + 1, r = (int)sn.rows.size();
+	for (int k = 0; k < w; k++)
+		position[sn.first + k] = k;
+	for (int k = 0; k < r; k++)
+		position[sn.rows[k]] = w + k;
+
+	// the front: the columns of A, then the update matrices of the children added at their rows
+	Eigen::MatrixXd F = Eigen::MatrixXd::Zero(w + r, w + r);
+	for (int j = sn.first; j <= sn.last; j++)
+		for (SparseMatrix::InnerIterator it(A, j); it; ++it)
+			if (it.row() >= j)
+				F(position[it.row()], j - sn.first) += it.value();
+	vector<int> index;
+	for (size_t c = 0; c < sn.children.size(); c++) {
+		Supernode& child = supernodes[sn.children[c]];
+		int m = (int)child.rows.size();
+		index.resize(m);
+		for (int k = 0; k < m; k++)
+			index[k] = position[child.rows[k]];
+		for (int b = 0; b < m; b++)
+			for (int a = b; a < m; a++)
+				F(index[a], index[b]) += child.update(a, b);
+		child.update.resize(0, 0);
+	}
+
+	Eigen::LLT<Eigen::MatrixXd> llt(F.topLeftCorner(w, w));
+	if (llt.info() != Eigen::Success)
+		return false;
+	sn.L.resize(w + r, w);
+	sn.L.topRows(w) = llt.matrixL();
+	if (r > 0) {
+		Eigen::Block<Eigen::MatrixXd> below = sn.L.bottomRows(r);
+		below = F.bottomLeftCorner(r, w);
+		llt.matrixU().solveInPlace<Eigen::OnTheRight>(below);
+		sn.update = F.bottomRightCorner(r, r);
+		sn.update.selfadjointView<Eigen::Lower>().rankUpdate(below, -1.0);
+	}
+	return true;
+}
+
+void SupernodalSolver::runTask(int s, const SparseMatrix& A) {
+	static thread_local vector<int> position;
+	if ((long)position.size() < n)
+		position.resize(n);
+	// the children of a cheap subtree are all sequential, it is run whole in postorder
+	const vector<int>& children = supernodes[s].children;
+	int from = !children.empty() && supernodes[children[0]].sequential ? supernodes[s].firstDescendant : s;
+	for (int k = from; k <= s && !failed; k++)
+		if (!factorizeSupernode(k, A, position))
+			failed = true;
+
+	int p = supernodes[s].parent;
+	if (p >= 0 && !supernodes[s].sequential && pendingChildren[p].fetch_sub(1) == 1)
+		pool->submit([this, p, &A] { runTask(p, A); });
+	remaining--;
+}
+
+bool SupernodalSolver::factorize(const SparseMatrix& A) {
+	// only the lower triangle is read, an unsymmetric matrix would silently be solved wrong
+	if (!isSymmetric(A))
+		return false;
+	analyze(A);
+	return refactorize(A);
+}
+
+bool SupernodalSolver::refactorize(const SparseMatrix& A) {
+	if (A.rows() != n || (long)post.size() != n)
+		return factorize(A);
+	pattern = A.twistedBy(post);
+	int count = (int)supernodes.size();
+	failed = false;
+
+	// the tasks are the supernodes not run by a subtree task, each waits for its children that are tasks
+	vector<int> ready;
+	int tasks = 0;
+	for (int s = 0; s < count; s++) {
+		if (supernodes[s].sequential)
+			continue;
+		tasks++;
+		int children = 0;
+		for (size_t c = 0; c < supernodes[s].children.size(); c++)
+			if (!supernodes[supernodes[s].children[c]].sequential)
+				children++;
+		pendingChildren[s] = children;
+		if (children == 0)
+			ready.push_back(s);
+	}
+	remaining = tasks;
+	const SparseMatrix& P = pattern;
+	for (size_t k = 0; k < ready.size(); k++) {
+		int s = ready[k];
+		pool->submit([this, s, &P] { runTask(s, P); });
+	}
+	// the calling thread helps, so a factorization inside a task of the pool can not leave it without workers
+	while (remaining.load() > 0)
+		if (!pool->runPending())
+			this_thread::yield();
+	return !failed;
+}
+
+bool SupernodalSolver::solveMany(const Eigen::MatrixXd& B, Eigen::MatrixXd& X) {
+	if (B.rows() != n)
+		return false;
+	Eigen::MatrixXd Y = post * B;
+	int count = (int)supernodes.size();
+	// L Z = P B, supernode by supernode
+	for (int s = 0; s < count; s++) {
+		const Supernode& sn = supernodes[s];
+		int w = sn.last - sn.first + 1, r = (int)sn.rows.size();
+		Eigen::Block<Eigen::MatrixXd> z = Y.middleRows(sn.first, w);
+		sn.L.topRows(w).triangularView<Eigen::Lower>().solveInPlace(z);
+		if (r == 0)
+			continue;
+		Eigen::MatrixXd below = sn.L.bottomRows(r) * z;
+		for (int k = 0; k < r; k++)
+			Y.row(sn.rows[k]) -= below.row(k);
+	}
+	// L^T W = Z in reverse
+	for (int s = count - 1; s >= 0; s--) {
+		const Supernode& sn = supernodes[s];
+		int w = sn.last - sn.first + 1, r = (int)sn.rows.size();
+		Eigen::Block<Eigen::MatrixXd> z = Y.middleRows(sn.first, w);
+		if (r > 0) {
+			Eigen::MatrixXd below(r, Y.cols());
+			for (int k = 0; k < r; k++)
+				below.row(k) = Y.row(sn.rows[k]);
+			z -= sn.L.bottomRows(r).transpose() * below;
+		}
+		sn.L.topRows(w).triangularView<Eigen::Lower>().adjoint().solveInPlace(z);
+	}
+	X = post.transpose() * Y;
+	return X.allFinite();
+}
+
+bool SupernodalSolver::solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+	Eigen::MatrixXd X;
+	if (!solveMany(b, X))
+		return false;
+	x = X.col(0);
+	return true;
+}
+
+bool SupernodalSolver::solveTransposed(const Eigen::VectorXd& b, Eigen::VectorXd& x) {
+	return solve(b, x);
+}
+
+LinearSolver::Type SupernodalSolver::getType() {
+	return SUPERNODAL;
+}
+
+long SupernodalSolver::getFactorNonzeros() {
+	return nonzeros;
+}
+
+double SupernodalSolver::getFactorFlops() {
+	return factorFlops;
+}
+
+double SupernodalSolver::getSolveFlops() {
+	return 4.0 * nonzeros;
+}
+
+int SupernodalSolver::getNumSupernodes() {
+	return (int)supernodes.size();
+}
@@ -0,0 +1,78 @@
+#ifndef SUPERNODALSOLVER_H
+#define SUPERNODALSOLVER_H
+
+#include <vector>
+#include <atomic>
+#include "LinearSolver.h"
+#include "ThreadPool.h"
+#include "Eigen/Dense"
+
+/*
+*	multifrontal supernodal Cholesky backend for symmetric positive definite systems (a nodal matrix
+*	without voltage sources or closed switches). the rows of a voltage source make the system unsymmetric
+*	and factorize rejects it, so LinearSolver::select only picks this backend for the nodal systems of
+*	source-free circuits and for the loop systems, and a nodal system with sources given it by --solver
+*	is solved by the sparse LU fallback.
+*	the columns of L that share their structure are grouped into supernodes, each stored as one dense
+*	block, and the elimination tree of the supernodes is run as a task graph:
+*		a supernode assembles its front from the entries of A and the update matrices of its children,
+*		factorizes its diagonal block (LLT), solves the block below it (TRSM) and leaves the Schur
+*		complement of the rest (SYRK) as its update matrix for its parent.
+*	a supernode becomes a task of the pool once its last child has finished, so the independent
+*	branches of the tree run side by side on the workers, and small subtrees are run whole by one task.
+*	the columns are renumbered in postorder of the elimination tree, which keeps every supernode contiguous
+*	without changing the fill of the order the solver is given.
+*/
+
+class SupernodalSolver : public LinearSolver {
+
+private:
+	struct Supernode {
+		int first, last;			// its columns
+		vector<int> rows;			// the rows of L below the supernode's columns
+		int parent;					// -1 for a root
+		vector<int> children;
+		int firstDescendant;		// the supernodes of its subtree are firstDescendant ... itself
+		bool sequential;			// factorized by the task of a small subtree above it
+		Eigen::MatrixXd L;			// its columns of L, the diagonal block and the rows below
+		Eigen::MatrixXd update;		// the Schur complement it leaves for its parent, lower triangle
+	};
+
+	ThreadPool* pool;
+	long n;
+	// the postorder of the elimination tree, A is factorized as P A P^T
+	Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> post;
+	vector<Supernode> supernodes;
+	SparseMatrix pattern;			// P A P^T of the last analysis, its structure is reused by refactorize
+	long nonzeros;
+	double factorFlops;
+
+	atomic<int> remaining;
+	atomic<int>* pendingChildren;
+	atomic<bool> failed;
+
+	bool analyze(const SparseMatrix& A);
+	// assembles and factorizes supernode s, false if its diagonal block is not positive definite
+	bool factorizeSupernode(int s, const SparseMatrix& A, vector<int>& position);
+	// runs supernode s, or the whole small subtree it heads, then starts its parent when it was the last child
+	void runTask(int s, const SparseMatrix& A);
+
+public:
+	SupernodalSolver(ThreadPool* pool);
+	~SupernodalSolver();
+
+	bool factorize(const SparseMatrix& A);
+	bool refactorize(const SparseMatrix& A);
+	bool solve(const Eigen::VectorXd& b, Eigen::VectorXd& x);
+	bool solveMany(const Eigen::MatrixXd& B, Eigen::MatrixXd& X);
+	// symmetric, the transposed solve is the same
+	bool solveTransposed(const Eigen::VectorXd& b, Eigen::VectorXd& x);
+	Type getType();
+	long getFactorNonzeros();
+	double getFactorFlops();
+	double getSolveFlops();
+
+	int getNumSupernodes();
+};
+
+#endif
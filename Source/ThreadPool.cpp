@@ -0,0 +1,147 @@
+#include "ThreadPool.h"
+#include <memory>
+
+// the pool and the deque of the worker running on this thread, if any
+static thread_local ThreadPool* currentPool = NULL;
+static thread_local int currentWorker = -1;
+
+ThreadPool::ThreadPool(int threads) {
+	if (threads <= 0)
+		threads = (int)thread::hardware_concurrency();
+	if (threads <= 0)
+		threads = 1;
+	stopping = false;
+	pending = 0;
+	nextQueue = 0;
+	queues = new vector<WorkQueue*>();
+	for (int i = 0; i < threads; i++)
+		queues->push_back(new WorkQueue());
+	workers = new vector<thread>();
+	for (int i = 0; i < threads; i++)
+		workers->push_back(thread(&ThreadPool::work, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		unique_lock<mutex> guard(lock);
+		stopping = true;
+	}
+	wakeup.notify_all();
+	for (size_t i = 0; i < workers->size(); i++)
+		(*workers)[i].join();
+	for (size_t i = 0; i < queues->size(); i++)
+		delete (*queues)[i];
+	delete workers;
+	delete queues;
+}
+
+// the newest task of the worker's own deque, else the oldest one of the next busy worker
+bool ThreadPool::take(int index, function<void()>& task) {
+	int count = (int)queues->size();
+	for (int k = 0; k < count; k++) {
+		WorkQueue* q = (*queues)[(index + k) % count];
+		unique_lock<mutex> guard(q->lock);
+		if (q->tasks.empty())
+			continue;
+		if (k == 0) {
+			task = move(q->tasks.back());
+			q->tasks.pop_back();
+		}
+		else {
+			task = move(q->tasks.front());
+			q->tasks.pop_front();
+		}
+		pending--;
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::work(int index) {
+	currentPool = this;
+	currentWorker = index;
+	while (true) {
+		function<void()> task;
+		if (take(index, task)) {
+			task();
+			continue;
+		}
+		unique_lock<mutex> guard(lock);
+		// queued tasks are still run when the pool is stopping
+		wakeup.wait(guard, [this] { return stopping || pending.load() > 0; });
+		if (stopping && pending.load() == 0)
+			return;
+	}
+}
+
+void ThreadPool::submit(function<void()> task) {
+	int index = currentPool == this ? currentWorker : (int)(nextQueue++ % queues->size());
+	WorkQueue* q = (*queues)[index];
+	{
+		unique_lock<mutex> guard(q->lock);
+		q->tasks.push_back(move(task));
+	}
+	{
+		// counted under the lock, so a worker about to sleep can not miss it
+		unique_lock<mutex> guard(lock);
+		pending++;
+	}
+	wakeup.notify_one();
+}
+
+// the state of one parallelFor, shared with the helpers that may still be queued when it returns
+struct ParallelLoop {
+	atomic<int> next;
+	atomic<int> done;
+	int count;
+	function<void(int)> body;
+	mutex lock;
+	condition_variable finished;
+
+	// takes iterations until none are left
+	void run() {
+		int i;
+		while ((i = next.fetch_add(1)) < count) {
+			body(i);
+			if (done.fetch_add(1) + 1 == count) {
+				unique_lock<mutex> guard(lock);
+				finished.notify_all();
+			}
+		}
+	}
+};
+
+void ThreadPool::parallelFor(int count, function<void(int)> body) {
+	if (count <= 0)
+		return;
+	shared_ptr<ParallelLoop> loop = make_shared<ParallelLoop>();
+	loop->next = 0;
+	loop->done = 0;
+	loop->count = count;
+	loop->body = body;
+	int helpers = min(count - 1, getNumThreads());
+	for (int i = 0; i < helpers; i++)
+		submit([loop] { loop->run(); });
+	// the caller works too, so a loop inside a task still progresses when every worker is busy
+	loop->run();
+	unique_lock<mutex> guard(loop->lock);
+	loop->finished.wait(guard, [&loop] { return loop->done.load() == loop->count; });
+}
+
+bool ThreadPool::runPending() {
+	int index = currentPool == this ? currentWorker : (int)(nextQueue.load() % queues->size());
+	function<void()> task;
+	if (!take(index, task))
+		return false;
+	task();
+	return true;
+}
+
+int ThreadPool::getNumThreads() {
+	return (int)workers->size();
+}
+
+ThreadPool* ThreadPool::getShared() {
+	static ThreadPool shared(0);
+	return &shared;
+}
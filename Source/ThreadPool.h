@@ -0,0 +1,63 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+/*
+*	a fixed set of worker threads running submitted tasks.
+*	every worker owns a deque: tasks submitted from a worker go to the back of its own deque and are
+*	taken back from there (the newest first, while its data is still in cache), an idle worker steals
+*	the oldest task of another worker. tasks submitted from outside are dealt out round robin.
+*	parallelFor spreads the iterations of a loop over the workers and the calling thread,
+*	so it may also be called from inside a task without deadlocking.
+*/
+
+class ThreadPool {
+
+private:
+	struct WorkQueue {
+		deque<function<void()> > tasks;
+		mutex lock;
+	};
+
+	vector<thread>* workers;
+	vector<WorkQueue*>* queues;
+	atomic<int> pending;			// tasks queued and not yet taken
+	atomic<unsigned> nextQueue;		// where the next task from outside goes
+	mutex lock;
+	condition_variable wakeup;
+	bool stopping;
+
+	void work(int index);
+	bool take(int index, function<void()>& task);
+
+public:
+	// starts "threads" workers, 0 starts one per hardware thread
+	ThreadPool(int threads);
+	~ThreadPool();
+
+	// queues "task" to run on a worker
+	void submit(function<void()> task);
+
+	// runs body(0) ... body(count - 1) and returns once all of them have finished
+	void parallelFor(int count, function<void(int)> body);
+
+	// runs one queued task on the calling thread, false if none was queued.
+	// a thread waiting for tasks it submitted helps with them instead of holding a worker idle
+	bool runPending();
+
+	int getNumThreads();
+
+	// the pool shared by the solvers, one worker per hardware thread
+	static ThreadPool* getShared();
+};
+
+#endif
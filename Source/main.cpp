@@ -1,19 +1,221 @@
 #include "IO.h"
 #include <iostream>
 #include "Circuit.h"
+#include "ResultExport.h"
+#include "Netlist.h"
+#include "BatchRunner.h"
+#include "LockstepSolver.h"
+#include "ContingencyAnalysis.h"
+#include "OutOfCoreSolver.h"
+#include "ModelReduction.h"
+#include "Sparsifier.h"
 using namespace std;
 
-int main() {
+int main(int argc, char* argv[]) {
 
 	Circuit* c = new Circuit();
 
-	inputValues(c);
+	// --netlist <file> reads a SPICE-like netlist and --load <file> a binary snapshot
+	// instead of the interactive input,
+	// --save <file> writes the solved circuit to a snapshot,
+	// --export <csv|jsonl|bin> <file> writes all of its results,
+	// --stream <csv|jsonl> <file> writes the results of every solve of the circuit in the session, numbered from 0:
+	// the first and those after a switch changes, not the solves made inside a superposition or maximum power query,
+	// --stats prints the time spent in every phase and the size of the system,
+	// --solver <name> overrides the automatic choice of linear solver
+	// (dense-lu, dense-qr, sparse-lu, ldlt, cg, bicgstab, dd, mixed, supernodal, amg, banded),
+	// --ordering <amd|colamd|nd|rcm|natural> the choice of fill-reducing ordering,
+	// --formulation <auto|nodal|loop> the choice of nodal or loop (mesh) equations,
+	// --sparsify <epsilon> solves on a sample of the resistors within epsilon of the full network,
+	// --refine then refines that solution against the full network,
+	// --batch <directory|manifest> solves every netlist listed there on all cores and exits,
+	// --export then names the directory their results are written to,
+	// --sweep <values.csv> solves one copy of the circuit per line of element values and exits,
+	// --export then names the CSV their unknowns are written to,
+	// --contingency <report.csv> opens and shorts every element in turn, writes the extremes of each case and exits,
+	// --out-of-core <directory> solves the --netlist with its matrix and factors in files there and exits,
+	// --memory <megabytes> then bounds the factors it keeps in memory, as it bounds the factors kept for the
+	// switch states of a switched circuit otherwise,
+	// --reduce <moments> <file> writes a reduced RC model of the ports given by --port <pos> <neg> (repeated) and exits,
+	// --expand <hertz> then takes its moments about that frequency instead of DC.
+	string netlistPath, loadPath, savePath, exportPath, streamPath, batchPath, sweepPath, contingencyPath, outOfCorePath, reducePath;
+	vector<string> portPos, portNeg;
+	int moments = 0;
+	double expansion = 0;
+	double sparsifyEpsilon = 0;
+	bool sparsifyRefine = false;
+	size_t memoryLimit = 256;
+	ResultExporter::Format exportFormat = ResultExporter::CSV;
+	ResultExporter::Format streamFormat = ResultExporter::CSV;
+	bool printStats = false;
+	LinearSolver::Type solverType = LinearSolver::AUTO;
+	Ordering::Type orderingType = Ordering::AUTO;
+	LoopAnalysis::Formulation formulation = LoopAnalysis::AUTO;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--netlist" && i + 1 < argc)
+			netlistPath = argv[++i];
+		else if (arg == "--load" && i + 1 < argc)
+			loadPath = argv[++i];
+		else if (arg == "--batch" && i + 1 < argc)
+			batchPath = argv[++i];
+		else if (arg == "--sweep" && i + 1 < argc)
+			sweepPath = argv[++i];
+		else if (arg == "--contingency" && i + 1 < argc)
+			contingencyPath = argv[++i];
+		else if (arg == "--out-of-core" && i + 1 < argc)
+			outOfCorePath = argv[++i];
+		else if (arg == "--reduce" && i + 2 < argc && atoi(argv[i + 1]) > 0) {
+			moments = atoi(argv[i + 1]);
+			reducePath = argv[i + 2];
+			i += 2;
+		}
+		else if (arg == "--expand" && i + 1 < argc && atof(argv[i + 1]) >= 0)
+			expansion = atof(argv[++i]);
+		else if (arg == "--port" && i + 2 < argc) {
+			portPos.push_back(argv[i + 1]);
+			portNeg.push_back(argv[i + 2]);
+			i += 2;
+		}
+		else if (arg == "--memory" && i + 1 < argc && atol(argv[i + 1]) > 0)
+			memoryLimit = atol(argv[++i]);
+		else if (arg == "--stats")
+			printStats = true;
+		else if (arg == "--solver" && i + 1 < argc && LinearSolver::parseType(argv[i + 1], solverType))
+			i++;
+		else if (arg == "--ordering" && i + 1 < argc && Ordering::parseType(argv[i + 1], orderingType))
+			i++;
+		else if (arg == "--formulation" && i + 1 < argc && LoopAnalysis::parseFormulation(argv[i + 1], formulation))
+			i++;
+		else if (arg == "--sparsify" && i + 1 < argc && atof(argv[i + 1]) > 0)
+			sparsifyEpsilon = atof(argv[++i]);
+		else if (arg == "--refine")
+			sparsifyRefine = true;
+		else if (arg == "--save" && i + 1 < argc)
+			savePath = argv[++i];
+		else if (arg == "--export" && i + 2 < argc && ResultExporter::parseFormat(argv[i + 1], exportFormat)) {
+			exportPath = argv[i + 2];
+			i += 2;
+		}
+		else if (arg == "--stream" && i + 2 < argc && ResultExporter::parseFormat(argv[i + 1], streamFormat)) {
+			streamPath = argv[i + 2];
+			i += 2;
+		}
+		else {
+			cout << "Unrecognized argument: " << arg << "\n";
+			return 1;
+		}
+	}
+
+	if (!batchPath.empty()) {
+		BatchRunner runner(ThreadPool::getShared());
+		if (!runner.addInput(batchPath))
+			return 1;
+		runner.setOutput(exportPath, exportFormat);
+		runner.setSolver(solverType);
+		runner.setOrdering(orderingType);
+		runner.enableStats(printStats);
+		bool success = runner.run();
+		runner.print(cout);
+		return success ? 0 : 1;
+	}
+
+	if (!outOfCorePath.empty()) {
+		if (netlistPath.empty()) {
+			cout << "ERROR: --out-of-core needs a --netlist.\n";
+			return 1;
+		}
+		OutOfCoreSolver solver(outOfCorePath, memoryLimit << 20);
+		if (!solver.solve(netlistPath))
+			return 1;
+		solver.print(cout);
+		if (!exportPath.empty()) {
+			ResultExporter exporter;
+			if (!exporter.open(exportPath, exportFormat) || !solver.exportResults(&exporter) || !exporter.close())
+				return 1;
+		}
+		return 0;
+	}
+
+	c->enableStats(printStats);
+	c->setSolver(solverType);
+	c->setOrdering(orderingType);
+	c->setFormulation(formulation);
+	c->setSparsification(sparsifyEpsilon, sparsifyRefine);
+	c->setFactorCacheCapacity((long)memoryLimit << 20);
+
+	if (!netlistPath.empty()) {
+		if (!readNetlist(netlistPath, c) || !c->checkCircuit())
+			return 1;
+	}
+	else if (!loadPath.empty()) {
+		if (!c->loadSnapshot(loadPath) || !c->checkCircuit())
+			return 1;
+	}
+	else
+		inputValues(c);
+
+	if (!sweepPath.empty()) {
+		vector<string> names;
+		Eigen::MatrixXd values, solutions;
+		LockstepSolver sweep(c);
+		if (!sweep.isReady() || !LockstepSolver::readValues(sweepPath, names, values))
+			return 1;
+		for (size_t i = 0; i < names.size(); i++)
+			if (sweep.addParameter(names[i]) < 0)
+				return 1;
+		bool success = sweep.solve(values, solutions, ThreadPool::getShared());
+		if (!exportPath.empty() && !sweep.writeSolutions(exportPath, solutions))
+			return 1;
+		cout << "Solved " << values.cols() << " copies, " << sweep.getNumFallbacks() << " of them apart from the others.\n";
+		return success ? 0 : 1;
+	}
+
+	if (!reducePath.empty()) {
+		ModelReduction reduction(c);
+		if (!reduction.isReady() || !reduction.reduce(portPos, portNeg, moments, expansion))
+			return 1;
+		reduction.print(cout);
+		return reduction.write(reducePath) ? 0 : 1;
+	}
+
+	if (!contingencyPath.empty()) {
+		ContingencyAnalysis analysis(c);
+		if (!analysis.isReady())
+			return 1;
+		analysis.addAllCases();
+		analysis.run(ThreadPool::getShared());
+		analysis.print(cout);
+		return analysis.writeReport(contingencyPath) ? 0 : 1;
+	}
+
+	ResultExporter stream;
+	if (!streamPath.empty() && (!stream.open(streamPath, streamFormat, true) || !c->setResultStream(&stream)))
+		return 1;
 
 	if (c->solve()) {
+		if (!savePath.empty() && !c->saveSnapshot(savePath, true))
+			cout << "ERROR: Could not save the snapshot to " << savePath << ".\n";
+		if (!exportPath.empty()) {
+			ScopedPhase phase(c->getStats(), SolveStats::EXPORT);
+			ResultExporter exporter;
+			if (exporter.open(exportPath, exportFormat)) {
+				c->exportResults(&exporter);
+				exporter.close();
+			}
+		}
+		if (printStats)
+			c->getStats()->print(cout);
+		if (c->getLastSparsifier() != NULL)
+			c->getLastSparsifier()->print(cout);
 		cout << "\n\nFor direct responses, please enter the type (I current, V voltage, and P for power) " <<
 					"and location (element name/number) of the required response.\n";
 		cout << "For superposition, press EN/JN where N is the number of the voltage/current source first.\n";
 		cout << "For maximum power transfer, press MP/RM/PM followed by the name of the resistor.\n";
+		cout << "For the Thevenin/Norton equivalent between two nodes, press TH/NO followed by the names of the nodes.\n";
+		cout << "For the effective resistance between two nodes, press RE followed by the names of the nodes.\n";
+		if (c->getNumSwitches() > 0)
+			cout << "To open or close a switch and solve again, press SW followed by the name of the switch and ON/OFF.\n";
 		cout << "Press Q/q to exit.\n";
 		double supplied, dissipated;
 		bool isbalanced = c->checkPowerBalance(dissipated, supplied);
@@ -22,6 +224,8 @@ int main() {
 			cout << "\n\nPower is balanced.\n";
 		else
 			cout << "\n\nERROR: Power is NOT balanced. \n";
+		// set while a query has left its own solution deployed in place of the circuit's
+		bool stale = false;
 		while (true) {
 			string responseType;
 			cin >> responseType;
@@ -31,17 +235,20 @@ int main() {
 			string responseName;
 			cin >> responseName;
 
-			if (responseType[0] == 'E' || responseType[0] == 'J') {
+			Element::ElementType sourceType = c->getElementType(responseType);
+			if (responseType[0] == 'E' || responseType[0] == 'J'
+				|| sourceType == Element::ElementType::VOLTAGE_SOURCE || sourceType == Element::ElementType::CURRENT_SOURCE) {
 				//Superposition
-				c->solveDue(responseType);
 				string responseName2;
 				cin >> responseName2;
-				printValue (responseName2, c, responseName[0]);
+				if (printDueValue (responseType, responseName2, c, responseName[0]))
+					stale = true;
 			}
 			else if (responseType == "MP" || responseType == "RM" || responseType == "PM") {
 				// MPT
 				double RMax;
 				double PMax = c->getMaxPower(responseName, RMax);
+				stale = true;
 				if (PMax != DBL_MAX) {
 					cout << "Maximum power transfer to resistor " << responseName << " = " << PMax << " watts at Rmax = " << RMax << " ohms. \n";
 				}
@@ -49,12 +256,49 @@ int main() {
 					cout << "ERROR: " << responseName << " either is not a resistor, causes an invalid circuit or the maximum power tends to infinity. \n";
 				}
 			}
+			else if (responseType == "RE") {
+				string secondName;
+				cin >> secondName;
+				double resistance = c->getEffectiveResistance(responseName, secondName);
+				if (resistance != DBL_MAX)
+					cout << "Effective resistance between " << responseName << " and " << secondName << " = " << resistance << " ohms. \n";
+			}
+			else if (responseType == "SW") {
+				string state;
+				cin >> state;
+				bool closed = state == "ON" || state == "on" || state == "1";
+				if (c->setSwitch(responseName, closed) && c->solve()) {
+					FactorCache* factors = c->getFactorCache();
+					cout << "Switch " << responseName << (closed ? " closed" : " opened") << ", " << factors->getMisses()
+						<< " factorizations, " << factors->getHits() << " solves reused the factors of their state. \n";
+				}
+			}
+			else if (responseType == "TH" || responseType == "NO") {
+				string negName;
+				cin >> negName;
+				double value, impedance;
+				if (responseType == "TH" && c->getThevenin(responseName, negName, value, impedance))
+					cout << "Thevenin equivalent between " << responseName << " and " << negName << ": " << value << " volts in series with " << impedance << " ohms. \n";
+				else if (responseType == "NO" && c->getNorton(responseName, negName, value, impedance))
+					cout << "Norton equivalent between " << responseName << " and " << negName << ": " << value << " amperes in parallel with " << impedance << " siemens. \n";
+			}
 			else {
-				c->solve();
+				// the circuit's own solution is already streamed, solving it again does not stream it twice
+				if (stale) {
+					c->setResultStream(NULL);
+					stale = !c->solve();
+					if (stream.isOpen())
+						c->setResultStream(&stream);
+				}
 				printValue (responseName, c, responseType[0]);
 			}
 		}
 	}
 
+	if (stream.isOpen()) {
+		c->setResultStream(NULL);
+		if (!stream.close())
+			return 1;
+	}
 	return 0;
 }